@@ -1,6 +1,7 @@
 ﻿using Nebula.Commons.Text;
 using Nebula.Compiler.Tests.Utility;
 using System.Diagnostics;
+using System.Text;
 
 namespace Nebula.Compiler.Tests
 {
@@ -22,6 +23,17 @@ namespace Nebula.Compiler.Tests
 #endif
 
         public static string SamplesFolder => @"..\..\..\..\..\Samples";
+        // Hand written scripts covering what the compiler never emits
+        public static string BytecodeSamplesFolder => Path.Combine(SamplesFolder, "Bytecode");
+
+        // Collecting and checking the heap on every allocation is much slower than a normal run
+        private const int StressTimeoutFactor = 20;
+        // Small enough for a collection cycle to span many steps, so that the barriers run in the middle of it
+        private const string IncrementalSliceWork = "16";
+        // Small enough for the threads of a sample to be preempted in the middle of their loops
+        private const string InstructionBudget = "100";
+        // The executor prints how long the execution took
+        private static readonly string[] VaryingExecutorOutput = { "Execution terminated with time", "(With script loading)", "(No script loading)" };
 
         [TestMethod]
         public void AllSamplesCompile()
@@ -48,33 +60,222 @@ namespace Nebula.Compiler.Tests
         [DynamicData(nameof(GetSamplesWithMetadata))]
         public void AllSamplesRunAsExpected(string path, TestMetadata md)
         {
+            string compiledPath = CompileSample(path, md, out string[] compiledReferencesPath);
 
-            string compiledName = Path.GetFileName(Path.ChangeExtension(path, ".neb"));
-            string compiledPath = Path.Combine(Directory.GetCurrentDirectory(), compiledName);
+            var errorCode = LaunchExecutor(md, compiledPath, compiledReferencesPath);
+            Assert.AreEqual(md.AbortCode, errorCode);
+            File.Delete(compiledPath);
+        }
+
+        [TestMethod]
+        [DynamicData(nameof(GetSamplesWithMetadata))]
+        public void AllSamplesRunUnderGCStress(string path, TestMetadata md)
+        {
+            string compiledPath = CompileSample(path, md, out string[] compiledReferencesPath);
+
+            // The executor aborts on the first heap inconsistency, which fails the abort code check
+            var errorCode = LaunchExecutor(md, compiledPath, compiledReferencesPath, md.MaxVMExecutionTime * StressTimeoutFactor, "-g");
+            Assert.AreEqual(md.AbortCode, errorCode);
+            File.Delete(compiledPath);
+        }
 
+        [TestMethod]
+        [DynamicData(nameof(GetSamplesWithMetadata))]
+        public void AllSamplesRunUnderIncrementalGCStress(string path, TestMetadata md)
+        {
+            string compiledPath = CompileSample(path, md, out string[] compiledReferencesPath);
+
+            AssertRunsLikeDefault(md, compiledPath, compiledReferencesPath, md.MaxVMExecutionTime * StressTimeoutFactor, "-i", IncrementalSliceWork, "-g");
+            File.Delete(compiledPath);
+        }
+
+        [TestMethod]
+        [DynamicData(nameof(GetSamplesWithMetadata))]
+        public void AllSamplesRunSingleStepped(string path, TestMetadata md)
+        {
+            string compiledPath = CompileSample(path, md, out string[] compiledReferencesPath);
+
+            string output = AssertRunsLikeDefault(md, compiledPath, compiledReferencesPath, md.MaxVMExecutionTime, "-t");
+            AssertOutputContains(output, md.ExpectedOutput);
+            File.Delete(compiledPath);
+        }
+
+        [TestMethod]
+        [DynamicData(nameof(GetSamplesWithMetadata))]
+        public void AllSamplesRunWithAnInstructionBudget(string path, TestMetadata md)
+        {
+            string compiledPath = CompileSample(path, md, out string[] compiledReferencesPath);
+
+            string output = AssertRunsLikeDefault(md, compiledPath, compiledReferencesPath, md.MaxVMExecutionTime, "-u", InstructionBudget);
+            AssertOutputContains(output, md.ExpectedOutput);
+            File.Delete(compiledPath);
+        }
+
+        [TestMethod]
+        [DynamicData(nameof(GetSamplesWithMetadata))]
+        public void AllSamplesRunSamplingTheClockOnEveryInstruction(string path, TestMetadata md)
+        {
+            string compiledPath = CompileSample(path, md, out string[] compiledReferencesPath);
+
+            string output = AssertRunsLikeDefault(md, compiledPath, compiledReferencesPath, md.MaxVMExecutionTime, "-l", "1");
+            AssertOutputContains(output, md.ExpectedOutput);
+            File.Delete(compiledPath);
+        }
+
+        [TestMethod]
+        [DynamicData(nameof(GetSamplesWithMetadata))]
+        public void AllSamplesRunFromScriptImages(string path, TestMetadata md)
+        {
+            string compiledPath = CompileSample(path, md, out string[] compiledReferencesPath);
+
+            string imagePath = ConvertToImage(compiledPath);
+            string[] referenceImagesPath = compiledReferencesPath.Select(ConvertToImage).ToArray();
+
+            var errorCode = LaunchExecutor(md, imagePath, referenceImagesPath);
+            Assert.AreEqual(md.AbortCode, errorCode);
+
+            File.Delete(imagePath);
+            File.Delete(compiledPath);
+        }
+
+        [TestMethod]
+        [DynamicData(nameof(GetSamplesWithMetadata))]
+        public void AllSamplesRunFromTheScriptCache(string path, TestMetadata md)
+        {
+            string compiledPath = CompileSample(path, md, out string[] compiledReferencesPath);
+            string cacheDirectory = Path.Combine(Path.GetTempPath(), $"nebula_cache_{Guid.NewGuid():N}");
+            List<string> arguments = ExecutorArguments(compiledPath, compiledReferencesPath, "-k", cacheDirectory);
+            int scriptCount = compiledReferencesPath.Length + 1;
+
+            try
+            {
+                // Cold, every script is parsed and stored
+                Assert.AreEqual(md.AbortCode, RunExecutor(arguments, md.MaxVMExecutionTime, out string output));
+                StringAssert.Contains(output, $"0 scripts loaded from the cache, {scriptCount} parsed");
+
+                // Warm, nothing is parsed
+                Assert.AreEqual(md.AbortCode, RunExecutor(arguments, md.MaxVMExecutionTime, out output));
+                StringAssert.Contains(output, $"{scriptCount} scripts loaded from the cache, 0 parsed");
+
+                // Damaged entries are parsed again
+                foreach (string entry in Directory.GetFiles(cacheDirectory))
+                {
+                    byte[] data = File.ReadAllBytes(entry);
+                    data[data.Length / 2] ^= 0xFF;
+                    File.WriteAllBytes(entry, data);
+                }
+
+                Assert.AreEqual(md.AbortCode, RunExecutor(arguments, md.MaxVMExecutionTime, out output));
+                StringAssert.Contains(output, $"0 scripts loaded from the cache, {scriptCount} parsed");
+            }
+            finally
+            {
+                Directory.Delete(cacheDirectory, true);
+                File.Delete(compiledPath);
+            }
+        }
+
+        [TestMethod]
+        public void TruncatedScriptImageIsRejected()
+        {
+            string samplePath = Path.Combine(SamplesFolder, "0_HelloWorld.nebula");
+            TestMetadata md = TestMetadata.Read(Path.Combine(SamplesFolder, "metadata", "0_HelloWorld.test_meta"))!;
+            string compiledPath = CompileSample(samplePath, md, out _);
+            string imagePath = ConvertToImage(compiledPath);
+
+            byte[] image = File.ReadAllBytes(imagePath);
+            File.WriteAllBytes(imagePath, image.Take(image.Length / 2).ToArray());
+
+            List<string> arguments = new() { "-s", Path.GetFullPath(imagePath) };
+            int errorCode = RunExecutor(arguments, md.MaxVMExecutionTime, out string output);
+
+            // Scripts failing to load are reported before anything runs
+            Assert.AreEqual(-1, errorCode);
+            StringAssert.Contains(output, "Malformed script image");
+
+            File.Delete(imagePath);
+            File.Delete(compiledPath);
+        }
+
+        [TestMethod]
+        [DynamicData(nameof(GetBytecodeSamplesWithMetadata))]
+        public void BytecodeSamplesRunAsExpected(string path, TestMetadata md)
+        {
+            List<string> arguments = new() { "-s", Path.GetFullPath(path) };
+            int errorCode = RunExecutor(arguments, md.MaxVMExecutionTime, out string output);
+
+            Assert.AreEqual(md.AbortCode, errorCode);
+            AssertOutputContains(output, md.ExpectedOutput);
+        }
+
+        [TestMethod]
+        [DynamicData(nameof(GetBytecodeSamplesWithMetadata))]
+        public void BytecodeSamplesRunUnderGCStress(string path, TestMetadata md)
+        {
+            List<string> arguments = new() { "-g", "-s", Path.GetFullPath(path) };
+            int errorCode = RunExecutor(arguments, md.MaxVMExecutionTime * StressTimeoutFactor, out string output);
+
+            Assert.AreEqual(md.AbortCode, errorCode);
+            AssertOutputContains(output, md.ExpectedOutput);
+        }
+
+        [TestMethod]
+        [DynamicData(nameof(GetBytecodeSamplesWithMetadata))]
+        public void BytecodeSamplesRunSingleStepped(string path, TestMetadata md)
+        {
+            List<string> arguments = new() { "-t", "-s", Path.GetFullPath(path) };
+            int errorCode = RunExecutor(arguments, md.MaxVMExecutionTime, out string output);
+
+            Assert.AreEqual(md.AbortCode, errorCode);
+            AssertOutputContains(output, md.ExpectedOutput);
+        }
+
+        [TestMethod]
+        [DynamicData(nameof(GetBytecodeSamplesWithMetadata))]
+        public void BytecodeSamplesRunUnderIncrementalGCStress(string path, TestMetadata md)
+        {
+            List<string> arguments = new() { "-i", IncrementalSliceWork, "-g", "-s", Path.GetFullPath(path) };
+            int errorCode = RunExecutor(arguments, md.MaxVMExecutionTime * StressTimeoutFactor, out string output);
+
+            Assert.AreEqual(md.AbortCode, errorCode);
+            AssertOutputContains(output, md.ExpectedOutput);
+        }
+
+        [TestMethod]
+        [TestCategory("Benchmark")]
+        public void ParseThroughput()
+        {
             Core.Compilation.Compiler.Options options = new()
             {
                 EmitProgram = true,
                 OutputFolder = ".",
             };
 
-            List<SourceCode> references = CreateReferences(Path.GetDirectoryName(path)!, md, out string[]? compiledReferencesPath);
+            foreach (var sample in GetAllSamples)
+            {
+                options.Sources.Add(SourceCode.From(sample));
+            }
 
-            options.Sources.AddRange(references);
-            options.Sources.Add(SourceCode.From(path));
             bool compileOk = Core.Compilation.Compiler.Compile(options, out Core.Compilation.Compiler.Result? result);
-
             WriteReport(result.Report);
-
             Assert.IsTrue(compileOk);
-            Assert.IsTrue(File.Exists(compiledPath));
 
-            Assert.IsTrue(compileOk);
-            Assert.IsFalse(result.Report.HasErrors);
+            List<string> arguments = new() { "-p", "20" };
+            foreach (var sample in GetAllSamples)
+            {
+                string compiledPath = Path.Combine(Directory.GetCurrentDirectory(), Path.GetFileName(Path.ChangeExtension(sample, ".neb")));
+                Assert.IsTrue(File.Exists(compiledPath));
+                arguments.Add("-s");
+                arguments.Add(compiledPath);
+            }
 
-            var errorCode = LaunchExecutor(md, compiledPath, compiledReferencesPath);
-            Assert.AreEqual(md.AbortCode, errorCode);
-            File.Delete(compiledPath);
+            string synthetic = WriteSyntheticScript(Path.Combine(Directory.GetCurrentDirectory(), "synthetic_parse.neb"), 3000);
+            arguments.Add("-s");
+            arguments.Add(synthetic);
+
+            int exitCode = RunExecutor(arguments, 120_000);
+            File.Delete(synthetic);
+            Assert.AreEqual(0, exitCode);
         }
 
         private void WriteReport(Commons.Reporting.Report report)
@@ -102,42 +303,199 @@ namespace Nebula.Compiler.Tests
             return result;
         }
 
+        // Compiles a sample and its dependencies in the working directory, returns the path of the compiled sample
+        private string CompileSample(string path, TestMetadata md, out string[] compiledReferencesPath)
+        {
+            string compiledName = Path.GetFileName(Path.ChangeExtension(path, ".neb"));
+            string compiledPath = Path.Combine(Directory.GetCurrentDirectory(), compiledName);
+
+            Core.Compilation.Compiler.Options options = new()
+            {
+                EmitProgram = true,
+                OutputFolder = ".",
+            };
+
+            List<SourceCode> references = CreateReferences(Path.GetDirectoryName(path)!, md, out compiledReferencesPath);
+
+            options.Sources.AddRange(references);
+            options.Sources.Add(SourceCode.From(path));
+            bool compileOk = Core.Compilation.Compiler.Compile(options, out Core.Compilation.Compiler.Result? result);
+
+            WriteReport(result.Report);
+
+            Assert.IsTrue(compileOk);
+            Assert.IsTrue(File.Exists(compiledPath));
+            Assert.IsFalse(result.Report.HasErrors);
+            return compiledPath;
+        }
+
+        // Writes the script image of a compiled script next to it with the executor, returns the path of the image
+        private static string ConvertToImage(string compiledPath)
+        {
+            List<string> arguments = new() { "-c", Path.GetFullPath(compiledPath) };
+            Assert.AreEqual(0, RunExecutor(arguments, 10_000));
+
+            string imagePath = Path.ChangeExtension(compiledPath, ".nebc");
+            Assert.IsTrue(File.Exists(imagePath));
+            return imagePath;
+        }
+
         private static int LaunchExecutor(TestMetadata md, string scriptFile, string[] dependencies)
         {
+            return LaunchExecutor(md, scriptFile, dependencies, md.MaxVMExecutionTime);
+        }
+
+        private static int LaunchExecutor(TestMetadata md, string scriptFile, string[] dependencies, int timeout, params string[] extraArguments)
+        {
+            return RunExecutor(ExecutorArguments(scriptFile, dependencies, extraArguments), timeout);
+        }
+
+        private static List<string> ExecutorArguments(string scriptFile, string[] dependencies, params string[] extraArguments)
+        {
+            List<string> arguments = new(extraArguments) { "-s", Path.GetFullPath(scriptFile) };
+            foreach (string d in dependencies)
+            {
+                arguments.Add("-s");
+                arguments.Add(Path.GetFullPath(d));
+            }
+
+            return arguments;
+        }
+
+        private static int RunExecutor(IEnumerable<string> arguments, int timeout)
+        {
+            return RunExecutor(arguments, timeout, out _);
+        }
+
+        private static int RunExecutor(IEnumerable<string> arguments, int timeout, out string output)
+        {
+            StringBuilder outputBuilder = new();
+            void OnDataReceived(object sender, DataReceivedEventArgs e)
+            {
+                if (e.Data is null)
+                {
+                    return;
+                }
+
+                lock (outputBuilder)
+                {
+                    outputBuilder.AppendLine(e.Data);
+                }
+                Console.WriteLine(e.Data);
+            }
+
             Process p = new();
             p.StartInfo.FileName = Path.GetFullPath(ExecutorPath);
             p.StartInfo.UseShellExecute = false;
             p.StartInfo.RedirectStandardOutput = true;
             p.StartInfo.RedirectStandardError = true;
-            p.OutputDataReceived += P_OutputDataReceived;
-            p.ErrorDataReceived += P_OutputDataReceived;
-            p.StartInfo.ArgumentList.Add($"-s");
-            p.StartInfo.ArgumentList.Add(Path.GetFullPath(scriptFile));
-            foreach (string d in dependencies)
+            p.OutputDataReceived += OnDataReceived;
+            p.ErrorDataReceived += OnDataReceived;
+            foreach (string a in arguments)
             {
-                p.StartInfo.ArgumentList.Add($"-s");
-                p.StartInfo.ArgumentList.Add(Path.GetFullPath(d));
+                p.StartInfo.ArgumentList.Add(a);
             }
 
-
             Assert.IsTrue(p.Start());
             p.BeginOutputReadLine();
             p.BeginErrorReadLine();
 
-            bool exitedOk = p.WaitForExit(md.MaxVMExecutionTime);
+            bool exitedOk = p.WaitForExit(timeout);
 
             if (!exitedOk)
             {
                 p.Kill();
             }
+            else
+            {
+                // Waits for the redirected output to be read to the end
+                p.WaitForExit();
+            }
 
             Assert.IsTrue(exitedOk, "VM has reached max execution time");
+
+            lock (outputBuilder)
+            {
+                output = outputBuilder.ToString();
+            }
             return p.ExitCode;
         }
 
-        private static void P_OutputDataReceived(object sender, DataReceivedEventArgs e)
+        private static void AssertOutputContains(string output, IEnumerable<string> expectedLines)
+        {
+            foreach (string expected in expectedLines)
+            {
+                StringAssert.Contains(output, expected);
+            }
+        }
+
+        // Runs a compiled sample with the default options then with the extra arguments, returns the output of the second run
+        private static string AssertRunsLikeDefault(TestMetadata md, string compiledPath, string[] compiledReferencesPath, int timeout, params string[] extraArguments)
+        {
+            int errorCode = RunExecutor(ExecutorArguments(compiledPath, compiledReferencesPath), md.MaxVMExecutionTime, out string defaultOutput);
+            Assert.AreEqual(md.AbortCode, errorCode);
+
+            errorCode = RunExecutor(ExecutorArguments(compiledPath, compiledReferencesPath, extraArguments), timeout, out string output);
+            Assert.AreEqual(md.AbortCode, errorCode);
+            AssertSameOutput(md, defaultOutput, output);
+            return output;
+        }
+
+        // Both runs must print the same lines in the same order, apart from the ones expected to vary
+        private static void AssertSameOutput(TestMetadata md, string expected, string actual)
+        {
+            CollectionAssert.AreEqual(ComparableOutput(md, expected), ComparableOutput(md, actual));
+        }
+
+        private static List<string> ComparableOutput(TestMetadata md, string output)
         {
-            Console.WriteLine(e.Data);
+            return output.Split('\n')
+                .Select(line => line.TrimEnd('\r'))
+                .Where(line => !VaryingExecutorOutput.Any(line.Contains) && !md.VaryingOutput.Any(line.Contains))
+                .ToList();
+        }
+
+        // Same shape as the compiler output: many small functions with locals, branches, calls and string constants
+        private static string WriteSyntheticScript(string path, int functionCount)
+        {
+            StringBuilder sb = new();
+            sb.Append(".namespace \"Synthetic\"\n");
+            sb.Append(".globals [  ]\n");
+
+            for (int f = 0; f < functionCount; f++)
+            {
+                sb.Append($".func int32 f{f}( int32 n )\n");
+                sb.Append("{\n");
+                sb.Append("    .locals [ int32 , string ]\n");
+                int ip = 0;
+                for (int block = 0; block < 8; block++)
+                {
+                    sb.Append($"    {ip++:X4} ldarg 0\n");
+                    sb.Append($"    {ip++:X4} ldc_i4 {block * 7}\n");
+                    sb.Append($"    {ip++:X4} add\n");
+                    sb.Append($"    {ip++:X4} stloc 0\n");
+                    sb.Append($"    {ip++:X4} ldc_s \"Some constant string {block}\"\n");
+                    sb.Append($"    {ip++:X4} stloc 1\n");
+                    sb.Append($"    {ip++:X4} ldloc 0\n");
+                    sb.Append($"    {ip++:X4} ldc_i4 100\n");
+                    sb.Append($"    {ip++:X4} clt\n");
+                    sb.Append($"    {ip++:X4} brfalse {ip + 2}\n");
+                    sb.Append($"    {ip++:X4} ldloc 1\n");
+                    sb.Append($"    {ip++:X4} call WriteLine\n");
+                }
+                sb.Append($"    {ip++:X4} ldloc 0\n");
+                sb.Append($"    {ip:X4} ret\n");
+                sb.Append("}\n\n");
+            }
+
+            sb.Append(".func void main(  ) ;autoexec\n");
+            sb.Append("{\n");
+            sb.Append("    .locals [  ]\n");
+            sb.Append("    0000 ret\n");
+            sb.Append("}\n");
+
+            File.WriteAllText(path, sb.ToString());
+            return path;
         }
 
         private static IEnumerable<string> GetAllSamples
@@ -152,31 +510,31 @@ namespace Nebula.Compiler.Tests
             }
         }
 
-        private static IEnumerable<object[]> GetSamplesWithMetadata
+        private static IEnumerable<object[]> GetSamplesWithMetadata => GetScriptsWithMetadata(SamplesFolder, "*.nebula");
+
+        private static IEnumerable<object[]> GetBytecodeSamplesWithMetadata => GetScriptsWithMetadata(BytecodeSamplesFolder, "*.neb");
+
+        private static IEnumerable<object[]> GetScriptsWithMetadata(string folder, string searchPattern)
         {
-            get
+            Assert.IsTrue(Directory.Exists(folder));
+            const string mdFileEx = "test_meta";
+
+            string metadataFiles = Path.Combine(folder, "metadata");
+            string[] allMetdata = Directory.GetFiles(metadataFiles, $"*.{mdFileEx}");
+            foreach (string file in Directory.GetFiles(folder, searchPattern))
             {
-                Assert.IsTrue(Directory.Exists(SamplesFolder));
-                const string mdFileEx = "test_meta";
+                string? metdataYamlPath = GetMetadataFileFullPath(allMetdata, file);
 
-                string metadataFiles = Path.Combine(SamplesFolder, "metadata");
-                string[] allMetdata = Directory.GetFiles(metadataFiles, $"*.{mdFileEx}");
-                foreach (string file in Directory.GetFiles(SamplesFolder, "*.nebula"))
+                if (metdataYamlPath is null)
                 {
-                    string fileName = Path.GetFileNameWithoutExtension(file);
-                    string? metdataYamlPath = GetMetadataFileFullPath(allMetdata, file);
-
-                    if (metdataYamlPath is null)
-                    {
-                        continue;
-                    }
+                    continue;
+                }
 
-                    TestMetadata? md = TestMetadata.Read(metdataYamlPath);
+                TestMetadata? md = TestMetadata.Read(metdataYamlPath);
 
-                    Assert.IsNotNull(md);
+                Assert.IsNotNull(md);
 
-                    yield return new object[] { file, md };
-                }
+                yield return new object[] { file, md };
             }
         }
 
@@ -11,6 +11,12 @@ namespace Nebula.Compiler.Tests.Utility
 
         public int MaxVMExecutionTime { get; set; }
 
+        // Lines the executor must print, in any order
+        public string[] ExpectedOutput { get; set; } = Array.Empty<string>();
+
+        // Lines containing any of these differ from run to run, they are ignored when comparing the output of two runs
+        public string[] VaryingOutput { get; set; } = Array.Empty<string>();
+
         public static TestMetadata? Read(string filePath)
         {
             if (!File.Exists(filePath))
@@ -25,6 +31,8 @@ namespace Nebula.Compiler.Tests.Utility
             TestMetadata tm = deserializer.Deserialize<TestMetadata>(File.ReadAllText(filePath));
 
             tm.Dependencies ??= Array.Empty<string>();
+            tm.ExpectedOutput ??= Array.Empty<string>();
+            tm.VaryingOutput ??= Array.Empty<string>();
             if (tm.MaxVMExecutionTime <= 1000)
             {
                 tm.MaxVMExecutionTime = 1000;
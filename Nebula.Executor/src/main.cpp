@@ -9,13 +9,19 @@
 #include <string>
 #include <format>
 #include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
 
 #include "ArgParser.h"
 
 // Interpreter
 #include "Script.h"
+#include "ScriptImage.h"
+#include "ScriptCache.h"
 #include "Interpreter.h"
 #include "ErrorCallStack.h"
+#include "OpcodeProfiler.h"
 
 #include "ConsoleWriter.h"
 #include "DiagnosticReport.h"
@@ -30,6 +36,24 @@ using namespace nebula;
 
 std::vector<std::string> g_inputScripts = {};
 std::vector<std::string> g_inputBindings = {};
+// Text scripts written as script images instead of being executed
+std::vector<std::string> g_convertScripts = {};
+// Directory of the script image cache, empty when scripts are always parsed
+std::string g_cacheDirectory = {};
+// Times each input script is parsed when benchmarking the parser instead of executing, 0 when not benchmarking
+size_t g_parseIterations = 0;
+// Longest opcode sequence reported once the execution ends, 0 when not profiling
+size_t g_opcodeNgramLength = 0;
+// Collects and checks the heap on every allocation, aborting on the first inconsistency
+bool g_gcStressMode = false;
+// Objects traced or heap slots swept by each incremental collection slice, 0 when full collections stop the world
+size_t g_gcSliceWork = 0;
+// Runs one instruction per scheduler pass instead of batches, like under the debugger
+bool g_singleStep = false;
+// Instructions a script thread runs before the next one is scheduled, 0 to schedule by time slices
+size_t g_instructionBudget = 0;
+// Instructions between two reads of the clock when scheduling by time slices, 0 for the interpreter default
+size_t g_clockSampleInterval = 0;
 
 static void AddToScripts(const std::string& path) {
 	// TODO :: Validate
@@ -40,6 +64,47 @@ static void AddToBindings(const std::string& path) {
 	g_inputBindings.push_back(path);
 }
 
+static void AddToConversions(const std::string& path) {
+	g_convertScripts.push_back(path);
+}
+
+static void SetCacheDirectory(const std::string& directory) {
+	g_cacheDirectory = directory;
+}
+
+static void SetParseIterations(const std::string& iterations) {
+	int value = std::atoi(iterations.data());
+	g_parseIterations = value > 0 ? (size_t)value : 1;
+}
+
+static void EnableGCStressMode(const std::string&) {
+	g_gcStressMode = true;
+}
+
+static void EnableIncrementalCollection(const std::string& work) {
+	int value = std::atoi(work.data());
+	g_gcSliceWork = value > 0 ? (size_t)value : 1;
+}
+
+static void EnableSingleStep(const std::string&) {
+	g_singleStep = true;
+}
+
+static void SetInstructionBudget(const std::string& instructions) {
+	int value = std::atoi(instructions.data());
+	g_instructionBudget = value > 0 ? (size_t)value : 1;
+}
+
+static void SetClockSampleInterval(const std::string& instructions) {
+	int value = std::atoi(instructions.data());
+	g_clockSampleInterval = value > 0 ? (size_t)value : 1;
+}
+
+static void SetOpcodeNgramLength(const std::string& length) {
+	int value = std::atoi(length.data());
+	g_opcodeNgramLength = value > 1 ? (size_t)value : 2;
+}
+
 static void PrintReport(shared::DiagnosticReport& report)
 {
 	for (auto& err : report.Errors())
@@ -115,32 +180,149 @@ static int PrintVMLastError(nebula::Interpreter& vm)
 
 static int LoadInputScripts(std::vector< std::shared_ptr<Script>>& loadedScripts) {
 
+	std::vector<std::string> files;
+	for (auto& file : g_inputScripts)
+	{
+		if (file.ends_with(".neb") || file.ends_with(".nebc"))
+		{
+			files.push_back(file);
+		}
+	}
+
+	// Parsed concurrently, reported in the order given
+	std::unique_ptr<ScriptCache> cache;
+	std::vector<ScriptLoadResult> results;
+	if (g_cacheDirectory.empty())
+	{
+		results = Script::FromFiles(files);
+	}
+	else
+	{
+		// Keep the source lines so that scripts from the cache report errors like parsed ones
+		cache = std::make_unique<ScriptCache>(g_cacheDirectory, true);
+		results = cache->LoadAll(files);
+	}
+
+	bool foundError = false;
+	for (size_t i{ 0 }; i < files.size(); i++)
+	{
+		ScriptLoadResult& scriptLoadResult = results[i];
+		if (scriptLoadResult.ParsingReport.Errors().size() > 0)
+		{
+			std::string errMessage = std::format("Errors while loading script {}", files[i].data());
+			writer::ConsoleWrite(errMessage, writer::Code::FG_RED);
+			PrintReport(scriptLoadResult.ParsingReport);
+			foundError = true;
+		}
+		else
+		{
+			PrintReport(scriptLoadResult.ParsingReport);
+			writer::ConsoleWrite(std::format("Script with namespace {} has been loaded", scriptLoadResult.Script->Namespace()), writer::Code::FG_GREEN);
+			loadedScripts.push_back(std::shared_ptr<Script>(scriptLoadResult.Script));
+		}
+	}
+
+	if (cache != nullptr)
+	{
+		writer::ConsoleWrite(std::format("{} scripts loaded from the cache, {} parsed", cache->Hits(), cache->Misses()), writer::Code::FG_GREEN);
+	}
+
+	return !foundError;
+}
+
+// Writes every script to convert as an image next to it (.neb -> .nebc)
+static int ConvertScripts() {
+
 	bool foundError = false;
+	for (auto& file : g_convertScripts)
+	{
+		ScriptLoadResult scriptLoadResult = Script::FromFile(file);
+		std::unique_ptr<Script> script{ scriptLoadResult.Script };
+		shared::DiagnosticReport& report = scriptLoadResult.ParsingReport;
+
+		std::string imagePath = file.ends_with(".neb") ? file + "c" : file + ".nebc";
+		if (script == nullptr || !script->Link())
+		{
+			report.ReportError(std::format("Script {} could not be linked", file));
+		}
+		else
+		{
+			ScriptImage::Save(*script, imagePath, report);
+		}
+
+		if (report.Errors().size() > 0)
+		{
+			std::string errMessage = std::format("Errors while converting script {}", file.data());
+			writer::ConsoleWrite(errMessage, writer::Code::FG_RED);
+			PrintReport(report);
+			foundError = true;
+			continue;
+		}
+
+		writer::ConsoleWrite(std::format("Script image {} has been written", imagePath), writer::Code::FG_GREEN);
+	}
+
+	return foundError ? -1 : 0;
+}
+
+// Parses every input script the requested amount of times from memory, reading the files is not timed
+static int BenchmarkParsing() {
+
+	bool foundError = false;
+	size_t totalBytes{ 0 };
+	std::chrono::nanoseconds totalTime{ 0 };
 	for (auto& file : g_inputScripts)
 	{
-		if (file.ends_with(".neb"))
+		std::ifstream stream{ file, std::ios::binary };
+		if (!stream.is_open())
+		{
+			writer::ConsoleWrite(std::format("Could not open script {}", file), writer::Code::FG_RED);
+			foundError = true;
+			continue;
+		}
+
+		std::stringstream buffer;
+		buffer << stream.rdbuf();
+		const std::string data = buffer.str();
+
+		bool parsed = true;
+		std::chrono::nanoseconds scriptTime{ 0 };
+		for (size_t i{ 0 }; i < g_parseIterations && parsed; i++)
 		{
-			ScriptLoadResult scriptLoadResult = Script::FromFile(file);
+			auto start = std::chrono::high_resolution_clock::now();
+			ScriptLoadResult scriptLoadResult = Script::FromMemory(data, file);
+			auto finish = std::chrono::high_resolution_clock::now();
 
+			std::unique_ptr<Script> script{ scriptLoadResult.Script };
 			if (scriptLoadResult.ParsingReport.Errors().size() > 0)
 			{
-				std::string errMessage = std::format("Errors while loading script {}", file.data());
-				writer::ConsoleWrite(errMessage, writer::Code::FG_RED);
+				writer::ConsoleWrite(std::format("Errors while parsing script {}", file), writer::Code::FG_RED);
 				PrintReport(scriptLoadResult.ParsingReport);
-				foundError = true;
-			}
-			else
-			{
-				PrintReport(scriptLoadResult.ParsingReport);
-				writer::ConsoleWrite(std::format("Script with namespace {} has been loaded", scriptLoadResult.Script->Namespace()), writer::Code::FG_GREEN);
-				loadedScripts.push_back(std::shared_ptr<Script>(scriptLoadResult.Script));
+				parsed = false;
 			}
 
+			scriptTime += finish - start;
+		}
+
+		if (!parsed)
+		{
+			foundError = true;
 			continue;
 		}
+
+		double milliseconds = std::chrono::duration<double, std::milli>(scriptTime).count() / (double)g_parseIterations;
+		double megabytesPerSecond = milliseconds > 0 ? (double)data.size() / (1024.0 * 1024.0) / (milliseconds / 1000.0) : 0;
+		std::cout << std::format("{}: {} bytes, {:.3f}ms per parse, {:.1f}MB/s\n", file, data.size(), milliseconds, megabytesPerSecond);
+
+		totalBytes += data.size();
+		totalTime += scriptTime;
 	}
 
-	return !foundError;
+	double totalMilliseconds = std::chrono::duration<double, std::milli>(totalTime).count() / (double)g_parseIterations;
+	double totalMegabytesPerSecond = totalMilliseconds > 0 ? (double)totalBytes / (1024.0 * 1024.0) / (totalMilliseconds / 1000.0) : 0;
+	std::cout << std::format("Total: {} bytes, {:.3f}ms per parse, {:.1f}MB/s\n", totalBytes, totalMilliseconds, totalMegabytesPerSecond);
+
+	return foundError ? -1 : 0;
 }
 
 static int ExecuteVM() {
@@ -159,28 +341,61 @@ static int ExecuteVM() {
 			BindNativeFunctions(vm, file);
 		}
 
+		OpcodeProfiler profiler;
+		if (g_opcodeNgramLength > 0)
+		{
+			vm.SetOpcodeProfiler(&profiler);
+		}
+
+		// Before adding the scripts so that their initializers run under stress too
+		vm.SetGCStressMode(g_gcStressMode);
+		if (g_gcSliceWork > 0)
+		{
+			vm.SetCollectionMode(Interpreter::CollectionMode::Incremental);
+			vm.SetGCSliceWork(g_gcSliceWork);
+		}
+
+		if (g_singleStep)
+		{
+			vm.SetExecutionMode(Interpreter::ExecutionMode::SingleStep);
+		}
+
+		if (g_instructionBudget > 0)
+		{
+			vm.SetSchedulingMode(Interpreter::SchedulingMode::InstructionBudget);
+			vm.SetInstructionBudget(g_instructionBudget);
+		}
+
+		if (g_clockSampleInterval > 0)
+		{
+			vm.SetClockSampleInterval(g_clockSampleInterval);
+		}
+
 		std::vector<std::shared_ptr<Script>> loadedScripts;
 		loadedScripts.reserve(g_inputScripts.size());
 		if (LoadInputScripts(loadedScripts))
 		{
 			auto start = std::chrono::high_resolution_clock::now();
 
-			bool allScriptsLoaded = true;
-			for (auto& ptr : loadedScripts)
+			std::vector<shared::DiagnosticReport> addReports;
+			bool allScriptsLoaded = vm.AddScripts(loadedScripts, addReports);
+			for (size_t i{ 0 }; i < loadedScripts.size(); i++)
 			{
-				bool scriptLoaded = vm.AddScript(ptr);
-
 				[[unlikely]]
-				if (!scriptLoaded)
+				if (addReports[i].Errors().size() > 0)
 				{
-					std::string errMessage = std::format("Error while adding script '{}' to VM", ptr->Namespace().data());
+					std::string errMessage = std::format("Error while adding script '{}' to VM", loadedScripts[i]->Namespace().data());
 					writer::ConsoleWrite(errMessage, writer::Code::FG_RED);
-					allScriptsLoaded = false;
+					PrintReport(addReports[i]);
+				}
+			}
 
-					shared::ErrorCallStack* errCallstack = vm.GetFatalErrorCallstack();
-					if (errCallstack != nullptr) {
-						writer::ConsoleWrite(errCallstack->GetAsText(), writer::Code::FG_RED);
-					}
+			[[unlikely]]
+			if (!allScriptsLoaded)
+			{
+				shared::ErrorCallStack* errCallstack = vm.GetFatalErrorCallstack();
+				if (errCallstack != nullptr) {
+					writer::ConsoleWrite(errCallstack->GetAsText(), writer::Code::FG_RED);
 				}
 			}
 
@@ -205,6 +420,12 @@ static int ExecuteVM() {
 				std::cout << "  (With script loading) ->   " << milliseconds.count() << "ms; " << microseconds.count() << "us\n";
 				std::cout << "  (No script loading) ->   " << millisecondsNoLoading.count() << "ms; " << microsecondsNoLoading.count() << "us\n";
 
+				if (g_opcodeNgramLength > 0)
+				{
+					std::cout << ">------- Most executed opcode sequences ---------\n";
+					profiler.Dump(std::cout, g_opcodeNgramLength, 50);
+				}
+
 				executionResult = PrintVMLastError(vm);
 			}
 			else
@@ -233,6 +454,15 @@ int main(int argc, char* argv[]) {
 
 	argParser.RegisterArgument("s|script=", AddToScripts);
 	argParser.RegisterArgument("b|binding=", AddToBindings);
+	argParser.RegisterArgument("n|ngrams=", SetOpcodeNgramLength);
+	argParser.RegisterArgument("c|convert=", AddToConversions);
+	argParser.RegisterArgument("p|parsebench=", SetParseIterations);
+	argParser.RegisterArgument("k|cache=", SetCacheDirectory);
+	argParser.RegisterArgument("g|gcstress", EnableGCStressMode);
+	argParser.RegisterArgument("i|incremental=", EnableIncrementalCollection);
+	argParser.RegisterArgument("t|singlestep", EnableSingleStep);
+	argParser.RegisterArgument("u|budget=", SetInstructionBudget);
+	argParser.RegisterArgument("l|clocksample=", SetClockSampleInterval);
 	if (!argParser.Parse(argc, argv)) {
 		writer::ConsoleWrite("Could not parse program arguments!", writer::Code::BG_RED);
 		return -1;
@@ -240,6 +470,14 @@ int main(int argc, char* argv[]) {
 
 	/* DO NOT DUMP MEMORY HERE OTHERWISE STATIC STUFF WILL BE REPORTED */
 
+	if (!g_convertScripts.empty()) {
+		return ConvertScripts();
+	}
+
+	if (g_parseIterations > 0) {
+		return BenchmarkParsing();
+	}
+
 	int result = ExecuteVM();
 	return result;
 }
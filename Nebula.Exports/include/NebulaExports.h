@@ -55,10 +55,31 @@ extern "C"
     __declspec(dllexport) bool Interpreter_RedirectExitCallback(nebula::Interpreter* handle, nebula::interop::ExitFuncPtr callback);
     __declspec(dllexport) bool Interpreter_ClearRedirectOutput(nebula::Interpreter* handle);
     __declspec(dllexport) bool Interpreter_AddScripts(nebula::Interpreter* handle, nebula::interop::ReportCallbackPtr callbackPtr, const char** scriptPaths, int arrLen);
+    // Same as Interpreter_AddScripts, unchanged text scripts are loaded from their image in the cache directory (see ScriptCache)
+    __declspec(dllexport) bool Interpreter_AddScriptsCached(nebula::Interpreter* handle, nebula::interop::ReportCallbackPtr callbackPtr, const char* cacheDirectory, const char** scriptPaths, int arrLen);
     __declspec(dllexport) int* Interpreter_GetNextOpcodeForAllThreads(nebula::Interpreter* handle, int* arrLen);
     __declspec(dllexport) void Interpreter_Init(nebula::Interpreter* handle, bool startPaused);
     __declspec(dllexport) void Interpreter_Run(nebula::Interpreter* handle);
     __declspec(dllexport) void Interpreter_Step(nebula::Interpreter* handle);
+    __declspec(dllexport) void Interpreter_SetExecutionMode(nebula::Interpreter* handle, int mode);
+    __declspec(dllexport) int Interpreter_GetExecutionMode(nebula::Interpreter* handle);
+    __declspec(dllexport) void Interpreter_SetSchedulingMode(nebula::Interpreter* handle, int mode);
+    __declspec(dllexport) int Interpreter_GetSchedulingMode(nebula::Interpreter* handle);
+    __declspec(dllexport) void Interpreter_SetMaxExecutionTime(nebula::Interpreter* handle, int milliseconds);
+    __declspec(dllexport) int Interpreter_GetMaxExecutionTime(nebula::Interpreter* handle);
+    __declspec(dllexport) void Interpreter_SetInstructionBudget(nebula::Interpreter* handle, int instructionCount);
+    __declspec(dllexport) int Interpreter_GetInstructionBudget(nebula::Interpreter* handle);
+    __declspec(dllexport) void Interpreter_SetClockSampleInterval(nebula::Interpreter* handle, int instructionCount);
+    __declspec(dllexport) int Interpreter_GetClockSampleInterval(nebula::Interpreter* handle);
+    __declspec(dllexport) void Interpreter_SetCollectionMode(nebula::Interpreter* handle, int mode);
+    __declspec(dllexport) int Interpreter_GetCollectionMode(nebula::Interpreter* handle);
+    __declspec(dllexport) void Interpreter_SetGCSliceWork(nebula::Interpreter* handle, int work);
+    __declspec(dllexport) int Interpreter_GetGCSliceWork(nebula::Interpreter* handle);
+    __declspec(dllexport) void Interpreter_SetGCSliceTime(nebula::Interpreter* handle, int microseconds);
+    __declspec(dllexport) int Interpreter_GetGCSliceTime(nebula::Interpreter* handle);
+    __declspec(dllexport) void Interpreter_SetGCStressMode(nebula::Interpreter* handle, bool stress);
+    __declspec(dllexport) bool Interpreter_GetGCStressMode(nebula::Interpreter* handle);
+    __declspec(dllexport) bool Interpreter_CollectGarbage(nebula::Interpreter* handle, int microseconds);
     __declspec(dllexport) void Interpreter_Pause(nebula::Interpreter* handle);
     __declspec(dllexport) void Interpreter_Stop(nebula::Interpreter* handle);
     __declspec(dllexport) void Interpreter_Reset(nebula::Interpreter* handle);
@@ -69,6 +90,8 @@ extern "C"
     __declspec(dllexport) int Interpreter_AnyFrameAt(nebula::Interpreter* handle, const char* ns, const char* funcName, int nextOpcodeIndex);
     __declspec(dllexport) int Interpreter_GetCurrentOpcodeIndexOfThread(nebula::Interpreter* handle, int threadId);
     __declspec(dllexport) const nebula::CallStack* Interpreter_GetCallStackOfThread(nebula::Interpreter* handle, int threadId);
+    __declspec(dllexport) void Interpreter_PinObject(nebula::Interpreter* handle, nebula::IGCObject* object);
+    __declspec(dllexport) void Interpreter_UnpinObject(nebula::Interpreter* handle, nebula::IGCObject* object);
     __declspec(dllexport) void Interpreter_Destroy(nebula::Interpreter* handle);
 
     // Frame
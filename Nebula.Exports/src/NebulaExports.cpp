@@ -12,6 +12,7 @@
 #include "Interpreter.h"
 #include "Frame.h"
 #include "Script.h"
+#include "ScriptCache.h"
 #include "DebuggerDefinitions.h"
 #include "ThreadMap.h"
 #include "Function.h"
@@ -189,41 +190,74 @@ bool Interpreter_ClearRedirectOutput(nebula::Interpreter* handle)
 	return handle->ClearStandardOutput();
 }
 
-bool Interpreter_AddScripts(nebula::Interpreter* handle, nebula::interop::ReportCallbackPtr callbackPtr, const char** scriptPaths, int arrLen)
+static bool AddLoadedScripts(nebula::Interpreter* handle, nebula::interop::ReportCallbackPtr callbackPtr, const char** scriptPaths, int arrLen, std::vector<nebula::ScriptLoadResult>& loadResults)
 {
-	if (handle == nullptr)
-	{
-		return false;
-	}
-
+	// Nothing is added unless every script could be parsed
+	bool parsedAll = true;
+	std::vector<std::shared_ptr<nebula::Script>> scripts;
 	for (int i{ 0 }; i < arrLen; i++)
 	{
-		const char* str = scriptPaths[i];
-
-		nebula::ScriptLoadResult loadResult = nebula::Script::FromFile(str);
-
-		WriteReportToCallback(str, callbackPtr, loadResult.ParsingReport);
+		nebula::ScriptLoadResult& loadResult = loadResults[i];
+		WriteReportToCallback(scriptPaths[i], callbackPtr, loadResult.ParsingReport);
 
 		size_t errCount = loadResult.ParsingReport.Errors().size();
 		if (errCount > 0)
 		{
-			return false;
+			parsedAll = false;
+			continue;
 		}
 
-		std::shared_ptr<nebula::Script> sharedPtr{ loadResult.Script };
-		bool addedToVm = handle->AddScript(sharedPtr);
+		scripts.push_back(std::shared_ptr<nebula::Script>{ loadResult.Script });
+	}
 
-		if (!addedToVm)
-		{
-			//_logger->LogError(System::String::Format("Could not add script '{0}' to native interpreter", scriptName));
-			return false;
-		}
+	if (!parsedAll)
+	{
+		return false;
+	}
+
+	std::vector<nebula::shared::DiagnosticReport> addReports;
+	bool addedToVm = handle->AddScripts(scripts, addReports);
+	for (int i{ 0 }; i < arrLen; i++)
+	{
+		WriteReportToCallback(scriptPaths[i], callbackPtr, addReports[i]);
+	}
+
+	if (!addedToVm)
+	{
+		//_logger->LogError(System::String::Format("Could not add script '{0}' to native interpreter", scriptName));
+		return false;
 	}
 
 	//_logger->LogInformation(System::String::Format("Loaded '{0}' script into virtual machine", scriptPaths->Count));
 	return true;
 }
 
+bool Interpreter_AddScripts(nebula::Interpreter* handle, nebula::interop::ReportCallbackPtr callbackPtr, const char** scriptPaths, int arrLen)
+{
+	if (handle == nullptr)
+	{
+		return false;
+	}
+
+	std::vector<std::string> paths{ scriptPaths, scriptPaths + arrLen };
+	std::vector<nebula::ScriptLoadResult> loadResults = nebula::Script::FromFiles(paths);
+	return AddLoadedScripts(handle, callbackPtr, scriptPaths, arrLen, loadResults);
+}
+
+bool Interpreter_AddScriptsCached(nebula::Interpreter* handle, nebula::interop::ReportCallbackPtr callbackPtr, const char* cacheDirectory, const char** scriptPaths, int arrLen)
+{
+	if (handle == nullptr || cacheDirectory == nullptr)
+	{
+		return false;
+	}
+
+	std::vector<std::string> paths{ scriptPaths, scriptPaths + arrLen };
+	// Keep the source lines so that scripts from the cache report errors like parsed ones
+	nebula::ScriptCache cache{ cacheDirectory, true };
+	std::vector<nebula::ScriptLoadResult> loadResults = cache.LoadAll(paths);
+	return AddLoadedScripts(handle, callbackPtr, scriptPaths, arrLen, loadResults);
+}
+
 int* Interpreter_GetNextOpcodeForAllThreads(nebula::Interpreter* handle, int* arrLen)
 {
 	if (handle == nullptr)
@@ -282,6 +316,196 @@ void Interpreter_Step(nebula::Interpreter* handle)
 	handle->Step();
 }
 
+void Interpreter_SetExecutionMode(nebula::Interpreter* handle, int mode)
+{
+	if (handle == nullptr)
+	{
+		return;
+	}
+
+	handle->SetExecutionMode((nebula::Interpreter::ExecutionMode)mode);
+}
+
+int Interpreter_GetExecutionMode(nebula::Interpreter* handle)
+{
+	if (handle == nullptr)
+	{
+		return -1;
+	}
+
+	return (int)handle->GetExecutionMode();
+}
+
+void Interpreter_SetSchedulingMode(nebula::Interpreter* handle, int mode)
+{
+	if (handle == nullptr)
+	{
+		return;
+	}
+
+	handle->SetSchedulingMode((nebula::Interpreter::SchedulingMode)mode);
+}
+
+int Interpreter_GetSchedulingMode(nebula::Interpreter* handle)
+{
+	if (handle == nullptr)
+	{
+		return -1;
+	}
+
+	return (int)handle->GetSchedulingMode();
+}
+
+void Interpreter_SetMaxExecutionTime(nebula::Interpreter* handle, int milliseconds)
+{
+	if (handle == nullptr)
+	{
+		return;
+	}
+
+	handle->SetMaxExecutionTime(milliseconds);
+}
+
+int Interpreter_GetMaxExecutionTime(nebula::Interpreter* handle)
+{
+	if (handle == nullptr)
+	{
+		return -1;
+	}
+
+	return handle->GetMaxExecutionTime();
+}
+
+void Interpreter_SetInstructionBudget(nebula::Interpreter* handle, int instructionCount)
+{
+	if (handle == nullptr || instructionCount <= 0)
+	{
+		return;
+	}
+
+	handle->SetInstructionBudget((size_t)instructionCount);
+}
+
+int Interpreter_GetInstructionBudget(nebula::Interpreter* handle)
+{
+	if (handle == nullptr)
+	{
+		return -1;
+	}
+
+	return (int)handle->GetInstructionBudget();
+}
+
+void Interpreter_SetClockSampleInterval(nebula::Interpreter* handle, int instructionCount)
+{
+	if (handle == nullptr || instructionCount <= 0)
+	{
+		return;
+	}
+
+	handle->SetClockSampleInterval((size_t)instructionCount);
+}
+
+int Interpreter_GetClockSampleInterval(nebula::Interpreter* handle)
+{
+	if (handle == nullptr)
+	{
+		return -1;
+	}
+
+	return (int)handle->GetClockSampleInterval();
+}
+
+void Interpreter_SetCollectionMode(nebula::Interpreter* handle, int mode)
+{
+	if (handle == nullptr)
+	{
+		return;
+	}
+
+	handle->SetCollectionMode((nebula::Interpreter::CollectionMode)mode);
+}
+
+int Interpreter_GetCollectionMode(nebula::Interpreter* handle)
+{
+	if (handle == nullptr)
+	{
+		return -1;
+	}
+
+	return (int)handle->GetCollectionMode();
+}
+
+void Interpreter_SetGCSliceWork(nebula::Interpreter* handle, int work)
+{
+	if (handle == nullptr || work <= 0)
+	{
+		return;
+	}
+
+	handle->SetGCSliceWork((size_t)work);
+}
+
+int Interpreter_GetGCSliceWork(nebula::Interpreter* handle)
+{
+	if (handle == nullptr)
+	{
+		return -1;
+	}
+
+	return (int)handle->GetGCSliceWork();
+}
+
+void Interpreter_SetGCSliceTime(nebula::Interpreter* handle, int microseconds)
+{
+	if (handle == nullptr || microseconds < 0)
+	{
+		return;
+	}
+
+	handle->SetGCSliceTime((unsigned int)microseconds);
+}
+
+int Interpreter_GetGCSliceTime(nebula::Interpreter* handle)
+{
+	if (handle == nullptr)
+	{
+		return -1;
+	}
+
+	return (int)handle->GetGCSliceTime();
+}
+
+void Interpreter_SetGCStressMode(nebula::Interpreter* handle, bool stress)
+{
+	if (handle == nullptr)
+	{
+		return;
+	}
+
+	handle->SetGCStressMode(stress);
+}
+
+bool Interpreter_GetGCStressMode(nebula::Interpreter* handle)
+{
+	if (handle == nullptr)
+	{
+		return false;
+	}
+
+	return handle->GetGCStressMode();
+}
+
+bool Interpreter_CollectGarbage(nebula::Interpreter* handle, int microseconds)
+{
+	if (handle == nullptr || microseconds < 0)
+	{
+		return false;
+	}
+
+	return handle->CollectGarbage((unsigned int)microseconds);
+}
+
 void Interpreter_Pause(nebula::Interpreter* handle)
 {
 	if (handle == nullptr)
@@ -449,6 +673,26 @@ const nebula::CallStack* Interpreter_GetCallStackOfThread(nebula::Interpreter* h
 	return callStack;
 }
 
+void Interpreter_PinObject(nebula::Interpreter* handle, nebula::IGCObject* object)
+{
+	if (handle == nullptr || object == nullptr)
+	{
+		return;
+	}
+
+	handle->PinObject(object);
+}
+
+void Interpreter_UnpinObject(nebula::Interpreter* handle, nebula::IGCObject* object)
+{
+	if (handle == nullptr || object == nullptr)
+	{
+		return;
+	}
+
+	handle->UnpinObject(object);
+}
+
 void Interpreter_Destroy(nebula::Interpreter* handle)
 {
 	delete handle;
@@ -798,7 +1042,8 @@ const char* DataStackVariant_GetStringValue(nebula::DataStackVariant* handle)
 	{
 		return 0;
 	}
-	return std::get<nebula::DataStackVariantIndex::_TypeString>(*handle).data();
+	const nebula::TString* str = handle->GetIf<nebula::TString>();
+	return str != nullptr ? str->data() : nullptr;
 }
 
 int DataStackVariant_GetIntValue(nebula::DataStackVariant* handle)
@@ -808,7 +1053,8 @@ int DataStackVariant_GetIntValue(nebula::DataStackVariant* handle)
 		return 0;
 	}
 
-	return std::get<nebula::DataStackVariantIndex::_TypeInt32>(*handle);
+	const nebula::TInt32* value = handle->GetIf<nebula::TInt32>();
+	return value != nullptr ? *value : 0;
 }
 
 float DataStackVariant_GetFloatValue(nebula::DataStackVariant* handle)
@@ -818,7 +1064,8 @@ float DataStackVariant_GetFloatValue(nebula::DataStackVariant* handle)
 		return 0;
 	}
 
-	return std::get<nebula::DataStackVariantIndex::_TypeFloat>(*handle);
+	const nebula::TFloat* value = handle->GetIf<nebula::TFloat>();
+	return value != nullptr ? *value : 0;
 }
 
 nebula::Bundle* DataStackVariant_GetBundleValue(nebula::DataStackVariant* handle)
@@ -828,13 +1075,13 @@ nebula::Bundle* DataStackVariant_GetBundleValue(nebula::DataStackVariant* handle
 		return nullptr;
 	}
 
-	auto it = std::get_if<nebula::TGCObject>(handle);
-	if (it == nullptr || it->get()->GetType() != nebula::ObjectType::Bundle)
+	nebula::IGCObject* obj = handle->AsObject();
+	if (obj == nullptr || obj->GetType() != nebula::ObjectType::Bundle)
 	{
 		return nullptr;
 	}
 
-	return (nebula::Bundle*)it->get();
+	return (nebula::Bundle*)obj;
 }
 
 nebula::VariantArray* DataStackVariant_GetArrayValue(nebula::DataStackVariant* handle)
@@ -844,13 +1091,13 @@ nebula::VariantArray* DataStackVariant_GetArrayValue(nebula::DataStackVariant* h
 		return nullptr;
 	}
 
-	auto it = std::get_if<nebula::TGCObject>(handle);
-	if (it == nullptr || it->get()->GetType() != nebula::ObjectType::Array)
+	nebula::IGCObject* obj = handle->AsObject();
+	if (obj == nullptr || obj->GetType() != nebula::ObjectType::Array)
 	{
 		return nullptr;
 	}
 
-	return (nebula::VariantArray*)it->get();
+	return (nebula::VariantArray*)obj;
 }
 
 /////////////////////////////////////////////////////////
@@ -992,12 +1239,13 @@ int* Function_GetInstructions(nebula::Function* handle, int* arrLen)
 		return nullptr;
 	}
 
-	auto& instructions = handle->Instructions();
-	*arrLen = (int)instructions.size();
+	// Functions loaded from a script image have no parsed body, their linked code has one instruction per parsed one
+	size_t count = handle->Instructions().empty() ? handle->Code().Size() : handle->Instructions().size();
+	*arrLen = (int)count;
 	int* resArray = new int[*arrLen];
 	for (int i{ 0 }; i < *arrLen; i++)
 	{
-		resArray[i] = (int)instructions.at(i).first;
+		resArray[i] = (int)handle->InstructionAt(i).first;
 	}
 
 	return resArray;
@@ -1026,7 +1274,7 @@ int FrameVariable_GetType(nebula::Variable* handle)
 
 /*In some init cases type is set but no value is present. For example when breaking as soon as we enter in a function scope*/
 #define CHECK_FRAME_VAR_INIT(val)\
-if (handle->Value().index() != handle->Type())\
+if (handle->Value().Type() != handle->Type())\
 {\
     return val;\
 }
@@ -1105,26 +1353,28 @@ nebula::Bundle* FrameVariable_GetBundleValue(nebula::Variable* handle)
 {
 	if (handle == nullptr ||
 		handle->Type() != nebula::DataStackVariantIndex::_TypeObject ||
-		handle->AsGCObject()->GetType() != nebula::ObjectType::Bundle)
+		handle->AsObject() == nullptr ||
+		handle->AsObject()->GetType() != nebula::ObjectType::Bundle)
 	{
 		return nullptr;
 	}
 
 	CHECK_FRAME_VAR_INIT(nullptr);
 
-	return (nebula::Bundle*)handle->AsGCObject().get();
+	return (nebula::Bundle*)handle->AsObject();
 }
 
 nebula::VariantArray* FrameVariable_GetArrayValue(nebula::Variable* handle)
 {
 	if (handle == nullptr ||
 		handle->Type() != nebula::DataStackVariantIndex::_TypeObject ||
-		handle->AsGCObject()->GetType() != nebula::ObjectType::Array)
+		handle->AsObject() == nullptr ||
+		handle->AsObject()->GetType() != nebula::ObjectType::Array)
 	{
 		return nullptr;
 	}
 
 	CHECK_FRAME_VAR_INIT(nullptr);
 
-	return (nebula::VariantArray*)handle->AsGCObject().get();
+	return (nebula::VariantArray*)handle->AsObject();
 }
@@ -23,6 +23,24 @@ namespace Nebula.Interop.SafeHandles
             Exited,
         }
 
+        public enum ExecutionMode
+        {
+            SingleStep,
+            Batched,
+        }
+
+        public enum SchedulingMode
+        {
+            TimeSlice,
+            InstructionBudget,
+        }
+
+        public enum CollectionMode
+        {
+            StopTheWorld,
+            Incremental,
+        }
+
         public int[] NextOpcodesOfAllThreads
         {
             get
@@ -57,6 +75,120 @@ namespace Nebula.Interop.SafeHandles
             }
         }
 
+        public ExecutionMode Mode
+        {
+            get
+            {
+                return (ExecutionMode)NativeMethods.Interpreter_GetExecutionMode(handle);
+            }
+            set
+            {
+                NativeMethods.Interpreter_SetExecutionMode(handle, (int)value);
+            }
+        }
+
+        public SchedulingMode Scheduling
+        {
+            get
+            {
+                return (SchedulingMode)NativeMethods.Interpreter_GetSchedulingMode(handle);
+            }
+            set
+            {
+                NativeMethods.Interpreter_SetSchedulingMode(handle, (int)value);
+            }
+        }
+
+        /// <summary> Milliseconds a script thread can run before being preempted when scheduling by time slice </summary>
+        public int MaxExecutionTime
+        {
+            get
+            {
+                return NativeMethods.Interpreter_GetMaxExecutionTime(handle);
+            }
+            set
+            {
+                NativeMethods.Interpreter_SetMaxExecutionTime(handle, value);
+            }
+        }
+
+        /// <summary> Instructions a script thread can run before being preempted when scheduling by instruction budget </summary>
+        public int InstructionBudget
+        {
+            get
+            {
+                return NativeMethods.Interpreter_GetInstructionBudget(handle);
+            }
+            set
+            {
+                NativeMethods.Interpreter_SetInstructionBudget(handle, value);
+            }
+        }
+
+        /// <summary> How many instructions run between two clock reads when scheduling by time slice </summary>
+        public int ClockSampleInterval
+        {
+            get
+            {
+                return NativeMethods.Interpreter_GetClockSampleInterval(handle);
+            }
+            set
+            {
+                NativeMethods.Interpreter_SetClockSampleInterval(handle, value);
+            }
+        }
+
+        public CollectionMode Collection
+        {
+            get
+            {
+                return (CollectionMode)NativeMethods.Interpreter_GetCollectionMode(handle);
+            }
+            set
+            {
+                NativeMethods.Interpreter_SetCollectionMode(handle, (int)value);
+            }
+        }
+
+        /// <summary> Objects traced or heap slots swept by an incremental collection slice </summary>
+        public int GCSliceWork
+        {
+            get
+            {
+                return NativeMethods.Interpreter_GetGCSliceWork(handle);
+            }
+            set
+            {
+                NativeMethods.Interpreter_SetGCSliceWork(handle, value);
+            }
+        }
+
+        /// <summary> Microseconds an incremental collection slice may last, 0 to only bound slices by their work </summary>
+        public int GCSliceTime
+        {
+            get
+            {
+                return NativeMethods.Interpreter_GetGCSliceTime(handle);
+            }
+            set
+            {
+                NativeMethods.Interpreter_SetGCSliceTime(handle, value);
+            }
+        }
+
+        /// <summary> Collects at every allocation and checks the heap integrity, for testing the garbage collector </summary>
+        public bool GCStressMode
+        {
+            get
+            {
+                return NativeMethods.Interpreter_GetGCStressMode(handle);
+            }
+            set
+            {
+                NativeMethods.Interpreter_SetGCStressMode(handle, value);
+            }
+        }
+
         public State VMState
         {
             get
@@ -124,6 +256,14 @@ namespace Nebula.Interop.SafeHandles
             return NativeMethods.Interpreter_AddScripts(handle, callbackPtr, arr, arr.Length);
         }
 
+        /// <summary> Scripts that didn't change since they were last loaded are read from their image in the cache directory instead of being parsed </summary>
+        public bool AddScripts(ICollection<string> scripts, string cacheDirectory, ScriptParseReportCallback onReportMessage)
+        {
+            string[] arr = scripts.ToArray();
+            IntPtr callbackPtr = Marshal.GetFunctionPointerForDelegate(onReportMessage);
+            return NativeMethods.Interpreter_AddScriptsCached(handle, callbackPtr, cacheDirectory, arr, arr.Length);
+        }
+
         public int GetCurrentOpcodeIndexForThread(int threadId)
         {
             return NativeMethods.Interpreter_GetCurrentOpcodeIndexOfThread(handle, threadId);
@@ -170,6 +310,23 @@ namespace Nebula.Interop.SafeHandles
                                                           uniqueNativeFunctions.Count);
         }
 
+        /// <summary> Keeps a script object alive across garbage collections until it is unpinned as many times as it was pinned </summary>
+        public void PinObject(IntPtr objectHandle)
+        {
+            NativeMethods.Interpreter_PinObject(handle, objectHandle);
+        }
+
+        public void UnpinObject(IntPtr objectHandle)
+        {
+            NativeMethods.Interpreter_UnpinObject(handle, objectHandle);
+        }
+
+        /// <summary> Gives idle time to the garbage collector, returns true once there is nothing left to collect </summary>
+        public bool CollectGarbage(int microseconds)
+        {
+            return NativeMethods.Interpreter_CollectGarbage(handle, microseconds);
+        }
+
         public bool LoadNativesFromDll(string nativeDllBindings)
         {
             if (!File.Exists(nativeDllBindings))
@@ -208,6 +365,44 @@ namespace Nebula.Interop.SafeHandles
             [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
             public static extern void Interpreter_Step(IntPtr handle);
             [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern void Interpreter_SetExecutionMode(IntPtr handle, int mode);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern int Interpreter_GetExecutionMode(IntPtr handle);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern void Interpreter_SetSchedulingMode(IntPtr handle, int mode);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern int Interpreter_GetSchedulingMode(IntPtr handle);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern void Interpreter_SetMaxExecutionTime(IntPtr handle, int milliseconds);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern int Interpreter_GetMaxExecutionTime(IntPtr handle);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern void Interpreter_SetInstructionBudget(IntPtr handle, int instructionCount);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern int Interpreter_GetInstructionBudget(IntPtr handle);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern void Interpreter_SetClockSampleInterval(IntPtr handle, int instructionCount);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern int Interpreter_GetClockSampleInterval(IntPtr handle);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern void Interpreter_SetCollectionMode(IntPtr handle, int mode);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern int Interpreter_GetCollectionMode(IntPtr handle);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern void Interpreter_SetGCSliceWork(IntPtr handle, int work);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern int Interpreter_GetGCSliceWork(IntPtr handle);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern void Interpreter_SetGCSliceTime(IntPtr handle, int microseconds);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern int Interpreter_GetGCSliceTime(IntPtr handle);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern void Interpreter_SetGCStressMode(IntPtr handle, bool stress);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern bool Interpreter_GetGCStressMode(IntPtr handle);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern bool Interpreter_CollectGarbage(IntPtr handle, int microseconds);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
             public static extern int Interpreter_GetThreadCount(IntPtr handle);
             [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
             public static extern long Interpreter_GetCurrentThreadId(IntPtr handle);
@@ -216,6 +411,8 @@ namespace Nebula.Interop.SafeHandles
             [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
             public static extern bool Interpreter_AddScripts(IntPtr handle, IntPtr reportCallback, string[] scriptPaths, int arrLen);
             [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern bool Interpreter_AddScriptsCached(IntPtr handle, IntPtr reportCallback, string cacheDirectory, string[] scriptPaths, int arrLen);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
             public static extern IntPtr Interpreter_GetNextOpcodeForAllThreads(IntPtr handle, out int arrLen);
             [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
             public static extern bool Interpreter_LoadSpecificBindingsInDLL(IntPtr handle, string dllLibrary, string[] functionNames, int arrLen);
@@ -230,6 +427,10 @@ namespace Nebula.Interop.SafeHandles
             [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
             public static extern int Interpreter_GetCurrentOpcodeIndexOfThread(IntPtr handle, int threadId);
             [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern void Interpreter_PinObject(IntPtr handle, IntPtr objectHandle);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
+            public static extern void Interpreter_UnpinObject(IntPtr handle, IntPtr objectHandle);
+            [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
             public static extern void General_DestroyIntArray(IntPtr handle);
             [DllImport(NebulaConstants.DllName, CallingConvention = CallingConvention.Cdecl)]
             public static extern void Interpreter_Destroy(IntPtr handle);
@@ -53,9 +53,9 @@ namespace nebula
         : public IGCObject
     {
     public:
-        static std::shared_ptr<Bundle> FromDefinition(const BundleDefinition& definition);
+        // Bundles are created by the GC heap (see InterpreterMemory::AllocBundle)
+        explicit Bundle(const BundleDefinition& definition);
 
-    public:
         const std::string& Name() { return m_Name; }
         size_t FieldCount() const { return m_Fields.size(); }
 
@@ -63,10 +63,8 @@ namespace nebula
         DataStackVariant& GetByName(const std::string& name);
 
         bool SetAt(int index, DataStackVariant& data);
-        void ClearFields() { m_Fields.clear(); }
 
     private:
-        Bundle();
         std::string m_Name;
         std::vector<BundleField> m_Fields;
     };
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "Instruction.h"
+#include "LanguageTypes.h"
+#include "interfaces/IGCObject.h"
+
+namespace nebula
+{
+	class Frame;
+	class Function;
+	class Interpreter;
+	class BundleDefinition;
+
+	// Function pointer definition to bind Nebula function calls to C++ calls
+	using NativeFunctionCallback = ::std::function<InstructionErrorCode(Interpreter*, Frame*)>;
+
+	// Generation 0 is never handed out by an interpreter, a call site with it was never resolved
+	constexpr uint32_t UnresolvedCallSiteGeneration = 0;
+
+	// Cached target of a Call, Call_t, Newobj or CallVirt instruction.
+	// The cache is valid only while its generation matches the one of the executing interpreter,
+	// which changes every time the set of scripts or native bindings changes.
+	struct CallSite
+	{
+		uint32_t                        Generation{ UnresolvedCallSiteGeneration };
+		const Function*                 Target{ nullptr };
+		const NativeFunctionCallback*   NativeTarget{ nullptr };
+		const BundleDefinition*         BundleTarget{ nullptr };
+
+		// CallVirt only, the method is resolved at link time and is not part of the cache.
+		// Calls on primitives cache the type function (NativeTarget) for the last receiver type seen
+		VirtualMethod                   Method{ VirtualMethod::Unknown };
+		DataStackVariantIndex           ReceiverType{ DataStackVariantIndex::_UnknownType };
+	};
+
+	constexpr size_t InvalidGlobalSlot = static_cast<size_t>(-1);
+
+	// Cached slot of the global a LdSfld or StsFld instruction accesses, inside the global table of the interpreter.
+	// Same validity rules as a CallSite, scripts are given their slots when they are added
+	struct GlobalSite
+	{
+		uint32_t    Generation{ UnresolvedCallSiteGeneration };
+		size_t      Slot{ InvalidGlobalSlot };
+	};
+}
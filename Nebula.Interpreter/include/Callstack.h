@@ -7,6 +7,6 @@ namespace nebula
     class Frame;
 
     using CallStack = std::vector<Frame*>;
-    using CallstackVector = std::vector<CallStack>;
+    using CallstackVector = std::vector<CallStack*>;
 }
 
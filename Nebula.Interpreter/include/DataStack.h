@@ -1,39 +1,72 @@
 #pragma once
 
-#include <vector>
+#include <new>
+#include <memory>
 
 #include "LanguageTypes.h"
 
 namespace nebula
 {
     // The stack of a singular function call
+    // Slots live in storage provided by the owner (the frame allocation), the stack only
+    // moves to the heap if a function pushes more values than the capacity it was given
     class DataStack
     {
     public:
         DataStack() = default;
-        ~DataStack() = default;
-        DataStack(DataStack&&) = default;
+        DataStack(DataStackVariant* storage, size_t capacity)
+            : m_Begin{ storage }, m_Top{ storage }, m_End{ storage + capacity } {}
+        ~DataStack();
+        DataStack(DataStack&&) = delete;
         DataStack(const DataStack&) = delete;
 
-        inline DataStackVariant&    Peek()                  { return m_Data.back(); }
-        inline DataStackVariant&    Peek(size_t offset)     { return m_Data[m_Data.size() - 1 - offset]; }
-        inline void                 Pop()                   { return m_Data.pop_back(); }
-        inline size_t               Size() const            { return m_Data.size(); }
-        inline void                 Reserve(size_t newCap)  { m_Data.reserve(newCap); }
-
-        inline void Dup()                               { m_Data.emplace_back(m_Data.back()); }
-        inline void Push(TInt32 v)                      { m_Data.emplace_back(v); }
-        inline void Push(TFloat v)                      { m_Data.emplace_back(v); }
-        //inline void Push(TByte v)                       { m_Data.emplace_back(v); }
-        inline void Push(const TString& v)              { m_Data.emplace_back(v); }
-        inline void Push(const DataStackVariant& v)     { m_Data.emplace_back(v); }
-
-        std::vector<DataStackVariant>::iterator begin() { return m_Data.begin(); }
-        std::vector<DataStackVariant>::iterator  end() { return m_Data.end(); }
-        std::vector<DataStackVariant>::const_iterator   begin() const{ return m_Data.begin(); }
-        std::vector<DataStackVariant>::const_iterator   end() const { return m_Data.end(); }
-       
+        inline DataStackVariant&    Peek()                  { return m_Top[-1]; }
+        inline DataStackVariant&    Peek(size_t offset)     { return m_Top[-1 - (ptrdiff_t)offset]; }
+        inline void                 Pop()                   { std::destroy_at(--m_Top); }
+        inline size_t               Size() const            { return m_Top - m_Begin; }
+        inline size_t               Capacity() const        { return m_End - m_Begin; }
+        void                        Reserve(size_t newCap);
+        // Moves the top without constructing or destroying the slots in between, they must hold ints, floats or moved-from values.
+        // The register tier writes its temporaries directly in the slots and only brings the top in sync when needed
+        inline void                 SetSizeUnchecked(size_t size) { m_Top = m_Begin + size; }
+
+        inline void Dup()                               { Emplace(Peek()); }
+        inline void Push(TInt32 v)                      { Emplace(v); }
+        inline void Push(TFloat v)                      { Emplace(v); }
+        //inline void Push(TByte v)                       { Emplace(v); }
+        inline void Push(const TString& v)              { Emplace(v); }
+        inline void Push(SharedString* v)               { Emplace(v); }
+        inline void Push(const DataStackVariant& v)     { Emplace(v); }
+        inline void Push(DataStackVariant&& v)          { Emplace(std::move(v)); }
+
+        DataStackVariant* begin() { return m_Begin; }
+        DataStackVariant* end() { return m_Top; }
+        const DataStackVariant* begin() const { return m_Begin; }
+        const DataStackVariant* end() const { return m_Top; }
+
     private:
-        std::vector<DataStackVariant> m_Data;
+        template<typename TValue>
+        inline void Emplace(TValue&& v)
+        {
+            [[unlikely]]
+            if (m_Top == m_End)
+            {
+                // The value may live in this stack, take it before the slots move
+                DataStackVariant value{ std::forward<TValue>(v) };
+                Reserve(Capacity() > 0 ? Capacity() * 2 : 8);
+                ::new (m_Top) DataStackVariant(std::move(value));
+                m_Top++;
+                return;
+            }
+
+            ::new (m_Top) DataStackVariant(std::forward<TValue>(v));
+            m_Top++;
+        }
+
+        DataStackVariant* m_Begin{ nullptr };
+        DataStackVariant* m_Top{ nullptr };
+        DataStackVariant* m_End{ nullptr };
+        // Set once the values moved out of the owner storage
+        DataStackVariant* m_HeapStorage{ nullptr };
     };
 }
@@ -11,6 +11,8 @@ namespace nebula
 {
 	class Interpreter;
 	class Function;
+	class FramePool;
+	class RegisterCode;
 
 
 	// Rapresents a asingular executing function call
@@ -26,42 +28,71 @@ namespace nebula
 			Finished,
 		};
 
+		friend Status ExecuteBatch(Interpreter*, Frame*, size_t&);
+		template<bool TVerified>
+		friend Status ExecuteBatch(Interpreter*, Frame*, size_t&);
+		friend Status ExecuteRegisterBatch(Interpreter*, Frame*, const RegisterCode&, size_t&);
+		friend class FramePool;
+
+		// Operand stack slots reserved in the frame allocation are sized from Function::MaxStackDepth,
+		// functions deeper than this start with this many slots and move their stack to the heap if they need more
+		static constexpr size_t MaxReservedStackDepth = 256;
+
 	public:
-		// if discardParent is true then parent is not saved
-		// Async functions receive the parent ptr to fetch the parameters data
-		// but musn't store the parent ptr, otherwise they'll try to return values to it
-		Frame(Frame* parent, const Function* f, bool discardParent);
 		Frame(Frame&& f) = delete;
 		Frame(const Frame& f) = delete;
-		~Frame() = default;
+
+		// Size of the single allocation holding the frame, its variables and its operand stack
+		static size_t AllocationSize(const Function* f);
+		// Byte offset from a frame to the value of its variable at index (parameters first) and to its operand stack slot,
+		// the registers of the register tier (see RegisterCode)
+		static TInt32 VariableRegister(size_t index);
+		static TInt32 StackRegister(const Function* f, size_t slot);
 
 		// Execute the next instruction
 		Status Tick(Interpreter*);
 		Status RunToCompletion(Interpreter*);
+		// Execute instructions until the frame calls, returns, yields or the budget is consumed
+		Status TickBatch(Interpreter*, size_t& budget);
 
 		inline DataStack& Stack() { return m_Stack; }
 		inline const DataStack& Stack() const { return m_Stack; }
 		inline FrameMemory& Memory() { return m_Memory; }
 		inline Frame* Parent() { return m_ParentFrame; }
+		// Frame of the call in progress, nullptr while this frame runs
+		inline const Frame* Child() const { return m_ChildFrame; }
 		inline const FrameMemory& Memory() const { return m_Memory; };
 		inline const Function* GetFunction() const { return m_FunctionDefinition; }
 		inline InstructionErrorCode GetLastError() const { return m_LastErrorCode; }
 		inline size_t NextInstructionIndex() const { return m_NextInstructionIndex; }
+		inline unsigned long long WakeTime() const { return m_Scheduler.WakeTime(); }
+		inline const FrameScheduler& Scheduler() const { return m_Scheduler; }
 		const std::string& Namespace();
 
 	public:
 		void SetScheduledSleep(const size_t& amount);
 		void SetNextInstruction(size_t index);
-		void WaitForNotification(IGCObject*, const std::string& notification);
-		void EndOnNotification(IGCObject*, const std::string& hashNotification);
+		void SetThreadScheduler(ThreadScheduler* scheduler) { m_Scheduler.SetThreadScheduler(scheduler); }
+		void WaitForNotification(IGCObject*, size_t notificationHash);
+		void EndOnNotification(IGCObject*, size_t notificationHash);
 
 	private:
+		// Frames are only created by the FramePool, the variables and stack slots are placed right after the frame
+		// if discardParent is true then parent is not saved
+		// Async functions receive the parent ptr to fetch the parameters data
+		// but musn't store the parent ptr, otherwise they'll try to return values to it
+		Frame(Frame* parent, const Function* f, bool discardParent);
+		~Frame();
+
+		Variable* VariableStorage();
+		DataStackVariant* StackStorage();
+
 		void Kill();
 
 		// The read-only definition of this function
 		const Function* m_FunctionDefinition;
 		Frame* m_ParentFrame;
-		Frame* m_ChildFrame;
+		Frame* m_ChildFrame{ nullptr };
 
 		size_t m_NextInstructionIndex;
 		FrameScheduler m_Scheduler;
@@ -69,6 +100,10 @@ namespace nebula
 		DataStack m_Stack;
 
 		InstructionErrorCode m_LastErrorCode{ InstructionErrorCode::None };
+
+		// Size class of the FramePool block holding the frame, recorded when created since
+		// the allocation size of the function can change if it is linked again while the frame is alive
+		size_t m_PoolSizeClass{ 0 };
 	};
 }
 
@@ -4,10 +4,12 @@
 
 namespace nebula
 {
+    // Parameters followed by the locals of a function call, the variables are constructed in
+    // storage provided by the owner (the frame allocation)
     class FrameMemory
     {
     public:
-        FrameMemory(size_t paramCount, size_t localCount);
+        FrameMemory(Variable* storage, size_t paramCount, size_t localCount);
         FrameMemory(FrameMemory&& f) = delete;
         FrameMemory(const FrameMemory&) = delete; // No copy allowed
         ~FrameMemory();
@@ -17,6 +19,10 @@ namespace nebula
         const Variable& LocalAt(size_t i) const;
         const Variable& ParamAt(size_t i) const;
 
+        // No bounds checks, only for indices proven valid by the ScriptVerifier
+        inline Variable& UncheckedLocalAt(size_t i) { return m_Variables[m_ParamCount + i]; }
+        inline Variable& UncheckedParamAt(size_t i) { return m_Variables[i]; }
+
         size_t ParamCount() const { return m_ParamCount; }
         size_t LocalCount() const { return m_LocalCount; }
 
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+
+namespace nebula
+{
+	class Frame;
+	class Function;
+
+	// Recycles the memory of finished frames.
+	// A frame, its variables and its operand stack are one block; blocks are grouped in power of two
+	// size classes and kept on a free list when the frame ends, so calls stop reaching the heap once warm.
+	class FramePool
+	{
+	public:
+		FramePool() = default;
+		~FramePool();
+		FramePool(const FramePool&) = delete;
+		FramePool(FramePool&&) = delete;
+
+		Frame* Create(Frame* parent, const Function* f, bool discardParent);
+		void Destroy(Frame* frame);
+
+		// Give every cached block back to the heap
+		void Trim();
+
+		// Frames created and not destroyed yet
+		size_t LiveCount() const { return m_LiveCount; }
+
+	private:
+		static constexpr size_t MinBlockSize = 512;
+		static constexpr size_t SizeClassCount = 8; // Up to 64KB, bigger frames are not cached
+
+		struct FreeBlock
+		{
+			FreeBlock* Next;
+		};
+
+		// Returns SizeClassCount if the size is not cached
+		static size_t SizeClassOf(size_t allocationSize);
+		static size_t BlockSizeOf(size_t sizeClass) { return MinBlockSize << sizeClass; }
+
+		std::array<FreeBlock*, SizeClassCount> m_FreeBlocks{};
+		size_t m_LiveCount{ 0 };
+	};
+}
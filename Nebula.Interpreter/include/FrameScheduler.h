@@ -1,12 +1,14 @@
 #pragma once
 
 #include "interfaces/IGCObject.h"
-#include <map>
+#include <vector>
+#include <utility>
 
 namespace nebula
 {
 	class Frame;
 	class IGCObject;
+	class ThreadScheduler;
 
 	// Enables control of a Frame state (messaging and waiting)
 	class FrameScheduler
@@ -19,21 +21,47 @@ namespace nebula
 		void Sleep(size_t amount);
 		void Kill();
 
-		void WaitForNotification(IGCObject* notifier, const std::string& str);
+		// Notifications are identified by the hash of their name (see SharedString::Hash)
+		void WaitForNotification(IGCObject* notifier, size_t notificationHash);
 
-		void EndOnNotification(IGCObject* notifier, const std::string& str);
+		void EndOnNotification(IGCObject* notifier, size_t notificationHash);
 
-		// Returns true if the frame is sleeping, will also check time passed and clear flag
-		bool IsSleeping();
+		// Returns true if the frame is sleeping, will also check time passed and clear flag.
+		// The time is provided by the caller so that the clock is not read for every tick
+		bool IsSleeping(unsigned long long currentMillis);
 		bool HasBeenKilled() const { return m_Killed; }
+		// Absolute time at which the sleep ends, 0 if not sleeping
+		unsigned long long WakeTime() const { return m_SleepAmount; }
+
+		// Scheduler that parks the owning thread while it is blocked, notifications that unblock the frame wake it up
+		void SetThreadScheduler(ThreadScheduler* scheduler) { m_pThreadScheduler = scheduler; }
 
 		virtual bool OnNotification(IGCObject* sender, const size_t notification) override;
+
+		// Calls func with every object the frame waits on or ends on
+		template<typename TFunc>
+		void ForEachNotifier(TFunc&& func) const
+		{
+			for (const auto& wait : m_WaitingHashes)
+			{
+				func(wait.first);
+			}
+
+			for (const auto& wait : m_WaitingEndonHashes)
+			{
+				func(wait.first);
+			}
+		}
 	private:
+		// A frame waits on a handful of objects at most, a vector is cheaper than a map to create with every frame
+		using WaitingHashes = std::vector<std::pair<IGCObject*, std::unordered_set<size_t>>>;
+
 		Frame* m_Parent;
+		ThreadScheduler* m_pThreadScheduler{ nullptr };
 		size_t m_SleepAmount{ 0 };
 		bool m_Killed{ false };
-		std::map<IGCObject*, std::unordered_set<size_t>> m_WaitingHashes;
-		std::map<IGCObject*, std::unordered_set<size_t>> m_WaitingEndonHashes;
+		WaitingHashes m_WaitingHashes;
+		WaitingHashes m_WaitingEndonHashes;
 
 		bool FindAndRemoveWaitingHash(IGCObject* sender, const size_t notification);
 		bool FindAndRemoveEndonHash(IGCObject* sender, const size_t notification);
@@ -6,6 +6,8 @@
 
 #include "LanguageTypes.h"
 #include "InstructionDefs.h"
+#include "LinkedCode.h"
+#include "RegisterCode.h"
 
 namespace nebula
 {
@@ -13,33 +15,61 @@ namespace nebula
 
     using VariableList = std::vector<DataStackVariantIndex>;
     using AttributeList = std::vector<VMAttribute>;
-    using InstructionArguments = std::vector<DataStackVariant>;
-    using FunctionInstruction = std::pair<VMInstruction, InstructionArguments>;
-    using FunctionBody = std::vector<FunctionInstruction>;
 
     // In memory definition of a script function
     class Function
     {
+        friend class ScriptVerifier;
+        friend class RegisterCode;
     public:
+        // Stack height of the instructions a verified function never reaches (see m_StackHeights)
+        static constexpr size_t UnreachedStackHeight = static_cast<size_t>(-1);
+
         Function(const Script* parentScript, DataStackVariantIndex returnType, const std::string& name);
 
 		const Script* GetScript() const { return m_ParentScript; }
         const std::string& Namespace() const;
         const std::string& Name() const { return m_Name; }
+        // Parsed instructions, empty for functions loaded from a script image (see InstructionAt)
         const FunctionBody& Instructions() const { return m_Body; }
+        // Instruction at index as parsed, rebuilt from the linked code when there is no parsed body
+        FunctionInstruction InstructionAt(size_t index) const;
+        // Line of the script text each instruction was parsed from, empty when not known
+        const std::vector<uint32_t>& SourceLines() const { return m_SourceLines; }
+        const LinkedCode& Code() const { return m_Code; }
         const AttributeList& Attributes() const { return m_Attributes; }
         const VariableList& Parameters() const { return m_Parameters; }
         const VariableList& Locals() const { return m_LocalVariables; }
         DataStackVariantIndex ReturnType() const { return m_ReturnType; }
+        // Upper bound of the values this function keeps on its operand stack, known once linked
+        size_t MaxStackDepth() const { return m_MaxStackDepth; }
+        // Set by the ScriptVerifier once every operand type is known, the function then runs without runtime checks
+        bool IsVerified() const { return m_IsVerified; }
+
+        // Counted by the interpreter to find hot functions, returns the calls made so far
+        size_t CountCall() const { return ++m_CallCount; }
+        // Register tier of the function (see RegisterCode), nullptr while it only runs on the stack engine
+        const RegisterCode* RegisterTier() const { return m_RegisterTier.get(); }
+        // Translates the function to the register tier, false if it stays on the stack engine
+        bool PromoteToRegisterTier() const;
 
         bool AddAttribute(VMAttribute attribute);
         bool AddLocalVariable(DataStackVariantIndex type);
         bool AddParameter(DataStackVariantIndex type);
         bool AppendInstruction(const FunctionInstruction& instruction);
+        void SetSourceLines(std::vector<uint32_t>&& lines);
+        // Adopt code lowered ahead of time instead of a parsed body (see LinkedCode::Load)
+        bool LoadCode(std::vector<LinkedInstruction>&& instructions, std::vector<SharedString*>&& strings);
+
+        // Lower the parsed body into the flat instruction stream used during execution,
+        // loaded code is restored to the form it was loaded with
+        bool Link();
 
         bool HasAttribute(VMAttribute attr) const;
 
     private:
+        void ComputeMaxStackDepth();
+
         const Script* m_ParentScript{ nullptr };
 
         DataStackVariantIndex   m_ReturnType;
@@ -49,6 +79,17 @@ namespace nebula
         AttributeList           m_Attributes;
         VariableList            m_LocalVariables;
         FunctionBody            m_Body;
+        LinkedCode              m_Code;
+        std::vector<uint32_t>   m_SourceLines;
+        bool                    m_IsLoaded{ false };
+        size_t                  m_MaxStackDepth{ 0 };
+        bool                    m_IsVerified{ false };
+        // Operand stack height before each instruction, only recorded for verified functions
+        // (UnreachedStackHeight for the instructions that are never reached)
+        std::vector<size_t>     m_StackHeights;
+
+        mutable size_t                          m_CallCount{ 0 };
+        mutable std::unique_ptr<RegisterCode>   m_RegisterTier;
     };
 }
 
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "interfaces/IGCObject.h"
+
+namespace nebula
+{
+	// Storage of the objects created by scripts. Objects are referenced by raw pointer, there is no reference counting:
+	// they are only destroyed by a sweep once the collector left them unmarked, or when the heap itself is destroyed.
+	// Small objects are carved out of pages of same sized slots (one set of pages per size class),
+	// bigger ones get an allocation of their own.
+	// New objects are young and listed in the nursery, they become old (and leave it) once they survive a sweep.
+	class GCHeap
+	{
+	public:
+		static constexpr size_t SlotGranularity = 16;
+		static constexpr size_t MaxSmallObjectSize = 256;
+		static constexpr size_t PageSize = 16 * 1024;
+
+		GCHeap() = default;
+		GCHeap(const GCHeap&) = delete;
+		GCHeap& operator=(const GCHeap&) = delete;
+		~GCHeap();
+
+		template<typename TObject, typename... TArgs>
+		TObject* New(TArgs&&... args)
+		{
+			static_assert(std::is_base_of_v<IGCObject, TObject>, "Only GC objects live in the heap");
+			static_assert(alignof(TObject) <= SlotGranularity, "Slots are only aligned to their granularity");
+
+			SlotLocation location{};
+			void* memory = Allocate(sizeof(TObject), location);
+			TObject* object{ nullptr };
+			try
+			{
+				object = new (memory) TObject(std::forward<TArgs>(args)...);
+			}
+			catch (...)
+			{
+				Release(sizeof(TObject), location, memory);
+				throw;
+			}
+
+			Track(sizeof(TObject), location, memory, object);
+			return object;
+		}
+
+		// Destroys the unmarked objects and promotes the others clearing their mark, returns how many were destroyed
+		size_t Sweep();
+		// Same as Sweep only for young objects, old ones are left untouched and must not be marked
+		size_t SweepNursery();
+
+		// Incremental sweep of the old objects, young ones only get their mark cleared and stay in the nursery.
+		// Objects can be allocated between slices, Sweep and SweepNursery can't be used until the sweep completed
+		void BeginSweep();
+		// Visits up to budget slots or objects and decreases budget by the amount visited, returns true once the sweep completed
+		bool SweepSlice(size_t& budget);
+		// Objects destroyed since BeginSweep
+		inline size_t SweptCount() const { return m_SweepCursor.Destroyed; }
+
+		// Calls func with every object, old or young
+		template<typename TFunc>
+		void ForEachObject(TFunc&& func) const
+		{
+			for (const SizeClass& sizeClass : m_SizeClasses)
+			{
+				for (const Page& page : sizeClass.Pages)
+				{
+					for (IGCObject* object : page.Objects)
+					{
+						if (object != nullptr)
+						{
+							func(object);
+						}
+					}
+				}
+			}
+
+			for (const LargeObject& large : m_LargeObjects)
+			{
+				func(large.Object);
+			}
+
+			// Young small objects were visited with the pages
+			for (const NurseryEntry& entry : m_Nursery)
+			{
+				if (entry.SizeClass == LargeSizeClass)
+				{
+					func(entry.Object);
+				}
+			}
+		}
+
+		// Calls func with every young object
+		template<typename TFunc>
+		void ForEachYoungObject(TFunc&& func) const
+		{
+			for (const NurseryEntry& entry : m_Nursery)
+			{
+				func(entry.Object);
+			}
+		}
+
+		inline size_t ObjectCount() const { return m_ObjectCount; }
+		inline size_t NurseryCount() const { return m_Nursery.size(); }
+		inline bool Empty() const { return m_ObjectCount == 0; }
+
+	private:
+		static constexpr size_t SizeClassCount = MaxSmallObjectSize / SlotGranularity;
+
+		// Slot of a small object inside the pages of its size class
+		struct SlotLocation
+		{
+			uint32_t Page;
+			uint32_t Slot;
+		};
+
+		struct Page
+		{
+			std::unique_ptr<std::byte[]> Memory;
+			// One entry per slot, nullptr while the slot is free
+			std::vector<IGCObject*> Objects;
+		};
+
+		struct SizeClass
+		{
+			std::vector<Page> Pages;
+			std::vector<SlotLocation> FreeSlots;
+		};
+
+		struct LargeObject
+		{
+			void* Memory;
+			IGCObject* Object;
+		};
+
+		static constexpr uint32_t LargeSizeClass = static_cast<uint32_t>(-1);
+
+		// Where a young object lives so that it can be freed without searching the pages
+		struct NurseryEntry
+		{
+			IGCObject* Object;
+			void* Memory;
+			uint32_t SizeClass;
+			SlotLocation Location;
+		};
+
+		// Progress of an incremental sweep: small objects of every size class, then old large objects, then young large objects
+		struct SweepCursor
+		{
+			size_t SizeClass;
+			size_t Page;
+			size_t Slot;
+			size_t Large;
+			size_t Nursery;
+			size_t Destroyed;
+		};
+
+		static inline size_t SizeClassOf(size_t size) { return (size + SlotGranularity - 1) / SlotGranularity - 1; }
+		static inline size_t SlotSizeOf(size_t sizeClass) { return (sizeClass + 1) * SlotGranularity; }
+
+		void* Allocate(size_t size, SlotLocation& location);
+		// Gives back memory that never held a constructed object
+		void Release(size_t size, const SlotLocation& location, void* memory);
+		void Track(size_t size, const SlotLocation& location, void* memory, IGCObject* object);
+		void AddPage(SizeClass& sizeClass, size_t slotSize);
+		void Destroy(const NurseryEntry& entry);
+		static inline void Promote(IGCObject* object) { object->m_bIsMarked = false; object->m_bIsOld = true; }
+
+		std::array<SizeClass, SizeClassCount> m_SizeClasses{};
+		// Old objects only, young ones are still in the nursery
+		std::vector<LargeObject> m_LargeObjects;
+		std::vector<NurseryEntry> m_Nursery;
+		SweepCursor m_SweepCursor{};
+		size_t m_ObjectCount{ 0 };
+	};
+}
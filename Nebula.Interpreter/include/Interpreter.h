@@ -1,30 +1,30 @@
 #pragma once
 
 #include <atomic>
-#include <chrono>
 #include <functional>
 
 #include "ThreadMap.h"
+#include "ThreadScheduler.h"
 #include "LanguageTypes.h"
 
 #include "Frame.h"
 #include "Script.h"
+#include "CallSite.h"
 #include "Instruction.h"
 #include "ErrorCallStack.h"
 #include "InterpreterMemory.h"
 
 namespace nebula
 {
-	// Function pointer definition to bind Nebula function calls to C++ calls
-	using NativeFunctionCallback = ::std::function<InstructionErrorCode(Interpreter*, Frame*)>;
 	using NativeFunctionCallbackPtr = InstructionErrorCode(*)(Interpreter*, Frame*);
 	using InterpreterExitCallbackPtr = void(*)();
 	class IStreamWrapper;
+	class OpcodeProfiler;
 
 	// Core of the virtual machine
 	class Interpreter
 	{
-		friend InstructionErrorCode ExecuteInstruction(VMInstruction, Interpreter*, Frame*, const InstructionArguments&);
+		friend InstructionErrorCode ExecuteInstruction(const LinkedInstruction&, Interpreter*, Frame*);
 
 	public:
 		enum State
@@ -35,6 +35,27 @@ namespace nebula
 			Exited,
 		};
 
+		// How Run() advances the executing frames
+		enum class ExecutionMode
+		{
+			SingleStep, // One instruction per scheduler pass, what the debugger needs
+			Batched,    // Run instructions of a frame until it calls, returns, yields or consumes its batch
+		};
+
+		// When a running script thread gets preempted in favour of the next one
+		enum class SchedulingMode
+		{
+			TimeSlice,          // After MaxExecutionTime milliseconds, the clock is sampled every ClockSampleInterval instructions
+			InstructionBudget,  // After InstructionBudget instructions, the clock is never read
+		};
+
+		// How full collections of the heap run, collections of the young objects only always run at once
+		enum class CollectionMode
+		{
+			StopTheWorld,   // Inside the allocation reaching the heap threshold
+			Incremental,    // In slices run after each step, bounded by GCSliceWork and GCSliceTime
+		};
+
 	public:
 		Interpreter();
 		~Interpreter();
@@ -55,15 +76,65 @@ namespace nebula
 		bool BindNativeFunction(const std::string& name, const NativeFunctionCallback callback);
 		bool BindTypeFunction(const std::string& name, DataStackVariantIndex type, const NativeFunctionCallback callback);
 		bool AddScript(std::shared_ptr<Script> script);
+		// Same as AddScript, the reasons a script is refused (e.g. failed verification) are added to the report
+		bool AddScript(std::shared_ptr<Script> script, shared::DiagnosticReport& report);
+		// Same as calling AddScript with every script in order: they are linked and verified concurrently on up to threadCount threads
+		// (0 to use every core), then added and their autoexec functions scheduled in order on the calling thread.
+		// Calls into scripts of the set are verified as if the ones before them were already added.
+		// reports gets one report per script. Returns false if any script was refused, the ones after it are not added
+		bool AddScripts(const std::vector<std::shared_ptr<Script>>& scripts, std::vector<shared::DiagnosticReport>& reports, size_t threadCount = 0);
 		bool SetStandardOutput(IStreamWrapper* stream);
 		bool SetExitCallback(InterpreterExitCallbackPtr callbackPtr);
 		bool ClearStandardOutput();
 
+		// Objects handed to the host are only kept alive by the collector while pinned (see InterpreterMemory::Pin)
+		void PinObject(IGCObject* object) { m_Memory.Pin(object); }
+		void UnpinObject(IGCObject* object) { m_Memory.Unpin(object); }
+
 		bool Step();
+		bool StepBatch();
+
+		void SetExecutionMode(ExecutionMode mode) { m_ExecutionMode = mode; }
+		ExecutionMode GetExecutionMode() const { return m_ExecutionMode; }
+		void SetBatchSize(size_t instructionCount) { m_BatchSize = instructionCount > 0 ? instructionCount : 1; }
+		size_t GetBatchSize() const { return m_BatchSize; }
+
+		void SetSchedulingMode(SchedulingMode mode) { m_SchedulingMode = mode; }
+		SchedulingMode GetSchedulingMode() const { return m_SchedulingMode; }
+		void SetMaxExecutionTime(int milliseconds) { m_MaxExecutionTime = milliseconds > 0 ? milliseconds : 0; }
+		int GetMaxExecutionTime() const { return m_MaxExecutionTime; }
+		void SetInstructionBudget(size_t instructionCount) { m_InstructionBudget = instructionCount > 0 ? instructionCount : 1; }
+		size_t GetInstructionBudget() const { return m_InstructionBudget; }
+		void SetClockSampleInterval(size_t instructionCount) { m_ClockSampleInterval = instructionCount > 0 ? instructionCount : 1; }
+		size_t GetClockSampleInterval() const { return m_ClockSampleInterval; }
+		// Functions called this many times run in the register tier (see RegisterCode), 0 keeps every function on the stack engine
+		void SetHotCallThreshold(size_t calls) { m_HotCallThreshold = calls; }
+		size_t GetHotCallThreshold() const { return m_HotCallThreshold; }
+
+		void SetCollectionMode(CollectionMode mode) { m_Memory.SetIncremental(mode == CollectionMode::Incremental); }
+		CollectionMode GetCollectionMode() const { return m_Memory.IsIncremental() ? CollectionMode::Incremental : CollectionMode::StopTheWorld; }
+		// Objects traced or heap slots swept by a collection slice
+		void SetGCSliceWork(size_t work) { m_Memory.SetSliceWork(work); }
+		size_t GetGCSliceWork() const { return m_Memory.GetSliceWork(); }
+		// Microseconds a collection slice may last, 0 to only bound slices by their work
+		void SetGCSliceTime(unsigned int microseconds) { m_Memory.SetSliceTime(microseconds); }
+		unsigned int GetGCSliceTime() const { return m_Memory.GetSliceTime(); }
+		// Every allocation collects and checks the heap integrity, for testing the collector
+		void SetGCStressMode(bool stress) { m_Memory.SetStressMode(stress); }
+		bool GetGCStressMode() const { return m_Memory.IsStressMode(); }
+		// Gives idle time to the collector, must not be called while stepping. Returns true once there is nothing left to collect
+		bool CollectGarbage(unsigned int microseconds) { return m_Memory.CollectFor(microseconds); }
+
+		// Every executed instruction is recorded by the profiler, Run() then single steps. Not owned, nullptr to disable
+		void SetOpcodeProfiler(OpcodeProfiler* profiler) { m_pOpcodeProfiler = profiler; }
+		OpcodeProfiler* GetOpcodeProfiler() const { return m_pOpcodeProfiler; }
+
+		// Time sampled by the scheduler, may lag behind the real clock by up to a thread rotation
+		unsigned long long GetSchedulerTime() const { return m_SchedulerTime; }
 
 		// Getters
 	public:
-		const size_t GetCurrentThreadId() const { return m_CurrentThreadIndex; }
+		const size_t GetCurrentThreadId() const { return m_Threads.IndexOf(m_ThreadScheduler.Current()); }
 
 		const ThreadMap& GetThreadMap() { return m_Threads; }
 		IStreamWrapper* StandardOutput() { return m_pStandardOutput; }
@@ -71,43 +142,71 @@ namespace nebula
 
 	private:
 		bool CheckAndSetExitState();
+		void OnFrameTicked(Frame*, Frame::Status, size_t executedInstructions);
+		void UpdateSchedulerTime();
 
 		void SetState(State);
-		bool ShouldScheduleNewFrame();
+		bool ShouldScheduleNewFrame(size_t executedInstructions);
 		void SwapExecutingThread();
+		void BeginTimeSlice();
+		void WaitForRunnableThread();
 		void CreateFrameOnStack(const Function*, bool);
 		void BuildErrorStack(Frame*);
 		std::string BuildGuiltyInstructionLineForCallStack(Frame*);
 
+		// AddScript steps, only the last one changes the interpreter
+		bool CanAddScript(const Script&, shared::DiagnosticReport&) const;
+		bool RegisterScript(std::shared_ptr<Script>);
+
+		// Call sites cached with an older generation are resolved again on their next execution
+		void InvalidateCallSites();
+		void ResolveCallSites(const Script*);
+		void ResolveCallSite(const Function*, const LinkedInstruction&, CallSite&) const;
+		void ResolveGlobalSite(const Function*, const LinkedInstruction&, GlobalSite&) const;
+
 		const Function* GetFunction(const std::string&, const std::string&) const;
 		const BundleDefinition* GetBundleDefinition(const std::string&, const std::string&) const;
 		const NativeFunctionCallback* GetNativeFunction(const std::string&) const;
 		const NativeFunctionCallback* GetTypeFunction(DataStackVariantIndex, const std::string&) const;
 
 		/// <summary>
-		/// Thread map can be re-allocated at any time, do not store a ptr to the current callstack
+		/// The executing thread changes on every scheduling decision, do not store a ptr to the current callstack
 		/// </summary>
-		/// <returns></returns>
-		CallStack* GetCurrentCallstack();
+		/// <returns>nullptr if no thread is runnable</returns>
+		CallStack* GetCurrentCallstack() { return m_ThreadScheduler.Current(); }
 	private:
 		std::map<const std::string, NativeFunctionCallback> m_NativeFunctions{};
 		std::map<const DataStackVariantIndex, std::map < const std::string, NativeFunctionCallback>> m_TypeNativeFunctions;
 
 		std::map<const std::string, std::shared_ptr<Script>> m_Scripts{};
 
+		uint32_t m_CallSiteGeneration{ UnresolvedCallSiteGeneration };
+
 		ThreadMap m_Threads;
-		size_t m_CurrentThreadIndex{ 0 };
+		ThreadScheduler m_ThreadScheduler;
 
 		State m_CurrentState{ State::Paused };
+		ExecutionMode m_ExecutionMode{ ExecutionMode::Batched };
+		size_t m_BatchSize{ 256 };
+		size_t m_HotCallThreshold{ 100 };
 		bool m_StartedOnce{ false };
 		std::atomic_flag m_IsVMRunning = ATOMIC_FLAG_INIT;
 		shared::ErrorCallStack* m_LastErrorCallstack;
 
+		SchedulingMode m_SchedulingMode{ SchedulingMode::TimeSlice };
 		int m_MaxExecutionTime = 10;// Milliseconds
-		std::chrono::steady_clock::time_point m_LastSchedulingUpdate{};
+		size_t m_InstructionBudget{ 10000 };
+		size_t m_ClockSampleInterval{ 64 };
+
+		// Current time slice
+		unsigned long long m_SchedulerTime{ 0 };
+		unsigned long long m_SliceStartTime{ 0 };
+		size_t m_SliceInstructionCount{ 0 };
+		size_t m_NextClockSample{ 0 };
 
 		IStreamWrapper* m_pStandardOutput;
-		InterpreterExitCallbackPtr m_fExitCallback;
+		InterpreterExitCallbackPtr m_fExitCallback{ nullptr };
+		OpcodeProfiler* m_pOpcodeProfiler{ nullptr };
 		InterpreterMemory m_Memory;
 	};
 }
\ No newline at end of file
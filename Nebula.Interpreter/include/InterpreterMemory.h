@@ -1,20 +1,29 @@
 #pragma once
 
 #include <map>
-#include <unordered_set>
+#include <string>
+#include <vector>
+#include <unordered_map>
 
 #include "LanguageTypes.h"
 #include "Variable.h"
 #include "Bundle.h"
+#include "CallSite.h"
+#include "GCHeap.h"
 
 namespace nebula
 {
 	class IGCObject;
+	class Frame;
 	class Script;
 	class Interpreter;
 
-	using AllocableObjectPtr = std::shared_ptr<IGCObject>;
-
+	// Objects and globals of an interpreter. Objects are reclaimed by a mark and sweep collector tracing from
+	// the frames of every thread, the globals and the objects pinned by the host.
+	// Collections are generational: most of them only trace and sweep the young objects, old objects and globals
+	// storing a young object are remembered by the write barriers so that the young object is kept alive.
+	// Full collections either run at once or incrementally, in slices interleaved with the execution (see CollectSlice):
+	// while marking, the write barriers shade the stored objects gray and the stacks are scanned again before sweeping
 	class InterpreterMemory
 	{
 	public:
@@ -24,17 +33,132 @@ namespace nebula
 		TArray AllocArray(const DataStackVariantIndex& type);
 
 		void Collect(bool force = false);
-		void Sweep();
-		bool Empty() { return m_IGCObjects.empty(); }
+		bool Empty() const { return m_Heap.Empty(); }
+
+		// Full collections are spread over slices instead of running inside the allocation needing them
+		void SetIncremental(bool incremental) { m_bIncremental = incremental; }
+		bool IsIncremental() const { return m_bIncremental; }
+		// Work of a slice, in objects traced or heap slots swept
+		void SetSliceWork(size_t work) { m_SliceWork = work > 0 ? work : 1; }
+		size_t GetSliceWork() const { return m_SliceWork; }
+		// Duration of a slice in microseconds, 0 to only bound slices by their work
+		void SetSliceTime(unsigned int microseconds) { m_SliceTime = microseconds; }
+		unsigned int GetSliceTime() const { return m_SliceTime; }
+
+		// Every allocation runs a collection and checks the heap afterwards, the process is aborted on the first inconsistency.
+		// Much slower, meant to validate the roots and the write barriers
+		void SetStressMode(bool stress) { m_bStressMode = stress; }
+		bool IsStressMode() const { return m_bStressMode; }
+		// Checks that every live frame is a root, that every object reachable from the roots is alive and that the generational invariants hold
+		bool VerifyHeap(std::string& error) const;
+
+		// True while an incremental collection is in progress
+		inline bool IsCollecting() const { return m_Phase != CollectionPhase::Idle; }
+		// Advances the incremental collection in progress by one slice
+		void CollectSlice();
+		// Spends up to microseconds advancing the incremental collection, one is started if the heap grew enough
+		// since the last one. Returns true once there is nothing left to collect
+		bool CollectFor(unsigned int microseconds);
 
+		// Objects held by the host are invisible to the collector, they must be pinned for as long as they are used.
+		// Pins are counted, an object is collectable again once unpinned as many times as it was pinned
+		void Pin(IGCObject* object);
+		void Unpin(IGCObject* object);
+
+		// Frames run outside of every thread (initializers run while their script is added) are only roots while pushed here
+		void PushFrameRoot(const Frame* frame) { m_FrameRoots.push_back(frame); }
+		void PopFrameRoot() { m_FrameRoots.pop_back(); }
+
+		// Appends the globals of the script to the global table
 		void AddGlobals(const Script* script);
-		Variable* GetGlobal(const std::string_view& namespaceStr, TInt32 index);
+		// Slot of a global in the global table, InvalidGlobalSlot if the script or the index don't exist
+		size_t GlobalSlot(const std::string_view& namespaceStr, TInt32 index) const;
+		inline Variable& GlobalAt(size_t slot) { return m_Globals[slot]; }
+
+		// Must be called before storing a value in a field or element of owner
+		inline void FieldWriteBarrier(IGCObject* owner, const DataStackVariant& value)
+		{
+			IGCObject* obj = value.AsObject();
+			if (obj != nullptr && !obj->m_bIsOld && owner->m_bIsOld && !owner->m_bIsRemembered)
+			{
+				owner->m_bIsRemembered = true;
+				m_RememberedObjects.push_back(owner);
+			}
+
+			[[unlikely]]
+			if (m_Phase == CollectionPhase::Mark)
+			{
+				MarkObject(obj, m_GrayObjects, false);
+			}
+		}
+
+		// Must be called before storing a value in the global at slot
+		inline void GlobalWriteBarrier(size_t slot, const DataStackVariant& value)
+		{
+			IGCObject* obj = value.AsObject();
+			if (obj != nullptr && !obj->m_bIsOld && !m_DirtyGlobals[slot])
+			{
+				m_DirtyGlobals[slot] = true;
+				m_RememberedGlobals.push_back(slot);
+			}
+
+			[[unlikely]]
+			if (m_Phase == CollectionPhase::Mark)
+			{
+				MarkObject(obj, m_GrayObjects, false);
+			}
+		}
 
 	private:
+		enum class CollectionPhase
+		{
+			Idle,
+			Mark,	// Gray objects are traced a few at a time
+			Sweep,	// Old objects left white are destroyed a few slots at a time
+		};
+
+		static void MarkObject(IGCObject* obj, std::vector<IGCObject*>& grayObjects, bool youngOnly);
+		static void MarkChildren(IGCObject* obj, std::vector<IGCObject*>& grayObjects, bool youngOnly);
+		// Frames of every thread and the frame roots, with the calls they have in progress
+		template<typename TFunc>
+		void ForEachRootFrame(TFunc&& func) const;
+		// Roots held by the threads and the host, globals excluded
+		template<typename TFunc>
+		void ForEachStackRoot(TFunc&& func) const;
+		void GatherStackRoots(std::vector<IGCObject*>& grayObjects, bool youngOnly) const;
+		void CollectNursery();
+		void CollectAll();
+		void ClearRememberedSets();
+		void AdaptThreshold(size_t startingSize, size_t reductionAmount);
+		void CollectStress();
+
+		void BeginCycle();
+		// Returns true once the collection completed, a slice without deadline is only bounded by its work
+		bool RunSlice(size_t work, unsigned long long deadline);
+		void FinishMarking();
+		void FinishCycle();
+
 		Interpreter* m_pParent;
-		std::list<AllocableObjectPtr> m_IGCObjects;
+		GCHeap m_Heap;
 		size_t m_iGCThreshold;
-		std::map<const std::string_view, std::vector< Variable>> m_ScriptGlobals{};
+		std::unordered_map<IGCObject*, size_t> m_PinnedObjects{};
+		std::vector<const Frame*> m_FrameRoots{};
+		// Globals of all scripts laid out contiguously, each script owns a range starting at its base slot
+		std::vector<Variable> m_Globals{};
+		std::map<const std::string_view, std::pair<size_t, size_t>> m_ScriptGlobalRanges{};
+		// Old objects and global slots which may reference young objects since the last collection
+		std::vector<IGCObject*> m_RememberedObjects{};
+		std::vector<size_t> m_RememberedGlobals{};
+		std::vector<bool> m_DirtyGlobals{};
+
+		bool m_bIncremental{ false };
+		size_t m_SliceWork;
+		unsigned int m_SliceTime{ 0 };
+		CollectionPhase m_Phase{ CollectionPhase::Idle };
+		std::vector<IGCObject*> m_GrayObjects{};
+		size_t m_CycleStartingSize{ 0 };
+		bool m_bStressMode{ false };
+		size_t m_StressCollections{ 0 };
 	};
 }
 
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+
+#include "LanguageTypes.h"
+#include "InstructionDefs.h"
+#include "Instruction.h"
+#include "CallSite.h"
+#include "SharedString.h"
+
+namespace nebula
+{
+	// Instructions as they are produced by the script parsers
+	using FunctionInstruction = std::pair<VMInstruction, InstructionArguments>;
+	using FunctionBody = std::vector<FunctionInstruction>;
+
+	// Index of a constant inside the string table of a LinkedCode
+	using StringId = uint32_t;
+	constexpr StringId InvalidStringId = static_cast<StringId>(-1);
+
+	// A fixed-width immediate of a linked instruction
+	union LinkedOperand
+	{
+		TInt32		Int;
+		TFloat		Float;
+		StringId	String;
+	};
+
+	// Pre-decoded instruction consumed by the execution engine.
+	// Operands meaning depends on the opcode:
+	//   Ldc_i4, Ldloc, Stloc, Ldarg, StArg, Br, BrTrue, BrFalse, LdFld, StFld, ConvType, AddStr -> A.Int
+	//   Ldc_r4 -> A.Float
+	//   Ldc_s -> A.String
+	//   Call, Call_t, Newobj -> A.String name, B.String namespace (InvalidStringId when implicit), C.Int call site index
+	//   CallVirt -> A.Int local index, B.String function name, C.Int call site index
+	//   LdSfld, StsFld -> A.Int global index, B.String namespace (InvalidStringId when implicit), C.Int global site index
+	//   NewArr -> A.Int type, B.String namespace, C.String object name (InvalidStringId when not present)
+	//   Ldloc2 -> A.Int first local, B.Int second local
+	//   LdlocAddC_i4, LdargAddC_i4 -> A.Int local/parameter index, B.Int constant (negated for sub)
+	//   IncLoc_i4 -> A.Int source local, B.Int constant (negated for sub), C.Int destination local
+	//   BrLoc*_i4 -> A.Int first local, B.Int second local (constant for BrLoc*C_i4), C.Int branch target
+	struct LinkedInstruction
+	{
+		VMInstruction Opcode;
+		LinkedOperand A;
+		LinkedOperand B;
+		LinkedOperand C;
+	};
+
+	static_assert(sizeof(LinkedInstruction) == 16, "Linked instructions must stay fixed-width");
+
+	// Opcode of the first instruction of the sequence a superinstruction replaced, the same opcode for any other instruction
+	inline VMInstruction UnfusedOpcode(VMInstruction opcode)
+	{
+		if (opcode == VMInstruction::LdargAddC_i4)
+			return VMInstruction::Ldarg;
+
+		if (opcode >= VMInstruction::Ldloc2 && opcode < VMInstruction::LastInstruction)
+			return VMInstruction::Ldloc;
+
+		return opcode;
+	}
+
+	// Opcode a type specialized instruction was produced from, the same opcode for any other instruction
+	inline VMInstruction GenericOpcode(VMInstruction opcode)
+	{
+		switch (opcode)
+		{
+		case VMInstruction::Add_i4:
+		case VMInstruction::Add_r4:
+			return VMInstruction::Add;
+		case VMInstruction::Sub_i4:
+		case VMInstruction::Sub_r4:
+			return VMInstruction::Sub;
+		case VMInstruction::Mul_i4:
+		case VMInstruction::Mul_r4:
+			return VMInstruction::Mul;
+		case VMInstruction::Div_i4:
+		case VMInstruction::Div_r4:
+			return VMInstruction::Div;
+		case VMInstruction::Ceq_i4:
+			return VMInstruction::Ceq;
+		case VMInstruction::Clt_i4:
+			return VMInstruction::Clt;
+		case VMInstruction::Cgt_i4:
+			return VMInstruction::Cgt;
+		default:
+			return opcode;
+		}
+	}
+
+	// Flat, contiguous rapresentation of a FunctionBody generated at link time.
+	// Strings are interned once in a table and referenced by id from the instruction stream,
+	// loading one on the data stack is a pointer copy.
+	class LinkedCode
+	{
+	public:
+		// Lower the whole body, returns false if any instruction has malformed arguments
+		bool Link(const FunctionBody& body);
+		// Adopt an instruction stream lowered ahead of time (see ScriptImage), strings are the table the operands refer to.
+		// Only parseable opcodes are accepted, returns false if any operand is out of range
+		bool Load(std::vector<LinkedInstruction>&& instructions, std::vector<SharedString*>&& strings);
+		// Same checks as Load without adopting anything, stringCount is the size of the string table the operands refer to
+		static bool IsLoadable(const std::vector<LinkedInstruction>& instructions, size_t stringCount);
+		// Undo type specialization and superinstructions and reset the call site caches, the code is back as it was linked
+		void Restore();
+		void Clear();
+
+		inline bool Empty() const { return m_Instructions.empty(); }
+		inline size_t Size() const { return m_Instructions.size(); }
+		inline const LinkedInstruction& operator[](size_t index) const { return m_Instructions[index]; }
+		inline const LinkedInstruction* Data() const { return m_Instructions.data(); }
+		inline const TString& String(StringId id) const { return m_Strings[id]->Str(); }
+		inline SharedString* SharedStringAt(StringId id) const { return m_Strings[id]; }
+		inline size_t StringCount() const { return m_Strings.size(); }
+
+		// Instruction at index as it was linked, before type specialization and superinstructions
+		LinkedInstruction Original(size_t index) const;
+		// Instruction at index with the arguments it was parsed with
+		FunctionInstruction Unlower(size_t index) const;
+
+		// Call sites are resolved lazily by the interpreter, the cache is not part of the function definition
+		inline CallSite& CallSiteAt(TInt32 index) const { return m_CallSites[index]; }
+		inline size_t CallSiteCount() const { return m_CallSites.size(); }
+		inline GlobalSite& GlobalSiteAt(TInt32 index) const { return m_GlobalSites[index]; }
+
+		// Swaps the opcode at index for a variant taking the same arguments, e.g. a type specialized one
+		inline void Specialize(size_t index, VMInstruction opcode) { m_Instructions[index].Opcode = opcode; }
+
+		// Peephole pass replacing the first instruction of frequent sequences with a superinstruction running all of them.
+		// Only done once the code is verified and specialized: the sequences are matched on the type specialized opcodes.
+		// The rest of the sequence stays in place, instruction indices (branch targets, line information) don't change
+		// and jumping in the middle of a sequence runs the original instructions.
+		void FuseSuperinstructions();
+
+	private:
+		bool Lower(VMInstruction opcode, const InstructionArguments& args, LinkedInstruction& out);
+		bool InternArgument(const InstructionArguments& args, size_t index, StringId& out);
+		bool FuseAt(size_t index, LinkedInstruction& out) const;
+		// Create the call and global sites of the instructions, the code must be loadable (see IsLoadable)
+		void BuildSites();
+		StringId Intern(SharedString* str);
+
+		std::vector<LinkedInstruction>  m_Instructions;
+		std::vector<SharedString*>      m_Strings; // Interned, never released
+		mutable std::vector<CallSite>   m_CallSites;
+		mutable std::vector<GlobalSite> m_GlobalSites;
+
+		// Only used while linking to deduplicate constants
+		std::unordered_map<const SharedString*, StringId> m_StringLookup;
+	};
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <ostream>
+#include <vector>
+#include <unordered_map>
+
+namespace nebula
+{
+	class Function;
+
+	// Counts the instructions executed by an interpreter (see Interpreter::SetOpcodeProfiler)
+	// to find the opcode sequences worth fusing into superinstructions
+	class OpcodeProfiler
+	{
+	public:
+		void Record(const Function* function, size_t instructionIndex);
+		void Clear();
+
+		// Writes the top most executed sequences of 2 to maxLength opcodes, superinstructions are reported as the sequence they replaced.
+		// A sequence is counted as many times as its least executed instruction, it never continues past a branch or a return
+		void Dump(std::ostream& out, size_t maxLength, size_t top) const;
+
+	private:
+		std::unordered_map<const Function*, std::vector<size_t>> m_Counts;
+		// Consecutive records are almost always in the same function
+		const Function* m_LastFunction{ nullptr };
+		std::vector<size_t>* m_LastCounts{ nullptr };
+	};
+}
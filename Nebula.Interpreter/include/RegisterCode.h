@@ -0,0 +1,102 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "LanguageTypes.h"
+#include "LinkedCode.h"
+
+namespace nebula
+{
+	class Function;
+
+	// Opcodes of the register tier, I suffixed opcodes work on ints, F suffixed ones on floats and C suffixed ones take B as a constant
+	enum class RegisterOp : uint16_t
+	{
+		Fallback,	// Runs the linked instruction Ip on the stack engine
+
+		Mov,
+		LdcI,
+		LdcF,
+
+		AddI,
+		AddIC,		// Also used for sub, the constant is negated
+		SubI,
+		MulI,
+		MulIC,
+		DivI,
+		AddF,
+		SubF,
+		MulF,
+		DivF,
+
+		CeqI,
+		CeqIC,
+		CltI,
+		CltIC,
+		CgtI,
+		CgtIC,
+
+		Br,
+		BrTrue,
+		BrFalse,
+		BrLtI,
+		BrLtIC,
+		BrGeI,
+		BrGeIC,
+		BrGtI,
+		BrGtIC,
+		BrLeI,
+		BrLeIC,
+		BrEqI,
+		BrEqIC,
+		BrNeI,
+		BrNeIC,
+
+		LastOp
+	};
+
+	// Registers are the byte offset from the frame of a variable value or of an operand stack slot (see Frame::VariableRegister).
+	// Operands meaning depends on the opcode:
+	//   Fallback -> Depth stack height the linked instruction expects
+	//   Mov -> Dst, A register
+	//   LdcI, LdcF -> Dst, A constant
+	//   Arithmetic and compare -> Dst, A register, B register or constant
+	//   Br, BrTrue, BrFalse, Br* -> Dst linked index of the target, Target register index of the target,
+	//                               A and B registers (B constant for BrC), Depth stack height once branched
+	// Fallbacks and branches also hold the Cost, the instructions run since the previous one of them
+	struct RegisterInstruction
+	{
+		RegisterOp		Opcode;
+		TInt32			Ip;		// Linked instruction reported when an error is raised
+		TInt32			Dst;
+		LinkedOperand	A;
+		LinkedOperand	B;
+		TInt32			Target;
+		TInt32			Depth;
+		TInt32			Cost;
+	};
+
+	static_assert(sizeof(RegisterInstruction) == 32, "Register instructions must stay fixed-width");
+
+	// Second execution tier of hot verified functions, translated from their linked code.
+	// Locals, parameters and temporaries are addressed directly instead of going through the operand stack,
+	// loads are folded in the instruction using them and results are written straight to the local storing them.
+	// Instructions the tier doesn't handle fall back to the stack engine, the operand stack is brought in sync before them
+	// and the register code can be left or entered at those points (see EntryAt). Single stepping always uses the linked code
+	class RegisterCode
+	{
+	public:
+		// Returns nullptr if the function can't run or doesn't gain anything in the register tier
+		static std::unique_ptr<RegisterCode> Translate(const Function& function);
+
+		inline const RegisterInstruction* Data() const { return m_Instructions.data(); }
+		inline size_t Size() const { return m_Instructions.size(); }
+		// Register instruction resuming the execution at a linked instruction, -1 if only the stack engine can resume there
+		inline TInt32 EntryAt(size_t ip) const { return m_Entries[ip]; }
+
+	private:
+		std::vector<RegisterInstruction> m_Instructions;
+		std::vector<TInt32> m_Entries;
+	};
+}
@@ -3,6 +3,7 @@
 #include <string>
 #include <memory>
 #include <map>
+#include <vector>
 
 #include "DiagnosticReport.h"
 
@@ -49,9 +50,13 @@ namespace nebula
 	class Script
 	{
 		friend class ScriptBuilder;
+		friend class ScriptVerifier;
 	public:
+		// Text scripts and binary script images (see ScriptImage) are told apart by their content
 		static ScriptLoadResult FromFile(const std::string& filePath);
 		static ScriptLoadResult FromMemory(const std::string_view& data, const std::string& sourcePath = "");
+		// Loads every file as FromFile does on up to threadCount threads (0 to use every core), results are in the order of the paths
+		static std::vector<ScriptLoadResult> FromFiles(const std::vector<std::string>& filePaths, size_t threadCount = 0);
 
 	public:
 		~Script();
@@ -62,6 +67,9 @@ namespace nebula
 		inline const BundleMap& Bundles() const { return m_Bundles; }
 		inline const std::string& GetSourcePath() const { return m_SourcePath; }
 
+		// Lower every function into its executable form, done once when the script is added to an interpreter
+		bool Link();
+
 	private:
 		Script();
 		std::string m_SourcePath;
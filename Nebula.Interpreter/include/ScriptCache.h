@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Script.h"
+
+namespace nebula
+{
+	// Directory of script images (see ScriptImage) keyed by the content of the text scripts they were made from,
+	// a script that didn't change since it was last loaded is read from its image instead of being parsed.
+	// The key also covers the image layout, the opcode set and the image flags so entries of another build or
+	// configuration are never used. Entries keep the warnings of the parse with the image, a script loaded from
+	// the cache gets the same report as a parsed one. Entries are checksummed, a damaged one is parsed again and replaced.
+	// Entries are never removed, the directory can be deleted at any time to clear the cache
+	class ScriptCache
+	{
+	public:
+		// Bumped on any change of the entry layout
+		static constexpr uint32_t Version = 2;
+
+		// The directory is created on the first store, debugLines keeps the source lines of the instructions in the images.
+		// Without them scripts loaded from the cache report errors without the line of the failing instruction
+		ScriptCache(std::string directory, bool debugLines);
+		ScriptCache(const ScriptCache&) = delete;
+		ScriptCache& operator=(const ScriptCache&) = delete;
+
+		// Same as Script::FromFile, text scripts missing from the cache are parsed and their image stored.
+		// Failing to store an image only adds a warning to the report. Thread safe
+		ScriptLoadResult Load(const std::string& filePath);
+		// Same as Script::FromFiles, going through the cache
+		std::vector<ScriptLoadResult> LoadAll(const std::vector<std::string>& filePaths, size_t threadCount = 0);
+
+		inline const std::string& Directory() const { return m_Directory; }
+		// Loads served from an image of the cache
+		inline size_t Hits() const { return m_Hits; }
+		// Text scripts parsed because their image was missing or damaged
+		inline size_t Misses() const { return m_Misses; }
+
+	private:
+		std::string EntryPath(uint64_t key) const;
+		// The script is nullptr if the entry is missing or damaged
+		ScriptLoadResult LoadEntry(const std::string& entryPath, uint64_t key, std::string_view source, const std::string& filePath) const;
+		void StoreEntry(const std::string& entryPath, uint64_t key, std::string_view source, Script& script, shared::DiagnosticReport& report) const;
+
+		std::string m_Directory;
+		bool m_DebugLines;
+		uint64_t m_KeySeed;
+		std::atomic<size_t> m_Hits{ 0 };
+		std::atomic<size_t> m_Misses{ 0 };
+	};
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "DiagnosticReport.h"
+
+namespace nebula
+{
+	class Script;
+
+	// Binary container of a linked script (.nebc), loading one doesn't parse a single instruction.
+	// Every value is a 32 bit little endian word, the layout is:
+	//   Header      -> magic, Version, Flags
+	//   String pool -> count, offset and length of each string, size of the text then the text padded to a word.
+	//                  Names and string constants are all stored as an index in the pool
+	//   Namespace   -> pool index
+	//   Globals     -> count, then name and type of each
+	//   Bundles     -> count, then for each: name, field count, name and type of each field
+	//   Functions   -> count, then for each: name, return type, parameter, local, attribute, string and instruction counts,
+	//                  parameter types, local types, attributes, pool index of each entry of the function string table,
+	//                  the instructions as LinkedInstruction and, with DebugLines, the source line of each instruction (0 if unknown)
+	// Instructions are stored as linked, before the verifier specializes them, and their string operands index the
+	// string table of their function. Images are verified like parsed scripts when added to an interpreter
+	class ScriptImage
+	{
+	public:
+		static constexpr char Magic[4]{ 'N', 'E', 'B', 'C' };
+		// Bumped on any layout change, images of another version are rejected
+		static constexpr uint32_t Version = 1;
+
+		enum Flags : uint32_t
+		{
+			NoFlags = 0,
+			DebugLines = 1 << 0,
+		};
+
+		// True if data starts like an image, the rest is only checked when loaded
+		static bool IsImage(std::string_view data);
+
+		// The script must be linked, returns false and reports why if it can't be written
+		static bool Write(const Script& script, std::vector<char>& out, shared::DiagnosticReport& report, bool debugLines = true);
+		static bool Save(const Script& script, const std::string& filePath, shared::DiagnosticReport& report, bool debugLines = true);
+	};
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <functional>
+
+#include "DiagnosticReport.h"
+
+namespace nebula
+{
+	class Script;
+	class Function;
+
+	// Checks the linked code of a script before it is added to an interpreter.
+	// Code that can only fail once executed (out of range indices, stack underflows, operands of the wrong type, ...)
+	// rejects the script. Functions whose operand types are all known are marked as verified and
+	// run without the runtime checks (see Function::IsVerified).
+	// Accepted code is then rewritten with the opcodes specialized on the known operand types and superinstructions
+	class ScriptVerifier
+	{
+	public:
+		// Returns the loaded script with the given namespace, nullptr if there is none
+		using ScriptLookup = std::function<const Script*(const std::string&)>;
+
+		ScriptVerifier(ScriptLookup lookup);
+
+		// Returns false if any function was rejected, the reasons are added to the report
+		bool Verify(Script& script, shared::DiagnosticReport& report);
+
+	private:
+		ScriptLookup m_Lookup;
+	};
+}
@@ -1,30 +1,45 @@
 #pragma once
 
 #include "CallStack.h"
+#include "FramePool.h"
 
 #include <map>
 #include <vector>
+#include <unordered_map>
 
 namespace nebula
 {
 
+    // Owns every script thread and their frames, callstacks are heap allocated so their address is a stable thread identity
     class ThreadMap
     {
     public:
+        ~ThreadMap() { Clear(); }
+
         void RemoveCallstack(size_t index);
+        void RemoveCallstack(const CallStack* callstack);
         void Clear();
 
         size_t Count() const { return m_Callstacks.size(); }
-        CallStack& At(size_t index) { return m_Callstacks[index]; }
-        const CallStack& At(size_t index) const { return m_Callstacks[index]; }
+        CallStack& At(size_t index) { return *m_Callstacks[index]; }
+        const CallStack& At(size_t index) const { return *m_Callstacks[index]; }
+        // Returns Count() if the callstack is not owned by this map
+        size_t IndexOf(const CallStack* callstack) const;
+
+        CallStack* CreateNewThread();
+        bool HasCallStacks() const { return !m_Callstacks.empty(); }
 
-        CallStack* CreateNewThread() { return &m_Callstacks.emplace_back(); }
-        bool HasCallStacks() { return !m_Callstacks.empty(); }
+        // Frames are allocated from the pool, they must be released with DestroyFrame
+        Frame* CreateFrame(Frame* parent, const Function* f, bool discardParent) { return m_FramePool.Create(parent, f, discardParent); }
+        void DestroyFrame(Frame* frame) { m_FramePool.Destroy(frame); }
+        // Frames alive on any thread or running outside of them
+        size_t FrameCount() const { return m_FramePool.LiveCount(); }
 
     private:
         void DeleteCallstackFrames(CallStack&);
 
+        FramePool m_FramePool;
         CallstackVector m_Callstacks;
+        std::unordered_map<const CallStack*, size_t> m_Indices;
     };
 }
-
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "CallStack.h"
+
+#include <deque>
+#include <queue>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+namespace nebula
+{
+	class Frame;
+
+	// Decides which script thread runs next.
+	// Only runnable threads are kept in the run queue, threads blocked by wait or wait_n are parked
+	// until their timer expires or a notification wakes them up so they cost nothing while blocked.
+	class ThreadScheduler
+	{
+	public:
+		// New threads are runnable and start at the back of the run queue
+		void AddThread(CallStack* thread);
+		// Drop the current thread from the run queue, the caller owns its destruction
+		void RemoveCurrent();
+		void Clear();
+
+		// Thread at the front of the run queue, nullptr if every thread is parked
+		inline CallStack* Current() const { return m_RunQueue.empty() ? nullptr : m_RunQueue.front(); }
+		// Move the current thread to the back of the run queue
+		void Rotate();
+
+		// Take the current thread out of the run queue until Wake is called for its top frame
+		// or wakeTime is reached, a wakeTime of 0 only waits for Wake
+		void ParkCurrent(unsigned long long wakeTime);
+		// Put the thread blocked on the frame back in the run queue, does nothing if it isn't parked
+		void Wake(Frame* blockedFrame);
+		// Put back in the run queue every thread whose timer expired, returns true if any was woken up
+		bool WakeExpired(unsigned long long currentMillis);
+
+		inline size_t RunnableCount() const { return m_RunQueue.size(); }
+		inline size_t ParkedCount() const { return m_Parked.size(); }
+		inline bool HasTimers() const { return !m_Timers.empty(); }
+		// Only valid if HasTimers() is true
+		inline unsigned long long NextWakeTime() const { return m_Timers.top().WakeTime; }
+
+	private:
+		struct ParkedThread
+		{
+			CallStack* Thread;
+			size_t Ticket;
+		};
+
+		struct Timer
+		{
+			unsigned long long WakeTime;
+			Frame* BlockedFrame;
+			size_t Ticket; // Timers of threads woken up early are discarded lazily when the ticket no longer matches
+
+			// Threads waking up at the same time run in the order they parked
+			bool operator>(const Timer& other) const { return WakeTime != other.WakeTime ? WakeTime > other.WakeTime : Ticket > other.Ticket; }
+		};
+
+		std::deque<CallStack*> m_RunQueue;
+		std::unordered_map<Frame*, ParkedThread> m_Parked;
+		std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> m_Timers;
+		size_t m_NextTicket{ 0 };
+	};
+}
@@ -16,10 +16,10 @@ namespace nebula
 		DataStackVariant&		Value() { return _value; }
 		const DataStackVariant& Value() const { return _value; }
 
-		TInt32					AsInt32() const { return std::get<DataStackVariantIndex::_TypeInt32>(_value); }
-		TFloat					AsFloat() const { return std::get<DataStackVariantIndex::_TypeFloat>(_value); }
-		const TString&			AsString() const { return std::get<DataStackVariantIndex::_TypeString>(_value); }
-		const TGCObject&		AsGCObject() const { return std::get<DataStackVariantIndex::_TypeObject>(_value); }
+		TInt32					AsInt32() const { return _value.AsInt32(); }
+		TFloat					AsFloat() const { return _value.AsFloat(); }
+		const TString&			AsString() const { return _value.AsString(); }
+		IGCObject*				AsObject() const { return _value.AsObject(); }
 
 	private:
 		DataStackVariantIndex _type{ DataStackVariantIndex::_UnknownType };
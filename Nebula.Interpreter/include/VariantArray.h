@@ -8,7 +8,7 @@
 
 namespace nebula
 {
-    class VariantArray
+    class VariantArray final
         : public IGCObject {
     public:
         VariantArray(const DataStackVariantIndex& type);
@@ -16,7 +16,7 @@ namespace nebula
         void Append(const DataStackVariant& v)
         {
             if (m_eVariantType != _UnknownType &&
-                m_eVariantType != v.index())
+                m_eVariantType != v.Type())
             {
                 throw std::exception("Variant type differs");
             }
@@ -28,7 +28,9 @@ namespace nebula
         size_t Size() { return m_Vector.size(); }
         DataStackVariant& operator[](int i) { return m_Vector[i]; }
 
-        virtual InstructionErrorCode CallVirtual(const std::string_view& funcName, nebula::Interpreter* interpreter, Frame* context) override;
+        virtual InstructionErrorCode CallVirtual(VirtualMethod method, nebula::Interpreter* interpreter, Frame* context) override;
+        // Same as CallVirtual without the virtual dispatch, used by call sites that already know they hold an array
+        InstructionErrorCode CallMethod(VirtualMethod method, Frame* context);
 
     private:
         DataStackVariantIndex m_eVariantType{ DataStackVariantIndex::_UnknownType };
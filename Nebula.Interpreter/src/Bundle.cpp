@@ -32,12 +32,12 @@ bool BundleField::SetValue(DataStackVariant& value, bool allowTypeMismatch)
 	if (allowTypeMismatch)
 	{
 		m_Value = value;
-		m_AcceptedType = (DataStackVariantIndex)m_Value.index();
+		m_AcceptedType = (DataStackVariantIndex)m_Value.Type();
 		return true;
 	}
 
 	// AcceptedTypes is always set, m_Value instead is left as default initially
-	if (m_AcceptedType != value.index())
+	if (m_AcceptedType != value.Type())
 	{
 		return false;
 	}
@@ -56,20 +56,6 @@ void BundleDefinition::AddField(const BundleFieldDefinition& field)
 	m_Fields.emplace_back(field);
 }
 
-std::shared_ptr<Bundle> Bundle::FromDefinition(const BundleDefinition& definition)
-{
-	// Constructor is private! Cant use make_shared
-	Bundle* b = new Bundle();
-	std::shared_ptr<Bundle> result = std::shared_ptr<Bundle>(b);
-
-	result->m_Name = definition.Name();
-	for (auto it = definition.Fields().begin(); it != definition.Fields().cend(); it++) {
-		result->m_Fields.emplace_back(it->first, it->second);
-	}
-
-	return result;
-}
-
 DataStackVariant& Bundle::Get(int index)
 {
 	BundleField& f = m_Fields[index];
@@ -94,7 +80,11 @@ bool Bundle::SetAt(int index, DataStackVariant& data)
 	return m_Fields[index].SetValue(data);
 }
 
-nebula::Bundle::Bundle()
-	: IGCObject(ObjectType::Bundle)
+nebula::Bundle::Bundle(const BundleDefinition& definition)
+	: IGCObject(ObjectType::Bundle), m_Name{ definition.Name() }
 {
+	m_Fields.reserve(definition.Fields().size());
+	for (auto it = definition.Fields().begin(); it != definition.Fields().cend(); it++) {
+		m_Fields.emplace_back(it->first, it->second);
+	}
 }
@@ -0,0 +1,34 @@
+#include "DataStack.h"
+
+using namespace nebula;
+
+DataStack::~DataStack()
+{
+    std::destroy(m_Begin, m_Top);
+    if (m_HeapStorage)
+    {
+        ::operator delete(m_HeapStorage);
+        m_HeapStorage = nullptr;
+    }
+}
+
+void DataStack::Reserve(size_t newCap)
+{
+    if (newCap <= Capacity())
+        return;
+
+    auto* storage = static_cast<DataStackVariant*>(::operator new(newCap * sizeof(DataStackVariant)));
+    size_t size = Size();
+    std::uninitialized_move(m_Begin, m_Top, storage);
+    std::destroy(m_Begin, m_Top);
+
+    if (m_HeapStorage)
+    {
+        ::operator delete(m_HeapStorage);
+    }
+
+    m_HeapStorage = storage;
+    m_Begin = storage;
+    m_Top = storage + size;
+    m_End = storage + newCap;
+}
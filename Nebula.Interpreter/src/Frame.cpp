@@ -1,33 +1,98 @@
+#include <cstddef>
+#include <algorithm>
+
 #include "Frame.h"
 #include "Interpreter.h"
 #include "InstructionRegistry.h"
+#include "OpcodeProfiler.h"
 
 using namespace nebula;
 
+static constexpr size_t AlignUp(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+static constexpr size_t VariablesOffset = AlignUp(sizeof(Frame), alignof(Variable));
+
+static size_t StackOffset(const Function* f)
+{
+    size_t variableCount = f->Parameters().size() + f->Locals().size();
+    return AlignUp(VariablesOffset + variableCount * sizeof(Variable), alignof(DataStackVariant));
+}
+
+static void SetDefaultValue(DataStackVariant& value, DataStackVariantIndex type)
+{
+    static SharedString* const s_EmptyString = SharedString::Intern("");
+
+    switch (type)
+    {
+    case DataStackVariantIndex::_TypeFloat:
+        value = DataStackVariant{ 0.0f };
+        break;
+    case DataStackVariantIndex::_TypeString:
+        value = DataStackVariant{ s_EmptyString };
+        break;
+    case DataStackVariantIndex::_TypeObject:
+        value = DataStackVariant{ TGCObject{} };
+        break;
+    default:
+        break;
+    }
+}
+
+static size_t StackCapacity(const Function* f)
+{
+    return std::min(f->MaxStackDepth(), Frame::MaxReservedStackDepth);
+}
+
+size_t Frame::AllocationSize(const Function* f)
+{
+    return StackOffset(f) + StackCapacity(f) * sizeof(DataStackVariant);
+}
+
+TInt32 Frame::VariableRegister(size_t index)
+{
+    return (TInt32)(VariablesOffset + index * sizeof(Variable) + offsetof(Variable, _value));
+}
+
+TInt32 Frame::StackRegister(const Function* f, size_t slot)
+{
+    return (TInt32)(StackOffset(f) + slot * sizeof(DataStackVariant));
+}
+
 Frame::Frame(Frame* parent, const Function* f, bool discardParent)
     : m_ParentFrame{ parent },
-    m_Memory{ f->Parameters().size(), f->Locals().size() },
+    m_Memory{ VariableStorage(), f->Parameters().size(), f->Locals().size() },
+    m_Stack{ StackStorage(), StackCapacity(f) },
     m_FunctionDefinition{ f },
     m_NextInstructionIndex{ 0 },
     m_Scheduler{ this }
 {
+    // The arguments are the top values of the caller stack, first argument deepest. They are moved into the
+    // parameters instead of copied, the slots left behind hold nothing to release and are dropped at once
     const VariableList& params = f->Parameters();
-    DataStack& dataStack = parent->Stack();
-    long paramCount = (long)params.size();
-    // Stack values are in the opposite order!
-    for (long i = paramCount - 1; i >= 0; i--)
+    size_t paramCount = params.size();
+    if (paramCount > 0)
     {
-        Variable& param = m_Memory.ParamAt(i);
-        param._type = params[i];
-        param._value = dataStack.Peek();
-        dataStack.Pop();
+        DataStack& dataStack = parent->Stack();
+        DataStackVariant* arguments = dataStack.end() - paramCount;
+        for (size_t i = 0; i < paramCount; i++)
+        {
+            Variable& param = m_Memory.UncheckedParamAt(i);
+            param._type = params[i];
+            param._value = std::move(arguments[i]);
+        }
+        dataStack.SetSizeUnchecked(dataStack.Size() - paramCount);
     }
 
     const VariableList& vars = f->Locals();
     for (size_t i = 0; i < vars.size(); i++)
     {
-        m_Memory.LocalAt(i)._type = vars[i];
-        // Value is set when instructions are executed
+        Variable& local = m_Memory.LocalAt(i);
+        local._type = vars[i];
+        // Locals read before being stored to hold the default value of their type
+        SetDefaultValue(local._value, vars[i]);
     }
 
     if (discardParent)
@@ -40,6 +105,25 @@ Frame::Frame(Frame* parent, const Function* f, bool discardParent)
     }
 }
 
+Frame::~Frame()
+{
+    // Killing the parent later on must not reach a deleted child
+    if (m_ParentFrame != nullptr && m_ParentFrame->m_ChildFrame == this)
+    {
+        m_ParentFrame->m_ChildFrame = nullptr;
+    }
+}
+
+Variable* Frame::VariableStorage()
+{
+    return reinterpret_cast<Variable*>(reinterpret_cast<std::byte*>(this) + VariablesOffset);
+}
+
+DataStackVariant* Frame::StackStorage()
+{
+    return reinterpret_cast<DataStackVariant*>(reinterpret_cast<std::byte*>(this) + StackOffset(m_FunctionDefinition));
+}
+
 Frame::Status Frame::Tick(Interpreter* interpreter)
 {
     // If this frame has received a kill notification we need to halt all child frames
@@ -61,21 +145,25 @@ Frame::Status Frame::Tick(Interpreter* interpreter)
         return Frame::Status::Finished;
     }
 
-    if (m_Scheduler.IsSleeping())
+    if (m_Scheduler.IsSleeping(interpreter->GetSchedulerTime()))
         return Frame::Status::Paused;
 
-    const FunctionBody& insts = m_FunctionDefinition->Instructions();
-    const FunctionInstruction& theInstruction = insts[m_NextInstructionIndex++];
-    const VMInstruction& opCode = theInstruction.first;
-    const InstructionArguments& args = theInstruction.second;
+    const LinkedCode& code = m_FunctionDefinition->Code();
+    const LinkedInstruction& theInstruction = code[m_NextInstructionIndex++];
+    const VMInstruction opCode = theInstruction.Opcode;
 
-    if (m_NextInstructionIndex >= insts.size())
+    if (m_NextInstructionIndex >= code.Size())
     {
         if (opCode != VMInstruction::Ret && opCode != VMInstruction::Br)
             return Status::FatalError;
     }
 
-    InstructionErrorCode executionError = ExecuteInstruction(opCode, interpreter, this, args);
+    if (OpcodeProfiler* profiler = interpreter->GetOpcodeProfiler())
+    {
+        profiler->Record(m_FunctionDefinition, m_NextInstructionIndex - 1);
+    }
+
+    InstructionErrorCode executionError = ExecuteInstruction(theInstruction, interpreter, this);
 
     if (executionError != InstructionErrorCode::None)
     {
@@ -91,6 +179,18 @@ Frame::Status Frame::Tick(Interpreter* interpreter)
     return Status::Running;
 }
 
+Frame::Status Frame::TickBatch(Interpreter* interpreter, size_t& budget)
+{
+    // Killed and sleeping frames are handled by the single step path
+    if (m_Scheduler.HasBeenKilled() || m_Scheduler.IsSleeping(interpreter->GetSchedulerTime()))
+    {
+        budget = budget > 0 ? budget - 1 : 0;
+        return Tick(interpreter);
+    }
+
+    return ExecuteBatch(interpreter, this, budget);
+}
+
 Frame::Status nebula::Frame::RunToCompletion(Interpreter* interpreter)
 {
     Status status = Tick(interpreter);
@@ -116,20 +216,20 @@ void Frame::SetScheduledSleep(const size_t& amount)
 void Frame::SetNextInstruction(size_t label)
 {
     [[unlikely]]
-    if (label >= m_FunctionDefinition->Instructions().size())
+    if (label >= m_FunctionDefinition->Code().Size())
         throw std::exception("Label is out of bounds!");
 
     m_NextInstructionIndex = label;
 }
 
-void Frame::WaitForNotification(IGCObject* notifier, const std::string& notification)
+void Frame::WaitForNotification(IGCObject* notifier, size_t notificationHash)
 {
-    m_Scheduler.WaitForNotification(notifier, notification);
+    m_Scheduler.WaitForNotification(notifier, notificationHash);
 }
 
-void Frame::EndOnNotification(IGCObject* notifier, const std::string& notification)
+void Frame::EndOnNotification(IGCObject* notifier, size_t notificationHash)
 {
-    m_Scheduler.EndOnNotification(notifier, notification);
+    m_Scheduler.EndOnNotification(notifier, notificationHash);
 }
 
 void nebula::Frame::Kill()
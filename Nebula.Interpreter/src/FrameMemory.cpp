@@ -1,18 +1,20 @@
+#include <memory>
+
 #include "FrameMemory.h"
 
 using namespace nebula;
 
-FrameMemory::FrameMemory(size_t paramCount, size_t localCount)
-    : m_ParamCount{ paramCount }, m_LocalCount{ localCount }
+FrameMemory::FrameMemory(Variable* storage, size_t paramCount, size_t localCount)
+    : m_Variables{ storage }, m_ParamCount{ paramCount }, m_LocalCount{ localCount }
 {
-    m_Variables = new Variable[localCount + paramCount];
+    std::uninitialized_default_construct_n(m_Variables, localCount + paramCount);
 }
 
 FrameMemory::~FrameMemory()
 {
     if (m_Variables)
     {
-        delete[] m_Variables;
+        std::destroy_n(m_Variables, m_LocalCount + m_ParamCount);
         m_Variables = nullptr;
     }
 }
@@ -59,7 +61,7 @@ const Variable& FrameMemory::ParamAt(size_t i) const
 
 bool Variable::SetValue(DataStackVariant& val)
 {
-    if (Type() != val.index())
+    if (Type() != val.Type())
         return false;
 
     _value = val;
@@ -0,0 +1,80 @@
+#include <new>
+
+#include "FramePool.h"
+#include "Frame.h"
+
+using namespace nebula;
+
+FramePool::~FramePool()
+{
+	Trim();
+}
+
+Frame* FramePool::Create(Frame* parent, const Function* f, bool discardParent)
+{
+	size_t allocationSize = Frame::AllocationSize(f);
+	size_t sizeClass = SizeClassOf(allocationSize);
+
+	void* block{ nullptr };
+	if (sizeClass == SizeClassCount)
+	{
+		block = ::operator new(allocationSize);
+	}
+	else if (FreeBlock* cached = m_FreeBlocks[sizeClass])
+	{
+		m_FreeBlocks[sizeClass] = cached->Next;
+		block = cached;
+	}
+	else
+	{
+		block = ::operator new(BlockSizeOf(sizeClass));
+	}
+
+	m_LiveCount++;
+	Frame* frame = ::new (block) Frame(parent, f, discardParent);
+	frame->m_PoolSizeClass = sizeClass;
+	return frame;
+}
+
+void FramePool::Destroy(Frame* frame)
+{
+	if (frame == nullptr)
+		return;
+
+	size_t sizeClass = frame->m_PoolSizeClass;
+	frame->~Frame();
+	m_LiveCount--;
+
+	if (sizeClass == SizeClassCount)
+	{
+		::operator delete(frame);
+		return;
+	}
+
+	FreeBlock* block = ::new (static_cast<void*>(frame)) FreeBlock{ m_FreeBlocks[sizeClass] };
+	m_FreeBlocks[sizeClass] = block;
+}
+
+void FramePool::Trim()
+{
+	for (FreeBlock*& head : m_FreeBlocks)
+	{
+		while (head != nullptr)
+		{
+			FreeBlock* next = head->Next;
+			::operator delete(head);
+			head = next;
+		}
+	}
+}
+
+size_t FramePool::SizeClassOf(size_t allocationSize)
+{
+	size_t sizeClass = 0;
+	while (sizeClass < SizeClassCount && BlockSizeOf(sizeClass) < allocationSize)
+	{
+		sizeClass++;
+	}
+
+	return sizeClass;
+}
@@ -1,21 +1,27 @@
 #include <cassert>
+#include <algorithm>
 
 #include "Utility.h"
 #include "FrameScheduler.h"
 #include "interfaces/IGCObject.h"
 #include "Frame.h"
+#include "ThreadScheduler.h"
 
 using namespace nebula;
 
-static std::hash<std::string> gStringHasher;
+template<typename TWaitingHashes>
+static auto FindWaitingHashSet(TWaitingHashes& waits, IGCObject* notifier)
+{
+	return std::find_if(waits.begin(), waits.end(), [notifier](const auto& wait) { return wait.first == notifier; });
+}
 
-static void AddOrUpdateWaitingHashSet(std::map<IGCObject*, std::unordered_set<size_t>>& map, IGCObject* notifier, size_t hash)
+template<typename TWaitingHashes>
+static void AddOrUpdateWaitingHashSet(TWaitingHashes& waits, IGCObject* notifier, size_t hash)
 {
-	auto it = map.find(notifier);
-	if (it == map.end())
+	auto it = FindWaitingHashSet(waits, notifier);
+	if (it == waits.end())
 	{
-		std::unordered_set<size_t> set{ hash };
-		map.insert(std::make_pair(notifier, set));
+		waits.emplace_back(notifier, std::unordered_set<size_t>{ hash });
 	}
 	else
 	{
@@ -40,26 +46,23 @@ void FrameScheduler::Kill()
 	m_WaitingEndonHashes.clear();
 }
 
-void FrameScheduler::WaitForNotification(IGCObject* notifier, const std::string& notification)
+void FrameScheduler::WaitForNotification(IGCObject* notifier, size_t notificationHash)
 {
-	size_t hash = gStringHasher(notification);
-	AddOrUpdateWaitingHashSet(m_WaitingHashes, notifier, hash);
+	AddOrUpdateWaitingHashSet(m_WaitingHashes, notifier, notificationHash);
 	notifier->Subscribe(this);
 }
 
-void FrameScheduler::EndOnNotification(IGCObject* notifier, const std::string& notification)
+void FrameScheduler::EndOnNotification(IGCObject* notifier, size_t notificationHash)
 {
-	size_t hash = gStringHasher(notification);
-
-	AddOrUpdateWaitingHashSet(m_WaitingEndonHashes, notifier, hash);
+	AddOrUpdateWaitingHashSet(m_WaitingEndonHashes, notifier, notificationHash);
 	notifier->Subscribe(this);
 }
 
-bool FrameScheduler::IsSleeping()
+bool FrameScheduler::IsSleeping(unsigned long long currentMillis)
 {
 	if (m_SleepAmount > 0)
 	{
-		if (GetCurrentMillis() < m_SleepAmount)
+		if (currentMillis < m_SleepAmount)
 			return true;
 
 		m_SleepAmount = 0;
@@ -77,13 +80,19 @@ bool FrameScheduler::OnNotification(IGCObject* sender, const size_t notification
 	bool foundListener = FindAndRemoveWaitingHash(sender, notification);
 	bool foundEndon = FindAndRemoveEndonHash(sender, notification);
 
+	// A parked thread only needs to run again once it can make progress
+	if (m_pThreadScheduler && (foundEndon || (foundListener && m_WaitingHashes.empty())))
+	{
+		m_pThreadScheduler->Wake(m_Parent);
+	}
+
 	// If we don't find neither we need to unsubscribe as we have no use for it
 	return !foundListener && !foundEndon;
 }
 
 bool FrameScheduler::FindAndRemoveWaitingHash(IGCObject* sender, const size_t notification)
 {
-	auto it = m_WaitingHashes.find(sender);
+	auto it = FindWaitingHashSet(m_WaitingHashes, sender);
 	if (it == m_WaitingHashes.end())
 	{
 		return false;
@@ -101,7 +110,7 @@ bool FrameScheduler::FindAndRemoveWaitingHash(IGCObject* sender, const size_t no
 
 bool FrameScheduler::FindAndRemoveEndonHash(IGCObject* sender, const size_t notification)
 {
-	auto it = m_WaitingEndonHashes.find(sender);
+	auto it = FindWaitingHashSet(m_WaitingEndonHashes, sender);
 	if (it == m_WaitingEndonHashes.end())
 		return false;
 
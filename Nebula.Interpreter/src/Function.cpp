@@ -1,10 +1,127 @@
 #include <cassert>
+#include <algorithm>
 
 #include "Function.h"
 #include "Script.h"
 
 using namespace nebula;
 
+struct StackEffect
+{
+    size_t Pops;
+    size_t Pushes;
+};
+
+// Functions of other scripts and native functions are not known at link time, the bytecode does not
+// record how many arguments they consume. They are assumed to consume nothing and produce a value,
+// an upper bound as a call never leaves more than its return value.
+static constexpr StackEffect UnknownCallEffect{ 0, 1 };
+
+static StackEffect CallEffect(const Function& caller, const LinkedInstruction& instruction, bool threaded)
+{
+    const LinkedCode& code = caller.Code();
+    if (instruction.B.String != InvalidStringId && code.String(instruction.B.String) != caller.Namespace())
+        return UnknownCallEffect;
+
+    const FunctionMap& functions = caller.GetScript()->Functions();
+    auto it = functions.find(code.String(instruction.A.String));
+    if (it == functions.end())
+        return UnknownCallEffect;
+
+    const Function& callee = it->second;
+    // Threaded calls discard the return value
+    bool returnsValue = !threaded && callee.ReturnType() != DataStackVariantIndex::_TypeVoid;
+    return { callee.Parameters().size(), returnsValue ? 1u : 0u };
+}
+
+static StackEffect StackEffectOf(const Function& function, const LinkedInstruction& instruction)
+{
+    switch (instruction.Opcode)
+    {
+    case VMInstruction::Nop:
+    case VMInstruction::Br:
+        return { 0, 0 };
+    case VMInstruction::Ret:
+        return { function.ReturnType() == DataStackVariantIndex::_TypeVoid ? 0u : 1u, 0 };
+    case VMInstruction::Call:
+        return CallEffect(function, instruction, false);
+    case VMInstruction::Call_t:
+        return CallEffect(function, instruction, true);
+    case VMInstruction::CallVirt:
+        // The local is pushed for the type function which then behaves as a native call
+        return { 0, 2 };
+    case VMInstruction::Dup:
+    case VMInstruction::LdNull:
+    case VMInstruction::Ldc_i4_0:
+    case VMInstruction::Ldc_i4_1:
+    case VMInstruction::Ldc_i4_2:
+    case VMInstruction::Ldc_i4_3:
+    case VMInstruction::Ldc_i4_4:
+    case VMInstruction::Ldc_i4_5:
+    case VMInstruction::Ldc_i4_6:
+    case VMInstruction::Ldc_i4_7:
+    case VMInstruction::Ldc_i4_8:
+    case VMInstruction::Ldc_i4_9:
+    case VMInstruction::Ldc_i4:
+    case VMInstruction::Ldc_r4:
+    case VMInstruction::Ldc_s:
+    case VMInstruction::Newobj:
+    case VMInstruction::NewArr:
+    case VMInstruction::Ldarg:
+    case VMInstruction::Ldloc:
+    case VMInstruction::LdSfld:
+        return { 0, 1 };
+    case VMInstruction::ConvType:
+    case VMInstruction::ChkDef:
+    case VMInstruction::Neg:
+    case VMInstruction::Not:
+    case VMInstruction::LdFld:
+        return { 1, 1 };
+    case VMInstruction::Ceq:
+    case VMInstruction::And:
+    case VMInstruction::Or:
+    case VMInstruction::Xor:
+    case VMInstruction::Clt:
+    case VMInstruction::Cgt:
+    case VMInstruction::Add:
+    case VMInstruction::Sub:
+    case VMInstruction::Mul:
+    case VMInstruction::Div:
+    case VMInstruction::Rem:
+    case VMInstruction::LdElem:
+    case VMInstruction::Add_i4:
+    case VMInstruction::Add_r4:
+    case VMInstruction::Sub_i4:
+    case VMInstruction::Sub_r4:
+    case VMInstruction::Mul_i4:
+    case VMInstruction::Mul_r4:
+    case VMInstruction::Div_i4:
+    case VMInstruction::Div_r4:
+    case VMInstruction::Ceq_i4:
+    case VMInstruction::Clt_i4:
+    case VMInstruction::Cgt_i4:
+        return { 2, 1 };
+    case VMInstruction::AddStr:
+        return { (size_t)instruction.A.Int, 1 };
+    case VMInstruction::Pop:
+    case VMInstruction::BrTrue:
+    case VMInstruction::BrFalse:
+    case VMInstruction::Wait:
+    case VMInstruction::Stloc:
+    case VMInstruction::StArg:
+    case VMInstruction::StsFld:
+        return { 1, 0 };
+    case VMInstruction::Wait_n:
+    case VMInstruction::Endon:
+    case VMInstruction::Notify:
+    case VMInstruction::StFld:
+        return { 2, 0 };
+    case VMInstruction::StElem:
+        return { 3, 0 };
+    }
+
+    return { 0, 0 };
+}
 Function::Function(const Script* parentScript, DataStackVariantIndex returnType, const std::string& name)
     : m_ParentScript{ parentScript }, m_ReturnType{ returnType }, m_Name{ name }
 {
@@ -41,6 +158,117 @@ bool nebula::Function::AppendInstruction(const FunctionInstruction& instruction)
     return true;
 }
 
+void nebula::Function::SetSourceLines(std::vector<uint32_t>&& lines)
+{
+    m_SourceLines = std::move(lines);
+}
+
+bool nebula::Function::LoadCode(std::vector<LinkedInstruction>&& instructions, std::vector<SharedString*>&& strings)
+{
+    m_Body.clear();
+    m_IsLoaded = m_Code.Load(std::move(instructions), std::move(strings));
+    return m_IsLoaded;
+}
+
+FunctionInstruction nebula::Function::InstructionAt(size_t index) const
+{
+    if (m_IsLoaded)
+        return m_Code.Unlower(index);
+
+    return m_Body[index];
+}
+
+bool nebula::Function::Link()
+{
+    // Whatever was proven or translated from the previous code no longer applies, the verifier runs again
+    m_IsVerified = false;
+    m_StackHeights.clear();
+    m_CallCount = 0;
+    m_RegisterTier.reset();
+
+    if (m_IsLoaded)
+    {
+        m_Code.Restore();
+    }
+    else if (!m_Code.Link(m_Body))
+    {
+        return false;
+    }
+
+    ComputeMaxStackDepth();
+    return true;
+}
+
+void nebula::Function::ComputeMaxStackDepth()
+{
+    constexpr size_t unvisited = static_cast<size_t>(-1);
+
+    // Abstract interpretation over the control flow, only the stack height is tracked.
+    // The compiler lowers control flow between statements so every path reaching an instruction
+    // does it with the same height, the first one seen is kept.
+    const size_t instructionCount = m_Code.Size();
+    std::vector<size_t> depthAt(instructionCount, unvisited);
+    std::vector<size_t> pending;
+
+    m_MaxStackDepth = 0;
+    if (instructionCount == 0)
+        return;
+
+    depthAt[0] = 0;
+    pending.push_back(0);
+
+    auto reach = [&](TInt32 target, size_t depth)
+    {
+        // Out of range targets are reported when executed
+        if (target < 0 || (size_t)target >= instructionCount || depthAt[target] != unvisited)
+            return;
+
+        depthAt[target] = depth;
+        pending.push_back((size_t)target);
+    };
+
+    while (!pending.empty())
+    {
+        size_t index = pending.back();
+        pending.pop_back();
+
+        const LinkedInstruction& instruction = m_Code[index];
+        StackEffect effect = StackEffectOf(*this, instruction);
+
+        size_t depth = depthAt[index];
+        depth = depth >= effect.Pops ? depth - effect.Pops : 0;
+        depth += effect.Pushes;
+        m_MaxStackDepth = std::max(m_MaxStackDepth, depth);
+
+        switch (instruction.Opcode)
+        {
+        case VMInstruction::Ret:
+            break;
+        case VMInstruction::Br:
+            reach(instruction.A.Int, depth);
+            break;
+        case VMInstruction::BrTrue:
+        case VMInstruction::BrFalse:
+            reach(instruction.A.Int, depth);
+            reach((TInt32)index + 1, depth);
+            break;
+        default:
+            reach((TInt32)index + 1, depth);
+            break;
+        }
+    }
+}
+
+bool nebula::Function::PromoteToRegisterTier() const
+{
+    if (m_RegisterTier == nullptr)
+    {
+        m_RegisterTier = RegisterCode::Translate(*this);
+    }
+
+    return m_RegisterTier != nullptr;
+}
+
 bool nebula::Function::HasAttribute(VMAttribute attr) const
 {
     for (int i{ 0 }; i < m_Attributes.size(); i++)
@@ -0,0 +1,293 @@
+#include <cassert>
+
+#include "GCHeap.h"
+
+using namespace nebula;
+
+GCHeap::~GCHeap()
+{
+	for (SizeClass& sizeClass : m_SizeClasses)
+	{
+		for (Page& page : sizeClass.Pages)
+		{
+			for (IGCObject* object : page.Objects)
+			{
+				if (object != nullptr)
+				{
+					object->~IGCObject();
+				}
+			}
+		}
+	}
+
+	for (LargeObject& large : m_LargeObjects)
+	{
+		large.Object->~IGCObject();
+		::operator delete(large.Memory);
+	}
+
+	// Young small objects were already destroyed with the pages
+	for (const NurseryEntry& entry : m_Nursery)
+	{
+		if (entry.SizeClass == LargeSizeClass)
+		{
+			entry.Object->~IGCObject();
+			::operator delete(entry.Memory);
+		}
+	}
+}
+
+size_t GCHeap::Sweep()
+{
+	size_t destroyed{ 0 };
+	for (SizeClass& sizeClass : m_SizeClasses)
+	{
+		for (size_t p{ 0 }; p < sizeClass.Pages.size(); p++)
+		{
+			std::vector<IGCObject*>& objects = sizeClass.Pages[p].Objects;
+			for (size_t s{ 0 }; s < objects.size(); s++)
+			{
+				IGCObject* object = objects[s];
+				if (object == nullptr)
+					continue;
+
+				if (object->m_bIsMarked)
+				{
+					Promote(object);
+					continue;
+				}
+
+				object->~IGCObject();
+				objects[s] = nullptr;
+				sizeClass.FreeSlots.push_back({ (uint32_t)p, (uint32_t)s });
+				destroyed++;
+			}
+		}
+	}
+
+	auto it = m_LargeObjects.begin();
+	while (it != m_LargeObjects.end())
+	{
+		if (it->Object->m_bIsMarked)
+		{
+			Promote(it->Object);
+			it++;
+			continue;
+		}
+
+		it->Object->~IGCObject();
+		::operator delete(it->Memory);
+		*it = m_LargeObjects.back();
+		m_LargeObjects.pop_back();
+		destroyed++;
+	}
+
+	// Young small objects were handled with the pages
+	for (const NurseryEntry& entry : m_Nursery)
+	{
+		if (entry.SizeClass != LargeSizeClass)
+			continue;
+
+		if (entry.Object->m_bIsMarked)
+		{
+			Promote(entry.Object);
+			m_LargeObjects.push_back({ entry.Memory, entry.Object });
+			continue;
+		}
+
+		entry.Object->~IGCObject();
+		::operator delete(entry.Memory);
+		destroyed++;
+	}
+
+	m_Nursery.clear();
+	m_ObjectCount -= destroyed;
+	return destroyed;
+}
+
+size_t GCHeap::SweepNursery()
+{
+	size_t destroyed{ 0 };
+	for (const NurseryEntry& entry : m_Nursery)
+	{
+		if (entry.Object->m_bIsMarked)
+		{
+			Promote(entry.Object);
+			if (entry.SizeClass == LargeSizeClass)
+			{
+				m_LargeObjects.push_back({ entry.Memory, entry.Object });
+			}
+			continue;
+		}
+
+		Destroy(entry);
+		destroyed++;
+	}
+
+	m_Nursery.clear();
+	m_ObjectCount -= destroyed;
+	return destroyed;
+}
+
+void GCHeap::BeginSweep()
+{
+	m_SweepCursor = SweepCursor{};
+}
+
+bool GCHeap::SweepSlice(size_t& budget)
+{
+	SweepCursor& cursor = m_SweepCursor;
+	size_t destroyed{ 0 };
+
+	while (cursor.SizeClass < SizeClassCount && budget > 0)
+	{
+		SizeClass& sizeClass = m_SizeClasses[cursor.SizeClass];
+		if (cursor.Page >= sizeClass.Pages.size())
+		{
+			cursor.SizeClass++;
+			cursor.Page = 0;
+			cursor.Slot = 0;
+			continue;
+		}
+
+		std::vector<IGCObject*>& objects = sizeClass.Pages[cursor.Page].Objects;
+		while (cursor.Slot < objects.size() && budget > 0)
+		{
+			size_t s = cursor.Slot++;
+			budget--;
+
+			IGCObject* object = objects[s];
+			if (object == nullptr)
+				continue;
+
+			if (object->m_bIsMarked || !object->m_bIsOld)
+			{
+				object->m_bIsMarked = false;
+				continue;
+			}
+
+			object->~IGCObject();
+			objects[s] = nullptr;
+			sizeClass.FreeSlots.push_back({ (uint32_t)cursor.Page, (uint32_t)s });
+			destroyed++;
+		}
+
+		if (cursor.Slot >= objects.size())
+		{
+			cursor.Page++;
+			cursor.Slot = 0;
+		}
+	}
+
+	// Only old objects are in the list, removing one moves the last one at the cursor
+	while (cursor.Large < m_LargeObjects.size() && budget > 0)
+	{
+		budget--;
+		LargeObject& large = m_LargeObjects[cursor.Large];
+		if (large.Object->m_bIsMarked)
+		{
+			large.Object->m_bIsMarked = false;
+			cursor.Large++;
+			continue;
+		}
+
+		large.Object->~IGCObject();
+		::operator delete(large.Memory);
+		large = m_LargeObjects.back();
+		m_LargeObjects.pop_back();
+		destroyed++;
+	}
+
+	// Young small objects were handled with the pages
+	while (cursor.Nursery < m_Nursery.size() && budget > 0)
+	{
+		budget--;
+		const NurseryEntry& entry = m_Nursery[cursor.Nursery++];
+		if (entry.SizeClass == LargeSizeClass)
+		{
+			entry.Object->m_bIsMarked = false;
+		}
+	}
+
+	cursor.Destroyed += destroyed;
+	m_ObjectCount -= destroyed;
+	return cursor.SizeClass >= SizeClassCount && cursor.Large >= m_LargeObjects.size() && cursor.Nursery >= m_Nursery.size();
+}
+
+void* GCHeap::Allocate(size_t size, SlotLocation& location)
+{
+	if (size > MaxSmallObjectSize)
+	{
+		return ::operator new(size);
+	}
+
+	size_t slotSize = SlotSizeOf(SizeClassOf(size));
+	SizeClass& sizeClass = m_SizeClasses[SizeClassOf(size)];
+	if (sizeClass.FreeSlots.empty())
+	{
+		AddPage(sizeClass, slotSize);
+	}
+
+	location = sizeClass.FreeSlots.back();
+	sizeClass.FreeSlots.pop_back();
+	return sizeClass.Pages[location.Page].Memory.get() + location.Slot * slotSize;
+}
+
+void GCHeap::Release(size_t size, const SlotLocation& location, void* memory)
+{
+	if (size > MaxSmallObjectSize)
+	{
+		::operator delete(memory);
+		return;
+	}
+
+	m_SizeClasses[SizeClassOf(size)].FreeSlots.push_back(location);
+}
+
+void GCHeap::Track(size_t size, const SlotLocation& location, void* memory, IGCObject* object)
+{
+	if (size > MaxSmallObjectSize)
+	{
+		m_Nursery.push_back({ object, memory, LargeSizeClass, location });
+	}
+	else
+	{
+		uint32_t sizeClass = (uint32_t)SizeClassOf(size);
+		IGCObject*& slot = m_SizeClasses[sizeClass].Pages[location.Page].Objects[location.Slot];
+		assert(slot == nullptr);
+		slot = object;
+		m_Nursery.push_back({ object, memory, sizeClass, location });
+	}
+
+	m_ObjectCount++;
+}
+
+void GCHeap::Destroy(const NurseryEntry& entry)
+{
+	entry.Object->~IGCObject();
+	if (entry.SizeClass == LargeSizeClass)
+	{
+		::operator delete(entry.Memory);
+		return;
+	}
+
+	SizeClass& sizeClass = m_SizeClasses[entry.SizeClass];
+	sizeClass.Pages[entry.Location.Page].Objects[entry.Location.Slot] = nullptr;
+	sizeClass.FreeSlots.push_back(entry.Location);
+}
+
+void GCHeap::AddPage(SizeClass& sizeClass, size_t slotSize)
+{
+	size_t slotCount = PageSize / slotSize;
+	uint32_t pageIndex = (uint32_t)sizeClass.Pages.size();
+
+	Page& page = sizeClass.Pages.emplace_back();
+	page.Memory = std::make_unique<std::byte[]>(slotCount * slotSize);
+	page.Objects.resize(slotCount, nullptr);
+
+	// Hand out the lowest slots first
+	for (size_t s{ slotCount }; s > 0; s--)
+	{
+		sizeClass.FreeSlots.push_back({ pageIndex, (uint32_t)(s - 1) });
+	}
+}
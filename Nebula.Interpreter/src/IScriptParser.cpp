@@ -8,43 +8,33 @@ using namespace nebula;
 
 bool IScriptParser::ReadString(std::string& out, size_t maxIndex)
 {
-    if (Current() != '\"')
-    {
+    std::string_view str;
+    if (!ReadString(str, maxIndex))
         return false;
-    }
-    m_CurrentDataIndex++;
 
-    // TODO error if string contains unescaped new line
-    while (Current() != '\"')
-    {
-        out += Current();
-        m_CurrentDataIndex++;
-        if (maxIndex > 0 && m_CurrentDataIndex >= maxIndex)
-            return false;// Terminator not found
-    }
+    out += str;
+    return true;
+}
 
+bool IScriptParser::ReadString(std::string_view& out, size_t maxIndex)
+{
     if (Current() != '\"')
     {
         return false;
     }
 
-    m_CurrentDataIndex++;
-    return true;
-}
-
-char IScriptParser::Current()
-{
-    if (m_CurrentDataIndex >= m_CurrentData.size())
-        return 0;
+    // TODO error if string contains unescaped new line
+    size_t start = m_CurrentDataIndex + 1;
+    size_t end = m_CurrentData.find('\"', start);
+    if (end == std::string_view::npos)
+        return false;
 
-    return m_CurrentData[m_CurrentDataIndex];
-}
+    if (maxIndex > 0 && end > start && end >= maxIndex)
+        return false;// Terminator not found
 
-char IScriptParser::Next()
-{
-    char c = Current();
-    m_CurrentDataIndex++;
-    return c;
+    out = m_CurrentData.substr(start, end - start);
+    m_CurrentDataIndex = end + 1;
+    return true;
 }
 
 void IScriptParser::ReportErrorWhileParsingBundle(std::string_view bundleName)
@@ -54,7 +44,7 @@ void IScriptParser::ReportErrorWhileParsingBundle(std::string_view bundleName)
 
 void IScriptParser::ReportExpectedNumberAt(size_t charIndex)
 {
-    m_Report.ReportError(std::format("Expected digit at '{}' but found '{}'", charIndex, m_CurrentData[charIndex]));
+    m_Report.ReportError(std::format("Expected digit at '{}' but found '{}'", charIndex, CharAt(charIndex)));
 }
 
 void IScriptParser::ReportUnexpectedSection(size_t charIndex)
@@ -88,5 +78,5 @@ void IScriptParser::ReportUnknownAttribute(const std::string_view parsedAttribut
 
 void IScriptParser::ReportUnexpectedCharacter(size_t charIndex, std::string_view expected)
 {
-    m_Report.ReportError(std::format("Expected '{}' at '{}' but found '{}'", expected.data(), charIndex, m_CurrentData[charIndex]));
+    m_Report.ReportError(std::format("Expected '{}' at '{}' but found '{}'", expected.data(), charIndex, CharAt(charIndex)));
 }
\ No newline at end of file
@@ -1,4 +1,9 @@
 #include <cassert>
+#include <charconv>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <string>
 
 #include "InstructionRegistry.h"
 #include "Frame.h"
@@ -16,10 +21,10 @@ using namespace nebula;
 
 static InstructionErrorCode CastToInt(DataStackVariant& valueToCast, DataStack& stack)
 {
-	DataStackVariantIndex fromType = (DataStackVariantIndex)valueToCast.index();
+	DataStackVariantIndex fromType = (DataStackVariantIndex)valueToCast.Type();
 	if (fromType == DataStackVariantIndex::_TypeFloat)
 	{
-		TFloat fromValue = std::get<DataStackVariantIndex::_TypeFloat>(valueToCast);
+		TFloat fromValue = valueToCast.AsFloat();
 		stack.Pop();
 		stack.Push({ (TInt32)fromValue });
 		return InstructionErrorCode::None;
@@ -28,7 +33,7 @@ static InstructionErrorCode CastToInt(DataStackVariant& valueToCast, DataStack&
 	[[unlikely]]
 	if (fromType == DataStackVariantIndex::_TypeInt32)
 	{
-		TInt32 fromValue = std::get<DataStackVariantIndex::_TypeInt32>(valueToCast);
+		TInt32 fromValue = valueToCast.AsInt32();
 		stack.Pop();
 		stack.Push({ (TInt32)fromValue });
 		return InstructionErrorCode::None;
@@ -39,10 +44,10 @@ static InstructionErrorCode CastToInt(DataStackVariant& valueToCast, DataStack&
 
 static InstructionErrorCode CastToFloat(DataStackVariant& valueToCast, DataStack& stack)
 {
-	DataStackVariantIndex fromType = (DataStackVariantIndex)valueToCast.index();
+	DataStackVariantIndex fromType = (DataStackVariantIndex)valueToCast.Type();
 	if (fromType == DataStackVariantIndex::_TypeInt32)
 	{
-		TInt32 fromValue = std::get<DataStackVariantIndex::_TypeInt32>(valueToCast);
+		TInt32 fromValue = valueToCast.AsInt32();
 		stack.Pop();
 		stack.Push({ (TFloat)fromValue });
 		return InstructionErrorCode::None;
@@ -51,7 +56,7 @@ static InstructionErrorCode CastToFloat(DataStackVariant& valueToCast, DataStack
 	[[unlikely]]
 	if (fromType == DataStackVariantIndex::_TypeFloat)
 	{
-		TFloat fromValue = std::get<DataStackVariantIndex::_TypeFloat>(valueToCast);
+		TFloat fromValue = valueToCast.AsFloat();
 		stack.Pop();
 		stack.Push({ (TFloat)fromValue });
 		return InstructionErrorCode::None;
@@ -64,11 +69,11 @@ static InstructionErrorCode SumDataStackVariants(DataStack& stack)
 {
 	DataStackVariant& a = stack.Peek();
 	DataStackVariant& b = stack.Peek(1);
-	if (const TInt32* iValA = std::get_if<TInt32>(&a))
+	if (const TInt32* iValA = a.GetIf<TInt32>())
 	{
 		stack.Pop();
 
-		if (const TInt32* iValB = std::get_if<TInt32>(&b))
+		if (const TInt32* iValB = b.GetIf<TInt32>())
 		{
 			stack.Pop();
 
@@ -77,7 +82,7 @@ static InstructionErrorCode SumDataStackVariants(DataStack& stack)
 			return InstructionErrorCode::None;
 		}
 
-		if (const TFloat* fValB = std::get_if<TFloat>(&b))
+		if (const TFloat* fValB = b.GetIf<TFloat>())
 		{
 			stack.Pop();
 
@@ -89,11 +94,11 @@ static InstructionErrorCode SumDataStackVariants(DataStack& stack)
 		return InstructionErrorCode::Fatal;
 	}
 
-	if (const TFloat* fValA = std::get_if<TFloat>(&a))
+	if (const TFloat* fValA = a.GetIf<TFloat>())
 	{
 		stack.Pop();
 
-		if (const TInt32* iValB = std::get_if<TInt32>(&b))
+		if (const TInt32* iValB = b.GetIf<TInt32>())
 		{
 			stack.Pop();
 
@@ -102,7 +107,7 @@ static InstructionErrorCode SumDataStackVariants(DataStack& stack)
 			return InstructionErrorCode::None;
 		}
 
-		if (const TFloat* fValB = std::get_if<TFloat>(&b))
+		if (const TFloat* fValB = b.GetIf<TFloat>())
 		{
 			stack.Pop();
 
@@ -122,11 +127,11 @@ static InstructionErrorCode SubDataStackVariants(DataStack& stack)
 	DataStackVariant& b = stack.Peek();
 	DataStackVariant& a = stack.Peek(1);
 
-	if (const TInt32* iValA = std::get_if<TInt32>(&a))
+	if (const TInt32* iValA = a.GetIf<TInt32>())
 	{
 		stack.Pop();
 
-		if (const TInt32* iValB = std::get_if<TInt32>(&b))
+		if (const TInt32* iValB = b.GetIf<TInt32>())
 		{
 			stack.Pop();
 
@@ -135,7 +140,7 @@ static InstructionErrorCode SubDataStackVariants(DataStack& stack)
 			return InstructionErrorCode::None;
 		}
 
-		if (const TFloat* fValB = std::get_if<TFloat>(&b))
+		if (const TFloat* fValB = b.GetIf<TFloat>())
 		{
 			stack.Pop();
 
@@ -147,11 +152,11 @@ static InstructionErrorCode SubDataStackVariants(DataStack& stack)
 		return InstructionErrorCode::Fatal;
 	}
 
-	if (const TFloat* fValA = std::get_if<TFloat>(&a))
+	if (const TFloat* fValA = a.GetIf<TFloat>())
 	{
 		stack.Pop();
 
-		if (const TInt32* iValB = std::get_if<TInt32>(&b))
+		if (const TInt32* iValB = b.GetIf<TInt32>())
 		{
 			stack.Pop();
 
@@ -160,7 +165,7 @@ static InstructionErrorCode SubDataStackVariants(DataStack& stack)
 			return InstructionErrorCode::None;
 		}
 
-		if (const TFloat* fValB = std::get_if<TFloat>(&b))
+		if (const TFloat* fValB = b.GetIf<TFloat>())
 		{
 			stack.Pop();
 
@@ -179,11 +184,11 @@ static InstructionErrorCode MulDataStackVariants(DataStack& stack)
 {
 	DataStackVariant& b = stack.Peek();
 	DataStackVariant& a = stack.Peek(1);
-	if (const TInt32* iValA = std::get_if<TInt32>(&a))
+	if (const TInt32* iValA = a.GetIf<TInt32>())
 	{
 		stack.Pop();
 
-		if (const TInt32* iValB = std::get_if<TInt32>(&b))
+		if (const TInt32* iValB = b.GetIf<TInt32>())
 		{
 			stack.Pop();
 
@@ -192,7 +197,7 @@ static InstructionErrorCode MulDataStackVariants(DataStack& stack)
 			return InstructionErrorCode::None;
 		}
 
-		if (const TFloat* fValB = std::get_if<TFloat>(&b))
+		if (const TFloat* fValB = b.GetIf<TFloat>())
 		{
 			stack.Pop();
 
@@ -204,11 +209,11 @@ static InstructionErrorCode MulDataStackVariants(DataStack& stack)
 		return InstructionErrorCode::Fatal;
 	}
 
-	if (const TFloat* fValA = std::get_if<TFloat>(&a))
+	if (const TFloat* fValA = a.GetIf<TFloat>())
 	{
 		stack.Pop();
 
-		if (const TInt32* iValB = std::get_if<TInt32>(&b))
+		if (const TInt32* iValB = b.GetIf<TInt32>())
 		{
 			stack.Pop();
 
@@ -217,7 +222,7 @@ static InstructionErrorCode MulDataStackVariants(DataStack& stack)
 			return InstructionErrorCode::None;
 		}
 
-		if (const TFloat* fValB = std::get_if<TFloat>(&b))
+		if (const TFloat* fValB = b.GetIf<TFloat>())
 		{
 			stack.Pop();
 
@@ -236,15 +241,15 @@ static InstructionErrorCode DivDataStackVariants(DataStack& stack)
 {
 	DataStackVariant& b = stack.Peek();
 	DataStackVariant& a = stack.Peek(1);
-	if (const TInt32* iValA = std::get_if<TInt32>(&a))
+	if (const TInt32* iValA = a.GetIf<TInt32>())
 	{
 		stack.Pop();
 
-		if (const TInt32* iValB = std::get_if<TInt32>(&b))
+		if (const TInt32* iValB = b.GetIf<TInt32>())
 		{
 			stack.Pop();
 
-			if (iValB == 0)
+			if (*iValB == 0)
 			{
 				return InstructionErrorCode::DivideByZero;
 			}
@@ -254,11 +259,11 @@ static InstructionErrorCode DivDataStackVariants(DataStack& stack)
 			return InstructionErrorCode::None;
 		}
 
-		if (const TFloat* fValB = std::get_if<TFloat>(&b))
+		if (const TFloat* fValB = b.GetIf<TFloat>())
 		{
 			stack.Pop();
 
-			if (fValB == 0)
+			if (*fValB == 0)
 			{
 				return InstructionErrorCode::DivideByZero;
 			}
@@ -271,14 +276,14 @@ static InstructionErrorCode DivDataStackVariants(DataStack& stack)
 		return InstructionErrorCode::Fatal;
 	}
 
-	if (const TFloat* fValA = std::get_if<TFloat>(&a))
+	if (const TFloat* fValA = a.GetIf<TFloat>())
 	{
 		stack.Pop();
 
-		if (const TInt32* iValB = std::get_if<TInt32>(&b))
+		if (const TInt32* iValB = b.GetIf<TInt32>())
 		{
 			stack.Pop();
-			if (iValB == 0)
+			if (*iValB == 0)
 			{
 				return InstructionErrorCode::DivideByZero;
 			}
@@ -288,10 +293,10 @@ static InstructionErrorCode DivDataStackVariants(DataStack& stack)
 			return InstructionErrorCode::None;
 		}
 
-		if (const TFloat* fValB = std::get_if<TFloat>(&b))
+		if (const TFloat* fValB = b.GetIf<TFloat>())
 		{
 			stack.Pop();
-			if (fValB == 0)
+			if (*fValB == 0)
 			{
 				return InstructionErrorCode::DivideByZero;
 			}
@@ -307,6 +312,155 @@ static InstructionErrorCode DivDataStackVariants(DataStack& stack)
 	return InstructionErrorCode::Fatal;
 }
 
+template<typename TCompare>
+static InstructionErrorCode CompareInt32DataStackVariants(DataStack& stack, TCompare compare)
+{
+	DataStackVariant& second = stack.Peek();
+	DataStackVariant& first = stack.Peek(1);
+
+	// Verified code only compares int32 values, unverified code can reach here with anything
+	if (!first.Is<TInt32>() || !second.Is<TInt32>())
+		return InstructionErrorCode::Fatal;
+
+	TInt32 val1 = first.AsInt32();
+	TInt32 val2 = second.AsInt32();
+	stack.Pop();
+	stack.Pop();
+
+	stack.Push(compare(val1, val2) ? 1 : 0);
+	return InstructionErrorCode::None;
+}
+
+template<typename TValue>
+static inline TValue ValueAs(const DataStackVariant& value)
+{
+	if constexpr (std::is_same_v<TValue, TInt32>)
+		return value.AsInt32();
+	else
+		return value.AsFloat();
+}
+
+template<typename TCompare>
+static inline TInt32 CompareAs(TInt32 a, TInt32 b)
+{
+	return TCompare{}(a, b) ? 1 : 0;
+}
+
+// Type specialized operations, both operands are known to be TValue so the result is written in place
+template<typename TValue, typename TOperation>
+static inline void ApplyInPlace(DataStack& stack, TOperation operation)
+{
+	TValue b = ValueAs<TValue>(stack.Peek());
+	stack.Pop();
+	DataStackVariant& a = stack.Peek();
+	a = DataStackVariant{ operation(ValueAs<TValue>(a), b) };
+}
+
+template<typename TValue>
+static inline InstructionErrorCode DivideInPlace(DataStack& stack)
+{
+	[[unlikely]]
+	if (ValueAs<TValue>(stack.Peek()) == 0)
+		return InstructionErrorCode::DivideByZero;
+
+	ApplyInPlace<TValue>(stack, std::divides<TValue>{});
+	return InstructionErrorCode::None;
+}
+
+template<bool TVerified>
+static inline void JumpTo(Frame* context, size_t& ip, TInt32 target)
+{
+	// Branch targets of verified code are in range
+	if constexpr (TVerified)
+	{
+		ip = (size_t)target;
+	}
+	else
+	{
+		context->SetNextInstruction(target);
+	}
+}
+
+template<bool TVerified>
+static inline Variable& LocalAt(FrameMemory& memory, TInt32 index)
+{
+	if constexpr (TVerified)
+		return memory.UncheckedLocalAt(index);
+	else
+		return memory.LocalAt(index);
+}
+
+template<bool TVerified>
+static inline Variable& ParamAt(FrameMemory& memory, TInt32 index)
+{
+	if constexpr (TVerified)
+		return memory.UncheckedParamAt(index);
+	else
+		return memory.ParamAt(index);
+}
+
+// Compare and branch superinstructions, ip is moved past the fused sequence when the branch isn't taken
+template<bool TVerified, typename TCompare>
+static inline void BranchIf(Frame* context, size_t& ip, const LinkedInstruction& instruction, TInt32 a, TInt32 b)
+{
+	if (TCompare{}(a, b))
+	{
+		JumpTo<TVerified>(context, ip, instruction.C.Int);
+	}
+	else
+	{
+		ip += 3;
+	}
+}
+
+// Script functions expect their parameters to hold values of the declared type
+static bool ArgumentsMatch(DataStack& stack, const VariableList& params)
+{
+	if (stack.Size() < params.size())
+		return false;
+
+	for (size_t i{ 0 }; i < params.size(); i++)
+	{
+		if (stack.Peek(params.size() - 1 - i).Type() != params[i])
+			return false;
+	}
+
+	return true;
+}
+
+// Same result as strtol with a 32 bit long: conversion stops at the first non digit and out of range values saturate
+static TInt32 IntArgument(std::string_view arg)
+{
+	if (arg.starts_with('+'))
+		arg.remove_prefix(1);
+
+	TInt32 value{ 0 };
+	std::from_chars_result result = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+	if (result.ec == std::errc::result_out_of_range)
+		return arg.starts_with('-') ? std::numeric_limits<TInt32>::min() : std::numeric_limits<TInt32>::max();
+
+	return value;
+}
+
+static TFloat FloatArgument(std::string_view arg)
+{
+	TFloat value{ 0 };
+	std::from_chars_result result = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+	if (result.ec == std::errc{} && result.ptr == arg.data() + arg.size())
+		return value;
+
+	// Whatever from_chars doesn't fully take gets the result (or exception) it always had
+	size_t processed = 0;
+	float converted = std::stof(std::string{ arg }, &processed);
+	assert(processed == arg.size());
+	return converted;
+}
+
+// Interned strings are never released, constants are only interned once their script links (see LinkedCode::InternArgument)
+static DataStackVariant StringArgument(std::string_view arg)
+{
+	return DataStackVariant(TString{ arg });
+}
 
 InstructionArguments nebula::GenerateArgumentsForOpcode(VMInstruction opcode, const RawArguments& args)
 {
@@ -361,12 +515,12 @@ InstructionArguments nebula::GenerateArgumentsForOpcode(VMInstruction opcode, co
 		case 1:
 		{
 			// FuncName
-			return { args[0] };
+			return { StringArgument(args[0]) };
 		}
 		case 2:
 		{
 			// FuncName - Namespace
-			return { args[0], args[1] };
+			return { StringArgument(args[0]), StringArgument(args[1]) };
 		}
 		}
 		break;
@@ -374,8 +528,7 @@ InstructionArguments nebula::GenerateArgumentsForOpcode(VMInstruction opcode, co
 	case VMInstruction::NewArr:
 	{
 		assert((args.size() == 1 || args.size() == 2 || args.size() == 3) && "Wrong argument number for newarr opcode");
-		const std::string& targetType = args[0];
-		TInt32 dataType = (TInt32)StringToStackValue(targetType);
+		TInt32 dataType = (TInt32)StringToStackValue(args[0]);
 
 		if (args.size() == 1)
 		{
@@ -384,25 +537,20 @@ InstructionArguments nebula::GenerateArgumentsForOpcode(VMInstruction opcode, co
 
 		if (args.size() == 2)
 		{
-			return { dataType, args[1] };
+			return { dataType, StringArgument(args[1]) };
 		}
 
-		return { dataType, args[1], args[2] };
+		return { dataType, StringArgument(args[1]), StringArgument(args[2]) };
 	}
 	case VMInstruction::CallVirt:
 	{
 		assert(args.size() == 2);
-		char* p{ nullptr };
-		long converted = strtol(args[0].data(), &p, 10);
-		return { converted, args[1] };
+		return { IntArgument(args[0]), StringArgument(args[1]) };
 	}
 	case VMInstruction::AddStr:     // Number of strings on stack to sum
 	{
 		assert(args.size() == 1);
-		char* p{ nullptr };
-		long converted = strtol(args[0].data(), &p, 10);
-		assert(p != nullptr);
-		return { converted };
+		return { IntArgument(args[0]) };
 	}
 	case VMInstruction::Stloc:	    // Contains index so we convert it like an i4 constant
 	case VMInstruction::StArg:	    // Contains index so we convert it like an i4 constant
@@ -417,32 +565,24 @@ InstructionArguments nebula::GenerateArgumentsForOpcode(VMInstruction opcode, co
 	case VMInstruction::Ldc_i4:
 	{
 		assert(args.size() == 1);
-		char* p{ nullptr };
-		long converted = strtol(args[0].data(), &p, 10);
-		assert(p != nullptr);
-		return { converted };
+		return { IntArgument(args[0]) };
 	}
 	case VMInstruction::Ldc_r4:
 	{
 		assert(args.size() == 1);
-		size_t processed = 0;
-		float converted = std::stof(args[0], &processed);
-		assert(processed == args[0].size());
-		return { converted };
+		return { FloatArgument(args[0]) };
 	}
 	case VMInstruction::Ldc_s:
 	{
 		assert(args.size() == 1);
-		return { args[0] };
+		return { StringArgument(args[0]) };
 	}
 	case VMInstruction::StsFld:
 	case VMInstruction::LdSfld:
 	{
 		assert(args.size() == 1 || args.size() == 2);
 
-		char* p{ nullptr };
-		TInt32 globalIndex = strtol(args[0].data(), &p, 10);
-		assert(p != nullptr);
+		TInt32 globalIndex = IntArgument(args[0]);
 
 		switch (args.size())
 		{
@@ -454,7 +594,7 @@ InstructionArguments nebula::GenerateArgumentsForOpcode(VMInstruction opcode, co
 		case 2:
 		{
 			// Global index - Namespace
-			return { globalIndex, args[1] };
+			return { globalIndex, StringArgument(args[1]) };
 		}
 		}
 
@@ -470,8 +610,10 @@ InstructionArguments nebula::GenerateArgumentsForOpcode(VMInstruction opcode, co
 	throw std::exception("Unknown opcode or aguments not valid!");
 }
 
-InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interpreter* interpreter, Frame* context, const InstructionArguments& args)
+InstructionErrorCode nebula::ExecuteInstruction(const LinkedInstruction& instruction, Interpreter* interpreter, Frame* context)
 {
+	const VMInstruction opcode = instruction.Opcode;
+	const LinkedCode& code = context->GetFunction()->Code();
 	DataStack& stack = context->Stack();
 	switch (opcode)
 	{
@@ -502,10 +644,10 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 		DataStackVariant& b = stack.Peek();
 		DataStackVariant& a = stack.Peek(1);
 
-		assert(std::holds_alternative<TInt32>(a));
-		assert(std::holds_alternative<TInt32>(b));
+		assert(a.Is<TInt32>());
+		assert(b.Is<TInt32>());
 
-		TInt32 div = std::get<DataStackVariantIndex::_TypeInt32>(b);
+		TInt32 div = b.AsInt32();
 		stack.Pop();
 
 		if (div == 0)
@@ -513,7 +655,7 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 			return InstructionErrorCode::DivideByZero;
 		}
 
-		TInt32 valA = std::get<DataStackVariantIndex::_TypeInt32>(a);
+		TInt32 valA = a.AsInt32();
 		stack.Pop();
 
 		TInt32 result = valA % div;
@@ -538,18 +680,23 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 	}
 	case VMInstruction::CallVirt:
 	{
-		assert(args.size() == 2);
-		assert(std::holds_alternative<TInt32>(args[0]));
-		assert(std::holds_alternative<TString>(args[1]));
-
-		int localIndex = std::get<DataStackVariantIndex::_TypeInt32>(args[0]);
-		const TString& funcName = std::get<DataStackVariantIndex::_TypeString>(args[1]);
+		int localIndex = instruction.A.Int;
+		CallSite& site = code.CallSiteAt(instruction.C.Int);
 
 		Variable& var = context->Memory().LocalAt(localIndex);
-		const TGCObject& ptr = var.AsGCObject();
-		if (ptr.get() != nullptr)
+		IGCObject* ptr = var.AsObject();
+		if (ptr != nullptr)
 		{
-			InstructionErrorCode result = ptr->CallVirtual(funcName, interpreter, context);
+			// Appending is the only way to store in an array
+			if (site.Method == VirtualMethod::Append)
+			{
+				interpreter->m_Memory.FieldWriteBarrier(ptr, context->Stack().Peek());
+			}
+
+			// Arrays are the only objects with methods, skip the virtual dispatch for them
+			InstructionErrorCode result = ptr->GetType() == ObjectType::Array
+				? static_cast<VariantArray*>(ptr)->CallMethod(site.Method, context)
+				: ptr->CallVirtual(site.Method, interpreter, context);
 			assert(result == InstructionErrorCode::None);
 			return result;
 		}
@@ -559,11 +706,19 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 			return InstructionErrorCode::NotAPrimitive;
 		}
 
-		auto func = interpreter->GetTypeFunction(var.Type(), funcName);
-		if (func != nullptr)
+		// Monomorphic cache of the type function, a miss looks it up by name
+		[[unlikely]]
+		if (site.Generation != interpreter->m_CallSiteGeneration || site.ReceiverType != var.Type())
+		{
+			site.NativeTarget = interpreter->GetTypeFunction(var.Type(), code.String(instruction.B.String));
+			site.ReceiverType = var.Type();
+			site.Generation = interpreter->m_CallSiteGeneration;
+		}
+
+		if (site.NativeTarget != nullptr)
 		{
 			context->Stack().Push(var.Value());
-			return (*func)(interpreter, context);
+			return (*site.NativeTarget)(interpreter, context);
 		}
 
 		return InstructionErrorCode::FunctionNotFound;
@@ -571,66 +726,53 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 	case VMInstruction::Call_t:
 	case VMInstruction::Call:
 	{
-		assert(args.size() == 1 || args.size() == 2);
-		assert(std::holds_alternative<TString>(args[0]));
-
 		bool threaded = opcode == VMInstruction::Call_t;
-		switch (args.size())
+		CallSite& site = code.CallSiteAt(instruction.C.Int);
+		[[unlikely]]
+		if (site.Generation != interpreter->m_CallSiteGeneration)
 		{
-		case 1:
-		{
-			// Implicit namespace OR builtin function call
-			const TString& ns = context->Namespace();
-			const TString& funcName = std::get<DataStackVariantIndex::_TypeString>(args[0]);
-			const Function* function = interpreter->GetFunction(ns, funcName);
-
-			[[likely]]
-			if (function != nullptr)
-			{
-				interpreter->CreateFrameOnStack(function, threaded);
-				return InstructionErrorCode::None;
-			}
+			interpreter->ResolveCallSite(context->GetFunction(), instruction, site);
+		}
 
-			/* TODO :: Built in should be able to be thread too! */
-			const NativeFunctionCallback* nativeFuncPtr = interpreter->GetNativeFunction(funcName);
-			[[unlikely]]
-			if (nativeFuncPtr == nullptr)
+		[[likely]]
+		if (site.Target != nullptr)
+		{
+			// Verified callers already passed arguments of the right type
+			if (!context->GetFunction()->IsVerified() && !ArgumentsMatch(context->Stack(), site.Target->Parameters()))
 			{
-				// Function not found
-				return InstructionErrorCode::NativeFunctionNotFound;
+				return InstructionErrorCode::Fatal;
 			}
 
-			// Should return instruction error
-			auto nativeResult = (*nativeFuncPtr)(interpreter, context);
-			assert(nativeResult == InstructionErrorCode::None);
-			return nativeResult;
+			interpreter->CreateFrameOnStack(site.Target, threaded);
+			return InstructionErrorCode::None;
 		}
-		case 2:
-		{
-			assert(std::holds_alternative<TString>(args[1]));
-
-			// Namespace is not explicit, function MUST exist
-			const TString& ns = std::get<DataStackVariantIndex::_TypeString>(args[0]);
-			const TString& funcName = std::get<DataStackVariantIndex::_TypeString>(args[1]);
-			auto function = interpreter->GetFunction(ns, funcName);
-			if (function != nullptr)
-			{
-				interpreter->CreateFrameOnStack(function, threaded);
-				return InstructionErrorCode::None;
-			}
 
+		// Only calls with an implicit namespace can be builtin calls
+		if (instruction.B.String != InvalidStringId)
+		{
 			return InstructionErrorCode::FunctionNotFound;
 		}
+
+		/* TODO :: Built in should be able to be thread too! */
+		[[unlikely]]
+		if (site.NativeTarget == nullptr)
+		{
+			// Function not found
+			return InstructionErrorCode::NativeFunctionNotFound;
 		}
-		break;
+
+		// Should return instruction error
+		auto nativeResult = (*site.NativeTarget)(interpreter, context);
+		assert(nativeResult == InstructionErrorCode::None);
+		return nativeResult;
 	}
 	case VMInstruction::Wait:
 	{
 		TFloat seconds;
-		auto ptr = std::get_if<TFloat>(&stack.Peek());
+		auto ptr = stack.Peek().GetIf<TFloat>();
 		if (ptr == nullptr)
 		{
-			seconds = (TFloat)std::get<DataStackVariantIndex::_TypeInt32>(stack.Peek());
+			seconds = (TFloat)stack.Peek().AsInt32();
 		}
 		else
 		{
@@ -644,59 +786,55 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 	}
 	case VMInstruction::ChkDef:
 	{
-		assert(args.size() == 0);
-		assert(std::holds_alternative<TGCObject>(stack.Peek()));
-		bool isDefined = std::get<TGCObject>(stack.Peek()).get() != nullptr;
+		assert(stack.Peek().Is<TGCObject>());
+		bool isDefined = stack.Peek().AsObject() != nullptr;
 		stack.Pop();
 		stack.Push(isDefined);
 		return InstructionErrorCode::None;
 	}
 	case VMInstruction::Wait_n:
 	{
-		assert(args.size() == 0);
-		assert(std::holds_alternative<TString>(stack.Peek()));
+		assert(stack.Peek().Is<TString>());
 
-		// Load the string to notify
-		TString stringToNotify = std::get<TString>(stack.Peek());
+		// Load the string to notify, constants have their hash precomputed
+		size_t notificationHash = stack.Peek().AsSharedString()->Hash();
 		stack.Pop();
 
 		// Load the bundle that will notify this message
-		assert(std::holds_alternative<TGCObject>(stack.Peek()));
-		TGCObject& bundle = std::get<TGCObject>(stack.Peek());
-		context->WaitForNotification(bundle.get(), stringToNotify);
+		assert(stack.Peek().Is<TGCObject>());
+		IGCObject* bundle = stack.Peek().AsObject();
+		context->WaitForNotification(bundle, notificationHash);
 		stack.Pop();
 
 		return InstructionErrorCode::None;
 	}
 	case VMInstruction::Endon:
 	{
-		assert(args.size() == 0);
-		assert(std::holds_alternative<TString>(stack.Peek()));
+		assert(stack.Peek().Is<TString>());
 
 		// Load the string to end on
-		TString stringToNotify = std::get<TString>(stack.Peek());
+		size_t notificationHash = stack.Peek().AsSharedString()->Hash();
 		stack.Pop();
 
 		// Load the bundle that will notify this message
-		assert(std::holds_alternative<TGCObject>(stack.Peek()));
-		TGCObject& obj = std::get<TGCObject>(stack.Peek());
-		context->EndOnNotification(obj.get(), stringToNotify);
+		assert(stack.Peek().Is<TGCObject>());
+		IGCObject* obj = stack.Peek().AsObject();
+		context->EndOnNotification(obj, notificationHash);
 		stack.Pop();
 		return InstructionErrorCode::None;
 	}
 	case VMInstruction::Notify:
 	{
-		assert(args.size() == 0);
-		assert(std::holds_alternative<TString>(stack.Peek()));
+		assert(stack.Peek().Is<TString>());
 
 		// Load the string to notify
-		TString stringToNotify = std::get<TString>(stack.Peek());
+		size_t notificationHash = stack.Peek().AsSharedString()->Hash();
 		stack.Pop();
 
 		// Load the bundle that will notify this message
-		assert(std::holds_alternative<TGCObject>(stack.Peek()));
-		TGCObject& obj = std::get<TGCObject>(stack.Peek());
-		obj->Notify(stringToNotify);
+		assert(stack.Peek().Is<TGCObject>());
+		IGCObject* obj = stack.Peek().AsObject();
+		obj->Notify(notificationHash);
 		stack.Pop();
 		return InstructionErrorCode::None;
 	}
@@ -715,10 +853,11 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 			DataStackVariant& retValue = stack.Peek();
 
 			[[unlikely]]
-			if (retValue.index() != func->ReturnType())
+			if (retValue.Type() != func->ReturnType())
 				return InstructionErrorCode::Fatal;
 
-			parentStack.Push(retValue);
+			// Moved, the frame is about to be destroyed
+			parentStack.Push(std::move(retValue));
 			stack.Pop();
 		}
 
@@ -782,54 +921,31 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 	}
 	case VMInstruction::Ldc_i4:
 	{
-		assert(args.size() == 1);
-		assert(std::holds_alternative<TInt32>(args[0]));
-
-		stack.Push(std::get<DataStackVariantIndex::_TypeInt32>(args[0]));
+		stack.Push(instruction.A.Int);
 		return InstructionErrorCode::None;
 	}
 	case VMInstruction::Ldc_r4:
 	{
-		assert(args.size() == 1);
-		assert(std::holds_alternative<TFloat>(args[0]));
-
-		stack.Push(std::get<DataStackVariantIndex::_TypeFloat>(args[0]));
+		stack.Push(instruction.A.Float);
 		return InstructionErrorCode::None;
 	}
 	case VMInstruction::Ldc_s:
 	{
-		assert(args.size() == 1);
-		assert(std::holds_alternative<TString>(args[0]));
-
-		const TString& cStr = std::get<DataStackVariantIndex::_TypeString>(args[0]);
-		stack.Push(cStr);
+		// Constants are interned, this is just a pointer copy
+		stack.Push(code.SharedStringAt(instruction.A.String));
 		return InstructionErrorCode::None;
 	}
 	case VMInstruction::Newobj:
 	{
-		assert(args.size() == 1 || args.size() == 2);
-		const BundleDefinition* bundleDefinition = nullptr;
-		switch (args.size())
-		{
-		case 1:
-		{
-			const TString& bundleTypeName = std::get<DataStackVariantIndex::_TypeString>(args[0]);
-			bundleDefinition = interpreter->GetBundleDefinition(context->Namespace(), bundleTypeName);
-			break;
-		}
-		case 2:
+		CallSite& site = code.CallSiteAt(instruction.C.Int);
+		[[unlikely]]
+		if (site.Generation != interpreter->m_CallSiteGeneration)
 		{
-			const TString& namespaceName = std::get<DataStackVariantIndex::_TypeString>(args[0]);
-			const TString& bundleTypeName = std::get<DataStackVariantIndex::_TypeString>(args[1]);
-			bundleDefinition = interpreter->GetBundleDefinition(namespaceName, bundleTypeName);
-			break;
-		}
-		default:
-		{
-			return InstructionErrorCode::Fatal;
-		}
+			interpreter->ResolveCallSite(context->GetFunction(), instruction, site);
 		}
 
+		const BundleDefinition* bundleDefinition = site.BundleTarget;
+
 		if (bundleDefinition == nullptr)
 		{
 			return InstructionErrorCode::BundleNotFound;
@@ -841,42 +957,50 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 	}
 	case VMInstruction::LdFld:
 	{
-		assert(args.size() == 1);
-		assert(std::holds_alternative<TInt32>(args[0]));
-
-		TInt32 fieldIndex = std::get<DataStackVariantIndex::_TypeInt32>(args[0]);
+		TInt32 fieldIndex = instruction.A.Int;
 
 		DataStackVariant variant = context->Stack().Peek();
 		context->Stack().Pop();
 
-		assert(std::holds_alternative<TGCObject>(variant));
+		assert(variant.Is<TGCObject>());
 
-		TGCObject obj = std::get<DataStackVariantIndex::_TypeObject>(variant);
+		IGCObject* obj = variant.AsObject();
 		CHECK_GC_OBJECT_IS_BUNDLE(obj);
 
-		Bundle* bundle = static_cast<Bundle*>(obj.get());
+		Bundle* bundle = static_cast<Bundle*>(obj);
 		DataStackVariant& dataStackVariant = bundle->Get(fieldIndex);
 		stack.Push(dataStackVariant);
 
 		return InstructionErrorCode::None;
 	}
+	// Superinstructions only run their first instruction when stepping, the rest of the sequence follows them
 	case VMInstruction::Ldloc:
-	{
-		assert(args.size() == 1);
-		assert(std::holds_alternative<TInt32>(args[0]));
-
-		TInt32 localIndex = std::get<DataStackVariantIndex::_TypeInt32>(args[0]);
+	case VMInstruction::Ldloc2:
+	case VMInstruction::LdlocAddC_i4:
+	case VMInstruction::IncLoc_i4:
+	case VMInstruction::BrLocLt_i4:
+	case VMInstruction::BrLocGe_i4:
+	case VMInstruction::BrLocGt_i4:
+	case VMInstruction::BrLocLe_i4:
+	case VMInstruction::BrLocEq_i4:
+	case VMInstruction::BrLocNe_i4:
+	case VMInstruction::BrLocLtC_i4:
+	case VMInstruction::BrLocGeC_i4:
+	case VMInstruction::BrLocGtC_i4:
+	case VMInstruction::BrLocLeC_i4:
+	case VMInstruction::BrLocEqC_i4:
+	case VMInstruction::BrLocNeC_i4:
+	{
+		TInt32 localIndex = instruction.A.Int;
 		Variable& var = context->Memory().LocalAt(localIndex);
 
 		stack.Push(var.Value());
 		return InstructionErrorCode::None;
 	}
 	case VMInstruction::Ldarg:
+	case VMInstruction::LdargAddC_i4:
 	{
-		assert(args.size() == 1);
-		assert(std::holds_alternative<TInt32>(args[0]));
-
-		TInt32 argIndex = std::get<DataStackVariantIndex::_TypeInt32>(args[0]);
+		TInt32 argIndex = instruction.A.Int;
 		Variable& var = context->Memory().ParamAt(argIndex);
 
 		stack.Push(var.Value());
@@ -885,77 +1009,76 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 	}
 	case VMInstruction::LdSfld:
 	{
-		assert(args.size() == 1 || args.size() == 2);
-		assert(std::holds_alternative<TInt32>(args[0]));
-		assert(args.size() == 1 || std::holds_alternative<TString>(args[1]));
-
-		TInt32 staticIndex = std::get<DataStackVariantIndex::_TypeInt32>(args[0]);
-		TString namespaceStr;
-		if (args.size() > 1)
+		GlobalSite& site = code.GlobalSiteAt(instruction.C.Int);
+		[[unlikely]]
+		if (site.Generation != interpreter->m_CallSiteGeneration)
 		{
-			namespaceStr = std::get<DataStackVariantIndex::_TypeString>(args[1]);
-		}
-		else
-		{
-			namespaceStr = context->Namespace();
+			interpreter->ResolveGlobalSite(context->GetFunction(), instruction, site);
 		}
 
-		Variable* variant = interpreter->m_Memory.GetGlobal(namespaceStr, staticIndex);
-		if (variant == nullptr)
+		if (site.Slot == InvalidGlobalSlot)
 		{
 			return InstructionErrorCode::GlobalVariableNotFound;
 		}
 
+		Variable* variant = &interpreter->m_Memory.GlobalAt(site.Slot);
+
 		context->Stack().Push(variant->Value());
 		return InstructionErrorCode::None;
 	}
 	case VMInstruction::AddStr:
 	{
-		TInt32 numOfStrings = std::get<DataStackVariantIndex::_TypeInt32>(args[0]);
-		// TODO :: manually sum strings up to 4, then use more expensive way!
+		size_t numOfStrings = (size_t)instruction.A.Int;
+		assert(numOfStrings <= stack.Size());
 
-		std::vector<std::string> strs;
-		strs.reserve((size_t)numOfStrings);
-		for (TInt32 i{ 0 }; i < numOfStrings; i++)
+		// Operands are read in place, the deepest one is the first part of the result
+		constexpr size_t maxInlineParts = 16;
+		SharedString* inlineParts[maxInlineParts];
+		std::vector<SharedString*> manyParts;
+		SharedString** parts = inlineParts;
+		if (numOfStrings > maxInlineParts)
 		{
-			DataStackVariant strVal = context->Stack().Peek();
-			context->Stack().Pop();
-			assert(std::holds_alternative<TString>(strVal));
-			std::string newStr = std::get<DataStackVariantIndex::_TypeString>(strVal);
-			strs.push_back(newStr);
+			manyParts.resize(numOfStrings);
+			parts = manyParts.data();
 		}
 
-		std::string finalString;
-		for (TInt32 i{ numOfStrings - 1 }; i >= 0; i--)
+		for (size_t i{ 0 }; i < numOfStrings; i++)
 		{
-			finalString += strs[i];
+			const DataStackVariant& strVal = stack.Peek(numOfStrings - 1 - i);
+			assert(strVal.Is<TString>());
+			parts[i] = strVal.AsSharedString();
 		}
 
-		context->Stack().Push({ finalString });
+		// Parts are still referenced by the stack while concatenating
+		DataStackVariant result{ SharedString::Concatenate(parts, numOfStrings) };
+		for (size_t i{ 0 }; i < numOfStrings; i++)
+		{
+			stack.Pop();
+		}
+
+		stack.Push(std::move(result));
 		return InstructionErrorCode::None;
 	}
 	case VMInstruction::StFld:
 	{
-		assert(args.size() == 1);
-		assert(std::holds_alternative<TInt32>(args[0]));
-
 		DataStackVariant value = context->Stack().Peek();
 		context->Stack().Pop();
 
 		DataStackVariant variant = context->Stack().Peek();
 		context->Stack().Pop();
 
-		TInt32 fieldIndex = std::get<DataStackVariantIndex::_TypeInt32>(args[0]);
-		TGCObject obj = std::get<DataStackVariantIndex::_TypeObject>(variant);
+		TInt32 fieldIndex = instruction.A.Int;
+		IGCObject* obj = variant.AsObject();
 		CHECK_GC_OBJECT_IS_BUNDLE(obj);
 
-		Bundle* bundle = (Bundle*)obj.get();
+		Bundle* bundle = (Bundle*)obj;
+		interpreter->m_Memory.FieldWriteBarrier(bundle, value);
 		bundle->SetAt(fieldIndex, value);
 		return InstructionErrorCode::None;
 	}
 	case VMInstruction::Stloc:
 	{
-		TInt32 localIndex = std::get<DataStackVariantIndex::_TypeInt32>(args[0]);
+		TInt32 localIndex = instruction.A.Int;
 		Variable& var = context->Memory().LocalAt(localIndex);
 		DataStackVariant value = stack.Peek();
 
@@ -971,7 +1094,7 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 	}
 	case VMInstruction::StArg:
 	{
-		TInt32 argIndex = std::get<DataStackVariantIndex::_TypeInt32>(args[0]);
+		TInt32 argIndex = instruction.A.Int;
 		Variable& var = context->Memory().ParamAt(argIndex);
 		DataStackVariant value = stack.Peek();
 		stack.Pop();
@@ -985,25 +1108,23 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 	}
 	case VMInstruction::StsFld:
 	{
-		TInt32 staticIndex = std::get<DataStackVariantIndex::_TypeInt32>(args[0]);
-		TString namespaceStr;
-		if (args.size() > 1)
+		GlobalSite& site = code.GlobalSiteAt(instruction.C.Int);
+		[[unlikely]]
+		if (site.Generation != interpreter->m_CallSiteGeneration)
 		{
-			namespaceStr = std::get<DataStackVariantIndex::_TypeString>(args[1]);
-		}
-		else
-		{
-			namespaceStr = context->Namespace();
+			interpreter->ResolveGlobalSite(context->GetFunction(), instruction, site);
 		}
 
-		Variable* variant = interpreter->m_Memory.GetGlobal(namespaceStr, staticIndex);
-		if (variant == nullptr)
+		if (site.Slot == InvalidGlobalSlot)
 		{
 			return InstructionErrorCode::GlobalVariableNotFound;
 		}
 
+		Variable* variant = &interpreter->m_Memory.GlobalAt(site.Slot);
+
 		DataStackVariant data = context->Stack().Peek();
 		context->Stack().Pop();
+		interpreter->m_Memory.GlobalWriteBarrier(site.Slot, data);
 		if (!variant->SetValue(data))
 		{
 			return InstructionErrorCode::Fatal;
@@ -1016,13 +1137,13 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 		DataStackVariant& v1 = stack.Peek();
 		DataStackVariant& v2 = stack.Peek(1);
 
-		assert(std::holds_alternative<TInt32>(v1));
-		assert(std::holds_alternative<TInt32>(v2));
+		assert(v1.Is<TInt32>());
+		assert(v2.Is<TInt32>());
 
-		TInt32 val1 = std::get<DataStackVariantIndex::_TypeInt32>(v1);
+		TInt32 val1 = v1.AsInt32();
 		stack.Pop();
 
-		TInt32 val2 = std::get<DataStackVariantIndex::_TypeInt32>(v2);
+		TInt32 val2 = v2.AsInt32();
 		stack.Pop();
 
 		stack.Push(val1 ^ val2);
@@ -1032,17 +1153,17 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 	{
 		DataStackVariant& v = stack.Peek();
 
-		if (std::holds_alternative<TInt32>(v))
+		if (v.Is<TInt32>())
 		{
-			TInt32 i = std::get<DataStackVariantIndex::_TypeInt32>(v);
+			TInt32 i = v.AsInt32();
 			stack.Pop();
 			stack.Push(-i);
 			return InstructionErrorCode::None;
 		}
 
-		if (std::holds_alternative<TFloat>(v))
+		if (v.Is<TFloat>())
 		{
-			TFloat f = std::get<DataStackVariantIndex::_TypeFloat>(v);
+			TFloat f = v.AsFloat();
 			stack.Pop();
 			stack.Push(-f);
 			return InstructionErrorCode::None;
@@ -1053,65 +1174,63 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 	case VMInstruction::Not: // ~ Only ints
 	{
 		DataStackVariant& v = stack.Peek();
-		assert(std::holds_alternative<TInt32>(v));
-		TInt32 i = std::get<DataStackVariantIndex::_TypeInt32>(v);
+		assert(v.Is<TInt32>());
+		TInt32 i = v.AsInt32();
 		stack.Pop();
 		stack.Push(~i);
 		return InstructionErrorCode::None;
 	}
 	// Control flow
+	case VMInstruction::Add_i4:
+		ApplyInPlace<TInt32>(stack, std::plus<TInt32>{});
+		return InstructionErrorCode::None;
+	case VMInstruction::Add_r4:
+		ApplyInPlace<TFloat>(stack, std::plus<TFloat>{});
+		return InstructionErrorCode::None;
+	case VMInstruction::Sub_i4:
+		ApplyInPlace<TInt32>(stack, std::minus<TInt32>{});
+		return InstructionErrorCode::None;
+	case VMInstruction::Sub_r4:
+		ApplyInPlace<TFloat>(stack, std::minus<TFloat>{});
+		return InstructionErrorCode::None;
+	case VMInstruction::Mul_i4:
+		ApplyInPlace<TInt32>(stack, std::multiplies<TInt32>{});
+		return InstructionErrorCode::None;
+	case VMInstruction::Mul_r4:
+		ApplyInPlace<TFloat>(stack, std::multiplies<TFloat>{});
+		return InstructionErrorCode::None;
+	case VMInstruction::Div_i4:
+		return DivideInPlace<TInt32>(stack);
+	case VMInstruction::Div_r4:
+		return DivideInPlace<TFloat>(stack);
+	case VMInstruction::Ceq_i4:
+		ApplyInPlace<TInt32>(stack, CompareAs<std::equal_to<TInt32>>);
+		return InstructionErrorCode::None;
+	case VMInstruction::Clt_i4:
+		ApplyInPlace<TInt32>(stack, CompareAs<std::less<TInt32>>);
+		return InstructionErrorCode::None;
+	case VMInstruction::Cgt_i4:
+		ApplyInPlace<TInt32>(stack, CompareAs<std::greater<TInt32>>);
+		return InstructionErrorCode::None;
 	case VMInstruction::Clt:
 	{
-		DataStackVariant& second = stack.Peek();
-		DataStackVariant& first = stack.Peek(1);
-
-		assert(std::holds_alternative<TInt32>(first));
-		assert(std::holds_alternative<TInt32>(second));
-
-		TInt32 val1 = std::get<DataStackVariantIndex::_TypeInt32>(first);
-		stack.Pop();
-
-		TInt32 val2 = std::get<DataStackVariantIndex::_TypeInt32>(second);
-		stack.Pop();
-
-		if (val1 < val2)
-			stack.Push(1);
-		else
-			stack.Push(0);
-
-		return InstructionErrorCode::None;
+		return CompareInt32DataStackVariants(stack, std::less<TInt32>{});
 	}
 	case VMInstruction::Cgt:
 	{
-		DataStackVariant& second = stack.Peek();
-		DataStackVariant& first = stack.Peek(1);
-
-		assert(std::holds_alternative<TInt32>(first));
-		assert(std::holds_alternative<TInt32>(second));
-
-		TInt32 val1 = std::get<DataStackVariantIndex::_TypeInt32>(first);
-		stack.Pop();
-		TInt32 val2 = std::get<DataStackVariantIndex::_TypeInt32>(second);
-		stack.Pop();
-
-		if (val1 > val2)
-			stack.Push(1);
-		else
-			stack.Push(0);
-
-		return InstructionErrorCode::None;
+		return CompareInt32DataStackVariants(stack, std::greater<TInt32>{});
 	}
 	case VMInstruction::And:
 	{
 		DataStackVariant& second = stack.Peek();
 		DataStackVariant& first = stack.Peek(1);
 
-		assert(std::holds_alternative<TInt32>(first));
-		assert(std::holds_alternative<TInt32>(second));
+		assert(first.Is<TInt32>());
+		assert(second.Is<TInt32>());
 
-		TInt32 val1 = std::get<DataStackVariantIndex::_TypeInt32>(first);
+		TInt32 val1 = first.AsInt32();
 		stack.Pop();
-		TInt32 val2 = std::get<DataStackVariantIndex::_TypeInt32>(second);
+		TInt32 val2 = second.AsInt32();
 		stack.Pop();
 
 		stack.Push((int)(val1 && val2));
@@ -1122,12 +1241,12 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 		DataStackVariant& second = stack.Peek();
 		DataStackVariant& first = stack.Peek(1);
 
-		assert(std::holds_alternative<TInt32>(first));
-		assert(std::holds_alternative<TInt32>(second));
+		assert(first.Is<TInt32>());
+		assert(second.Is<TInt32>());
 
-		TInt32 val1 = std::get<DataStackVariantIndex::_TypeInt32>(first);
+		TInt32 val1 = first.AsInt32();
 		stack.Pop();
-		TInt32 val2 = std::get<DataStackVariantIndex::_TypeInt32>(second);
+		TInt32 val2 = second.AsInt32();
 		stack.Pop();
 
 		stack.Push((int)(val1 || val2));
@@ -1135,36 +1254,19 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 	}
 	case VMInstruction::Ceq:
 	{
-		DataStackVariant& second = stack.Peek();
-		DataStackVariant& first = stack.Peek(1);
-
-		assert(std::holds_alternative<TInt32>(first));
-		assert(std::holds_alternative<TInt32>(second));
-
-		TInt32 val1 = std::get<DataStackVariantIndex::_TypeInt32>(first);
-		stack.Pop();
-		TInt32 val2 = std::get<DataStackVariantIndex::_TypeInt32>(second);
-		stack.Pop();
-
-		if (val1 == val2)
-			stack.Push(1);
-		else
-			stack.Push(0);
-
-		return InstructionErrorCode::None;
+		return CompareInt32DataStackVariants(stack, std::equal_to<TInt32>{});
 	}
 	case VMInstruction::BrFalse:
 	{
 		// Assert target label number
 		DataStackVariant& val = stack.Peek();
-		assert(std::holds_alternative<TInt32>(val));
-		TInt32 i = std::get<DataStackVariantIndex::_TypeInt32>(val);
+		assert(val.Is<TInt32>());
+		TInt32 i = val.AsInt32();
 		stack.Pop();
 
 		if (i == 0)
 		{
-			assert(std::holds_alternative<TInt32>(args[0]));
-			TInt32 jmpLabel = std::get<DataStackVariantIndex::_TypeInt32>(args[0]);
+			TInt32 jmpLabel = instruction.A.Int;
 
 			context->SetNextInstruction(jmpLabel);
 		}
@@ -1175,14 +1277,13 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 	{
 		// Assert target label number
 		DataStackVariant& val = stack.Peek();
-		assert(std::holds_alternative<TInt32>(val));
-		TInt32 i = std::get<DataStackVariantIndex::_TypeInt32>(val);
+		assert(val.Is<TInt32>());
+		TInt32 i = val.AsInt32();
 		stack.Pop();
 
 		if (i == 1)
 		{
-			assert(std::holds_alternative<TInt32>(args[0]));
-			TInt32 jmpLabel = std::get<DataStackVariantIndex::_TypeInt32>(args[0]);
+			TInt32 jmpLabel = instruction.A.Int;
 
 			context->SetNextInstruction(jmpLabel);
 		}
@@ -1192,15 +1293,13 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 	case VMInstruction::Br:
 	{
 		// Assert target label number
-		assert(std::holds_alternative<TInt32>(args[0]));
-		TInt32 jmpLabel = std::get<DataStackVariantIndex::_TypeInt32>(args[0]);
+		TInt32 jmpLabel = instruction.A.Int;
 		context->SetNextInstruction(jmpLabel);
 		return InstructionErrorCode::None;
 	}
 	case VMInstruction::ConvType:
 	{
-		assert(std::holds_alternative<TInt32>(args[0]) || std::holds_alternative<TFloat>(args[0]));
-		TInt32 targetType = std::get<DataStackVariantIndex::_TypeInt32>(args[0]);
+		TInt32 targetType = instruction.A.Int;
 
 		DataStackVariant& prevValue = stack.Peek();
 
@@ -1230,12 +1329,9 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 	}
 	case VMInstruction::NewArr:
 	{
-		assert(args.size() == 1 || // Alloc a primitive type
-			args.size() == 2 || // Alloc an object and object name
-			args.size() == 3); // Alloc an object, namespace and object name
-
-		DataStackVariantIndex typeIndex = (DataStackVariantIndex)std::get<DataStackVariantIndex::_TypeInt32>(args[0]);
-		if (args.size() == 1)
+		// Objects arrays also carry the object name (and optionally its namespace)
+		DataStackVariantIndex typeIndex = (DataStackVariantIndex)instruction.A.Int;
+		if (instruction.C.String == InvalidStringId)
 		{
 			TArray newArr = interpreter->m_Memory.AllocArray(typeIndex);
 			context->Stack().Push({ newArr });
@@ -1246,15 +1342,15 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 	}
 	case VMInstruction::LdElem:
 	{
-		assert(args.size() == 0);
 		DataStackVariant indexVariant = context->Stack().Peek();
 		context->Stack().Pop();
 
-		const TInt32 index = std::get<DataStackVariantIndex::_TypeInt32>(indexVariant);
-		TGCObject& obj = std::get<_TypeObject>(context->Stack().Peek());
+		const TInt32 index = indexVariant.AsInt32();
+		// Collections only run on allocations, the array stays valid once popped
+		IGCObject* obj = context->Stack().Peek().AsObject();
 
 		CHECK_GC_OBJECT_IS_ARRAY(obj);
-		VariantArray* array = (VariantArray*)obj.get();
+		VariantArray* array = (VariantArray*)obj;
 		DataStackVariant& value = (*array)[index];
 
 		context->Stack().Pop();
@@ -1268,3 +1364,866 @@ InstructionErrorCode nebula::ExecuteInstruction(VMInstruction opcode, Interprete
 	std::cerr << "Unknown opcode or aguments not valid during execution!\n   " << itos(opcode) << "\n";
 	throw std::exception("Unknown opcode or aguments not valid during execution");
 }
+
+// GCC and Clang can jump straight from one instruction handler to the next one,
+// every other compiler goes through the switch at the top of the loop
+#if defined(__GNUC__) || defined(__clang__)
+#define NEBULA_COMPUTED_GOTO 1
+#else
+#define NEBULA_COMPUTED_GOTO 0
+#endif
+
+// Fetch the next instruction, the batch ends once the budget is consumed
+#define NEBULA_BATCH_FETCH()																				\
+	{																										\
+		if (budget == 0)																					\
+			return Frame::Status::Running;																	\
+		budget--;																							\
+		instruction = &instructions[ip++];																	\
+		/* Verified code can't run past its last instruction */												\
+		if constexpr (!TVerified)																			\
+		{																									\
+			[[unlikely]]																					\
+			if (ip >= instructionCount && instruction->Opcode != VMInstruction::Ret && instruction->Opcode != VMInstruction::Br) \
+				return Frame::Status::FatalError;															\
+		}																									\
+	}
+
+#if NEBULA_COMPUTED_GOTO
+#define NEBULA_TARGET(op) L_##op:
+#define NEBULA_TARGET_DEFAULT L_Generic:
+#define NEBULA_DISPATCH() { NEBULA_BATCH_FETCH(); goto *s_DispatchTable[(size_t)instruction->Opcode]; }
+#else
+#define NEBULA_TARGET(op) case VMInstruction::op:
+#define NEBULA_TARGET_DEFAULT default:
+#define NEBULA_DISPATCH() continue
+#endif
+
+#define NEBULA_CHECK_ERROR(expr) { error = (expr); if (error != InstructionErrorCode::None) goto fatal_error; }
+
+// Verified functions (see ScriptVerifier) only hold operands of the expected type and indices in range,
+// their instantiation skips the bounds and type checks
+template<bool TVerified>
+Frame::Status nebula::ExecuteBatch(Interpreter* interpreter, Frame* context, size_t& budget)
+{
+	const LinkedCode& code = context->GetFunction()->Code();
+	const LinkedInstruction* instructions = code.Data();
+	[[maybe_unused]] const size_t instructionCount = code.Size();
+	size_t& ip = context->m_NextInstructionIndex;
+
+	DataStack& stack = context->Stack();
+	FrameMemory& memory = context->Memory();
+
+	const LinkedInstruction* instruction{ nullptr };
+	InstructionErrorCode error{ InstructionErrorCode::None };
+
+#if NEBULA_COMPUTED_GOTO
+	// Must follow the declaration order of VMInstruction
+	static void* const s_DispatchTable[] = {
+		&&L_Nop,		// Nop
+		&&L_Pop,		// Pop
+		&&L_Dup,		// Dup
+		&&L_Call,		// Call
+		&&L_Generic,	// CallVirt
+		&&L_Generic,	// ConvType
+		&&L_Generic,	// ChkDef
+		&&L_Ret,		// Ret
+		&&L_Br,			// Br
+		&&L_BrTrue,		// BrTrue
+		&&L_BrFalse,	// BrFalse
+		&&L_Ceq,		// Ceq
+		&&L_Generic,	// Neg
+		&&L_Generic,	// Not
+		&&L_Generic,	// And
+		&&L_Generic,	// Or
+		&&L_Generic,	// Xor
+		&&L_Clt,		// Clt
+		&&L_Cgt,		// Cgt
+		&&L_Call_t,		// Call_t
+		&&L_Wait,		// Wait
+		&&L_Wait_n,		// Wait_n
+		&&L_Generic,	// Endon
+		&&L_Notify,		// Notify
+		&&L_Add,		// Add
+		&&L_Sub,		// Sub
+		&&L_Mul,		// Mul
+		&&L_Div,		// Div
+		&&L_Generic,	// Rem
+		&&L_Generic,	// AddStr
+		&&L_Generic,	// LdNull
+		&&L_Ldc_i4_0,	// Ldc_i4_0
+		&&L_Ldc_i4_1,	// Ldc_i4_1
+		&&L_Ldc_i4_2,	// Ldc_i4_2
+		&&L_Ldc_i4_3,	// Ldc_i4_3
+		&&L_Ldc_i4_4,	// Ldc_i4_4
+		&&L_Ldc_i4_5,	// Ldc_i4_5
+		&&L_Ldc_i4_6,	// Ldc_i4_6
+		&&L_Ldc_i4_7,	// Ldc_i4_7
+		&&L_Ldc_i4_8,	// Ldc_i4_8
+		&&L_Ldc_i4_9,	// Ldc_i4_9
+		&&L_Ldc_i4,		// Ldc_i4
+		&&L_Ldc_r4,		// Ldc_r4
+		&&L_Ldc_s,		// Ldc_s
+		&&L_Generic,	// Newobj
+		&&L_Generic,	// NewArr
+		&&L_Ldarg,		// Ldarg
+		&&L_Ldloc,		// Ldloc
+		&&L_Generic,	// LdElem
+		&&L_Generic,	// LdFld
+		&&L_Generic,	// LdSfld
+		&&L_Stloc,		// Stloc
+		&&L_Generic,	// StArg
+		&&L_Generic,	// StElem
+		&&L_Generic,	// StFld
+		&&L_Generic,	// StsFld
+		&&L_Add_i4,		// Add_i4
+		&&L_Add_r4,		// Add_r4
+		&&L_Sub_i4,		// Sub_i4
+		&&L_Sub_r4,		// Sub_r4
+		&&L_Mul_i4,		// Mul_i4
+		&&L_Mul_r4,		// Mul_r4
+		&&L_Div_i4,		// Div_i4
+		&&L_Div_r4,		// Div_r4
+		&&L_Ceq_i4,		// Ceq_i4
+		&&L_Clt_i4,		// Clt_i4
+		&&L_Cgt_i4,		// Cgt_i4
+		&&L_Ldloc2,			// Ldloc2
+		&&L_LdlocAddC_i4,	// LdlocAddC_i4
+		&&L_LdargAddC_i4,	// LdargAddC_i4
+		&&L_IncLoc_i4,		// IncLoc_i4
+		&&L_BrLocLt_i4,		// BrLocLt_i4
+		&&L_BrLocGe_i4,		// BrLocGe_i4
+		&&L_BrLocGt_i4,		// BrLocGt_i4
+		&&L_BrLocLe_i4,		// BrLocLe_i4
+		&&L_BrLocEq_i4,		// BrLocEq_i4
+		&&L_BrLocNe_i4,		// BrLocNe_i4
+		&&L_BrLocLtC_i4,	// BrLocLtC_i4
+		&&L_BrLocGeC_i4,	// BrLocGeC_i4
+		&&L_BrLocGtC_i4,	// BrLocGtC_i4
+		&&L_BrLocLeC_i4,	// BrLocLeC_i4
+		&&L_BrLocEqC_i4,	// BrLocEqC_i4
+		&&L_BrLocNeC_i4,	// BrLocNeC_i4
+	};
+	static_assert(sizeof(s_DispatchTable) / sizeof(s_DispatchTable[0]) == (size_t)VMInstruction::LastInstruction,
+		"Dispatch table is out of sync with VMInstruction");
+
+	NEBULA_DISPATCH();
+#else
+	for (;;)
+	{
+		NEBULA_BATCH_FETCH();
+		switch (instruction->Opcode)
+		{
+#endif
+		NEBULA_TARGET(Nop)
+		{
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Pop)
+		{
+			stack.Pop();
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Dup)
+		{
+			stack.Dup();
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Ldc_i4_0)
+		NEBULA_TARGET(Ldc_i4_1)
+		NEBULA_TARGET(Ldc_i4_2)
+		NEBULA_TARGET(Ldc_i4_3)
+		NEBULA_TARGET(Ldc_i4_4)
+		NEBULA_TARGET(Ldc_i4_5)
+		NEBULA_TARGET(Ldc_i4_6)
+		NEBULA_TARGET(Ldc_i4_7)
+		NEBULA_TARGET(Ldc_i4_8)
+		NEBULA_TARGET(Ldc_i4_9)
+		{
+			stack.Push((TInt32)instruction->Opcode - (TInt32)VMInstruction::Ldc_i4_0);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Ldc_i4)
+		{
+			stack.Push(instruction->A.Int);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Ldc_r4)
+		{
+			stack.Push(instruction->A.Float);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Ldc_s)
+		{
+			stack.Push(code.SharedStringAt(instruction->A.String));
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Ldloc)
+		{
+			if constexpr (TVerified)
+			{
+				stack.Push(memory.UncheckedLocalAt(instruction->A.Int).Value());
+			}
+			else
+			{
+				stack.Push(memory.LocalAt(instruction->A.Int).Value());
+			}
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Ldarg)
+		{
+			if constexpr (TVerified)
+			{
+				stack.Push(memory.UncheckedParamAt(instruction->A.Int).Value());
+			}
+			else
+			{
+				stack.Push(memory.ParamAt(instruction->A.Int).Value());
+			}
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Stloc)
+		{
+			if constexpr (TVerified)
+			{
+				memory.UncheckedLocalAt(instruction->A.Int).Value() = std::move(stack.Peek());
+				stack.Pop();
+			}
+			else
+			{
+				bool typeMatches = memory.LocalAt(instruction->A.Int).SetValue(stack.Peek());
+				stack.Pop();
+				// Types don't match
+				NEBULA_CHECK_ERROR(typeMatches ? InstructionErrorCode::None : InstructionErrorCode::Fatal);
+			}
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Add)
+		{
+			NEBULA_CHECK_ERROR(SumDataStackVariants(stack));
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Sub)
+		{
+			NEBULA_CHECK_ERROR(SubDataStackVariants(stack));
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Mul)
+		{
+			NEBULA_CHECK_ERROR(MulDataStackVariants(stack));
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Div)
+		{
+			NEBULA_CHECK_ERROR(DivDataStackVariants(stack));
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Clt)
+		{
+			NEBULA_CHECK_ERROR(CompareInt32DataStackVariants(stack, std::less<TInt32>{}));
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Cgt)
+		{
+			NEBULA_CHECK_ERROR(CompareInt32DataStackVariants(stack, std::greater<TInt32>{}));
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Ceq)
+		{
+			NEBULA_CHECK_ERROR(CompareInt32DataStackVariants(stack, std::equal_to<TInt32>{}));
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Add_i4)
+		{
+			ApplyInPlace<TInt32>(stack, std::plus<TInt32>{});
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Add_r4)
+		{
+			ApplyInPlace<TFloat>(stack, std::plus<TFloat>{});
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Sub_i4)
+		{
+			ApplyInPlace<TInt32>(stack, std::minus<TInt32>{});
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Sub_r4)
+		{
+			ApplyInPlace<TFloat>(stack, std::minus<TFloat>{});
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Mul_i4)
+		{
+			ApplyInPlace<TInt32>(stack, std::multiplies<TInt32>{});
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Mul_r4)
+		{
+			ApplyInPlace<TFloat>(stack, std::multiplies<TFloat>{});
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Div_i4)
+		{
+			NEBULA_CHECK_ERROR(DivideInPlace<TInt32>(stack));
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Div_r4)
+		{
+			NEBULA_CHECK_ERROR(DivideInPlace<TFloat>(stack));
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Ceq_i4)
+		{
+			ApplyInPlace<TInt32>(stack, CompareAs<std::equal_to<TInt32>>);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Clt_i4)
+		{
+			ApplyInPlace<TInt32>(stack, CompareAs<std::less<TInt32>>);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Cgt_i4)
+		{
+			ApplyInPlace<TInt32>(stack, CompareAs<std::greater<TInt32>>);
+			NEBULA_DISPATCH();
+		}
+		// Superinstructions, ip is moved past the rest of the sequence they replace (see LinkedCode::FuseSuperinstructions)
+		NEBULA_TARGET(Ldloc2)
+		{
+			stack.Push(LocalAt<TVerified>(memory, instruction->A.Int).Value());
+			stack.Push(LocalAt<TVerified>(memory, instruction->B.Int).Value());
+			ip += 1;
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(LdlocAddC_i4)
+		{
+			TInt32 value = LocalAt<TVerified>(memory, instruction->A.Int).Value().AsInt32();
+			stack.Push(value + instruction->B.Int);
+			ip += 2;
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(LdargAddC_i4)
+		{
+			TInt32 value = ParamAt<TVerified>(memory, instruction->A.Int).Value().AsInt32();
+			stack.Push(value + instruction->B.Int);
+			ip += 2;
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(IncLoc_i4)
+		{
+			DataStackVariant value{ LocalAt<TVerified>(memory, instruction->A.Int).Value().AsInt32() + instruction->B.Int };
+			if constexpr (TVerified)
+			{
+				memory.UncheckedLocalAt(instruction->C.Int).Value() = std::move(value);
+			}
+			else
+			{
+				bool typeMatches = memory.LocalAt(instruction->C.Int).SetValue(value);
+				// Types don't match
+				NEBULA_CHECK_ERROR(typeMatches ? InstructionErrorCode::None : InstructionErrorCode::Fatal);
+			}
+			ip += 3;
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(BrLocLt_i4)
+		{
+			TInt32 a = LocalAt<TVerified>(memory, instruction->A.Int).Value().AsInt32();
+			TInt32 b = LocalAt<TVerified>(memory, instruction->B.Int).Value().AsInt32();
+			BranchIf<TVerified, std::less<TInt32>>(context, ip, *instruction, a, b);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(BrLocLtC_i4)
+		{
+			TInt32 a = LocalAt<TVerified>(memory, instruction->A.Int).Value().AsInt32();
+			BranchIf<TVerified, std::less<TInt32>>(context, ip, *instruction, a, instruction->B.Int);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(BrLocGe_i4)
+		{
+			TInt32 a = LocalAt<TVerified>(memory, instruction->A.Int).Value().AsInt32();
+			TInt32 b = LocalAt<TVerified>(memory, instruction->B.Int).Value().AsInt32();
+			BranchIf<TVerified, std::greater_equal<TInt32>>(context, ip, *instruction, a, b);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(BrLocGeC_i4)
+		{
+			TInt32 a = LocalAt<TVerified>(memory, instruction->A.Int).Value().AsInt32();
+			BranchIf<TVerified, std::greater_equal<TInt32>>(context, ip, *instruction, a, instruction->B.Int);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(BrLocGt_i4)
+		{
+			TInt32 a = LocalAt<TVerified>(memory, instruction->A.Int).Value().AsInt32();
+			TInt32 b = LocalAt<TVerified>(memory, instruction->B.Int).Value().AsInt32();
+			BranchIf<TVerified, std::greater<TInt32>>(context, ip, *instruction, a, b);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(BrLocGtC_i4)
+		{
+			TInt32 a = LocalAt<TVerified>(memory, instruction->A.Int).Value().AsInt32();
+			BranchIf<TVerified, std::greater<TInt32>>(context, ip, *instruction, a, instruction->B.Int);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(BrLocLe_i4)
+		{
+			TInt32 a = LocalAt<TVerified>(memory, instruction->A.Int).Value().AsInt32();
+			TInt32 b = LocalAt<TVerified>(memory, instruction->B.Int).Value().AsInt32();
+			BranchIf<TVerified, std::less_equal<TInt32>>(context, ip, *instruction, a, b);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(BrLocLeC_i4)
+		{
+			TInt32 a = LocalAt<TVerified>(memory, instruction->A.Int).Value().AsInt32();
+			BranchIf<TVerified, std::less_equal<TInt32>>(context, ip, *instruction, a, instruction->B.Int);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(BrLocEq_i4)
+		{
+			TInt32 a = LocalAt<TVerified>(memory, instruction->A.Int).Value().AsInt32();
+			TInt32 b = LocalAt<TVerified>(memory, instruction->B.Int).Value().AsInt32();
+			BranchIf<TVerified, std::equal_to<TInt32>>(context, ip, *instruction, a, b);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(BrLocEqC_i4)
+		{
+			TInt32 a = LocalAt<TVerified>(memory, instruction->A.Int).Value().AsInt32();
+			BranchIf<TVerified, std::equal_to<TInt32>>(context, ip, *instruction, a, instruction->B.Int);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(BrLocNe_i4)
+		{
+			TInt32 a = LocalAt<TVerified>(memory, instruction->A.Int).Value().AsInt32();
+			TInt32 b = LocalAt<TVerified>(memory, instruction->B.Int).Value().AsInt32();
+			BranchIf<TVerified, std::not_equal_to<TInt32>>(context, ip, *instruction, a, b);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(BrLocNeC_i4)
+		{
+			TInt32 a = LocalAt<TVerified>(memory, instruction->A.Int).Value().AsInt32();
+			BranchIf<TVerified, std::not_equal_to<TInt32>>(context, ip, *instruction, a, instruction->B.Int);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Br)
+		{
+			JumpTo<TVerified>(context, ip, instruction->A.Int);
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(BrTrue)
+		{
+			assert(stack.Peek().Is<TInt32>());
+			TInt32 condition = stack.Peek().AsInt32();
+			stack.Pop();
+
+			if (condition == 1)
+			{
+				JumpTo<TVerified>(context, ip, instruction->A.Int);
+			}
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(BrFalse)
+		{
+			assert(stack.Peek().Is<TInt32>());
+			TInt32 condition = stack.Peek().AsInt32();
+			stack.Pop();
+
+			if (condition == 0)
+			{
+				JumpTo<TVerified>(context, ip, instruction->A.Int);
+			}
+			NEBULA_DISPATCH();
+		}
+		NEBULA_TARGET(Call)
+		NEBULA_TARGET(Call_t)
+		{
+			NEBULA_CHECK_ERROR(ExecuteInstruction(*instruction, interpreter, context));
+
+			// Native functions run inline and don't change the callstack, keep going
+			if (code.CallSiteAt(instruction->C.Int).Target == nullptr)
+			{
+				NEBULA_DISPATCH();
+			}
+
+			return Frame::Status::Running;
+		}
+		NEBULA_TARGET(Ret)
+		{
+			NEBULA_CHECK_ERROR(ExecuteInstruction(*instruction, interpreter, context));
+			return Frame::Status::Finished;
+		}
+		NEBULA_TARGET(Wait)
+		NEBULA_TARGET(Wait_n)
+		NEBULA_TARGET(Notify)
+		{
+			// Give back control to the scheduler, this frame (or another one) might have been paused or killed
+			NEBULA_CHECK_ERROR(ExecuteInstruction(*instruction, interpreter, context));
+			return Frame::Status::Running;
+		}
+		NEBULA_TARGET_DEFAULT
+		{
+			NEBULA_CHECK_ERROR(ExecuteInstruction(*instruction, interpreter, context));
+			NEBULA_DISPATCH();
+		}
+#if !NEBULA_COMPUTED_GOTO
+		}
+	}
+#endif
+
+fatal_error:
+	context->m_LastErrorCode = error;
+	return Frame::Status::FatalError;
+}
+
+Frame::Status nebula::ExecuteBatch(Interpreter* interpreter, Frame* context, size_t& budget)
+{
+	const Function* function = context->GetFunction();
+	if (function->IsVerified())
+	{
+		// The register tier relies on the verified types and stack heights
+		const RegisterCode* registers = function->RegisterTier();
+
+		// Frames left the register tier in the middle of a block finish it on the stack engine
+		if (registers != nullptr && registers->EntryAt(context->m_NextInstructionIndex) >= 0)
+			return ExecuteRegisterBatch(interpreter, context, *registers, budget);
+
+		return ExecuteBatch<true>(interpreter, context, budget);
+	}
+
+	return ExecuteBatch<false>(interpreter, context, budget);
+}
+
+static inline DataStackVariant& RegisterAt(std::byte* frame, TInt32 offset)
+{
+	return *reinterpret_cast<DataStackVariant*>(frame + offset);
+}
+
+// Registers only hold ints and floats, results are constructed over the previous value without destroying it
+template<typename TValue>
+static inline void SetRegister(std::byte* frame, TInt32 offset, TValue value)
+{
+	::new (&RegisterAt(frame, offset)) DataStackVariant(value);
+}
+
+template<typename TValue, typename TOperation>
+static inline void ApplyToRegisters(std::byte* frame, const RegisterInstruction& instruction, TOperation operation)
+{
+	TValue a = ValueAs<TValue>(RegisterAt(frame, instruction.A.Int));
+	TValue b = ValueAs<TValue>(RegisterAt(frame, instruction.B.Int));
+	SetRegister(frame, instruction.Dst, operation(a, b));
+}
+
+template<typename TOperation>
+static inline void ApplyToRegisterAndConstant(std::byte* frame, const RegisterInstruction& instruction, TOperation operation)
+{
+	TInt32 a = RegisterAt(frame, instruction.A.Int).AsInt32();
+	SetRegister(frame, instruction.Dst, operation(a, instruction.B.Int));
+}
+
+template<typename TValue>
+static inline InstructionErrorCode DivideRegisters(std::byte* frame, const RegisterInstruction& instruction)
+{
+	[[unlikely]]
+	if (ValueAs<TValue>(RegisterAt(frame, instruction.B.Int)) == 0)
+		return InstructionErrorCode::DivideByZero;
+
+	ApplyToRegisters<TValue>(frame, instruction, std::divides<TValue>{});
+	return InstructionErrorCode::None;
+}
+
+template<typename TCompare>
+static inline bool CompareRegisters(std::byte* frame, const RegisterInstruction& instruction)
+{
+	return TCompare{}(RegisterAt(frame, instruction.A.Int).AsInt32(), RegisterAt(frame, instruction.B.Int).AsInt32());
+}
+
+template<typename TCompare>
+static inline bool CompareRegisterAndConstant(std::byte* frame, const RegisterInstruction& instruction)
+{
+	return TCompare{}(RegisterAt(frame, instruction.A.Int).AsInt32(), instruction.B.Int);
+}
+
+#if NEBULA_COMPUTED_GOTO
+#define NEBULA_REGISTER_TARGET(op) R_##op:
+#define NEBULA_REGISTER_DISPATCH() goto *s_DispatchTable[(size_t)instruction->Opcode]
+#else
+#define NEBULA_REGISTER_TARGET(op) case RegisterOp::op:
+#define NEBULA_REGISTER_DISPATCH() continue
+#endif
+
+#define NEBULA_REGISTER_NEXT() { instruction++; NEBULA_REGISTER_DISPATCH(); }
+
+// Fallbacks and branches account for the instructions run since the previous one
+#define NEBULA_REGISTER_CHARGE() { remaining = remaining > (size_t)instruction->Cost ? remaining - instruction->Cost : 0; }
+
+// The operand stack is in sync once branched, the frame can leave the register tier
+#define NEBULA_REGISTER_BRANCH(condition)													\
+	{																						\
+		NEBULA_REGISTER_CHARGE();															\
+		if (!(condition))																	\
+			NEBULA_REGISTER_NEXT();															\
+																							\
+		if (remaining == 0)																	\
+		{																					\
+			stack.SetSizeUnchecked(instruction->Depth);										\
+			ip = (size_t)instruction->Dst;													\
+			budget = 0;																		\
+			return Frame::Status::Running;													\
+		}																					\
+																							\
+		instruction = instructions + instruction->Target;									\
+		NEBULA_REGISTER_DISPATCH();															\
+	}
+
+#define NEBULA_REGISTER_CHECK_ERROR(expr) { error = (expr); if (error != InstructionErrorCode::None) goto fatal_error; }
+
+Frame::Status nebula::ExecuteRegisterBatch(Interpreter* interpreter, Frame* context, const RegisterCode& registers, size_t& budget)
+{
+	const LinkedCode& code = context->GetFunction()->Code();
+	const RegisterInstruction* instructions = registers.Data();
+	size_t& ip = context->m_NextInstructionIndex;
+
+	DataStack& stack = context->Stack();
+	std::byte* frame = reinterpret_cast<std::byte*>(context);
+
+	const RegisterInstruction* instruction = instructions + registers.EntryAt(ip);
+	size_t remaining = budget;
+	InstructionErrorCode error{ InstructionErrorCode::None };
+
+#if NEBULA_COMPUTED_GOTO
+	// Must follow the declaration order of RegisterOp
+	static void* const s_DispatchTable[] = {
+		&&R_Fallback,
+		&&R_Mov,
+		&&R_LdcI,
+		&&R_LdcF,
+		&&R_AddI,
+		&&R_AddIC,
+		&&R_SubI,
+		&&R_MulI,
+		&&R_MulIC,
+		&&R_DivI,
+		&&R_AddF,
+		&&R_SubF,
+		&&R_MulF,
+		&&R_DivF,
+		&&R_CeqI,
+		&&R_CeqIC,
+		&&R_CltI,
+		&&R_CltIC,
+		&&R_CgtI,
+		&&R_CgtIC,
+		&&R_Br,
+		&&R_BrTrue,
+		&&R_BrFalse,
+		&&R_BrLtI,
+		&&R_BrLtIC,
+		&&R_BrGeI,
+		&&R_BrGeIC,
+		&&R_BrGtI,
+		&&R_BrGtIC,
+		&&R_BrLeI,
+		&&R_BrLeIC,
+		&&R_BrEqI,
+		&&R_BrEqIC,
+		&&R_BrNeI,
+		&&R_BrNeIC,
+	};
+	static_assert(sizeof(s_DispatchTable) / sizeof(s_DispatchTable[0]) == (size_t)RegisterOp::LastOp,
+		"Dispatch table is out of sync with RegisterOp");
+
+	NEBULA_REGISTER_DISPATCH();
+#else
+	for (;;)
+	{
+		switch (instruction->Opcode)
+		{
+#endif
+		NEBULA_REGISTER_TARGET(Fallback)
+		{
+			const LinkedInstruction& linked = code[instruction->Ip];
+			stack.SetSizeUnchecked(instruction->Depth);
+			ip = (size_t)instruction->Ip + 1;
+			NEBULA_REGISTER_CHARGE();
+			NEBULA_REGISTER_CHECK_ERROR(ExecuteInstruction(linked, interpreter, context));
+
+			budget = remaining;
+			switch (linked.Opcode)
+			{
+			case VMInstruction::Ret:
+				return Frame::Status::Finished;
+			case VMInstruction::Call:
+			case VMInstruction::Call_t:
+				// Native functions run inline and don't change the callstack, keep going
+				if (code.CallSiteAt(linked.C.Int).Target != nullptr)
+					return Frame::Status::Running;
+				break;
+			case VMInstruction::Wait:
+			case VMInstruction::Wait_n:
+			case VMInstruction::Notify:
+				// Give back control to the scheduler, this frame (or another one) might have been paused or killed
+				return Frame::Status::Running;
+			default:
+				break;
+			}
+
+			if (remaining == 0)
+				return Frame::Status::Running;
+
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(Mov)
+		{
+			::new (&RegisterAt(frame, instruction->Dst)) DataStackVariant(RegisterAt(frame, instruction->A.Int));
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(LdcI)
+		{
+			SetRegister(frame, instruction->Dst, instruction->A.Int);
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(LdcF)
+		{
+			SetRegister(frame, instruction->Dst, instruction->A.Float);
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(AddI)
+		{
+			ApplyToRegisters<TInt32>(frame, *instruction, std::plus<TInt32>{});
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(AddIC)
+		{
+			ApplyToRegisterAndConstant(frame, *instruction, std::plus<TInt32>{});
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(SubI)
+		{
+			ApplyToRegisters<TInt32>(frame, *instruction, std::minus<TInt32>{});
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(MulI)
+		{
+			ApplyToRegisters<TInt32>(frame, *instruction, std::multiplies<TInt32>{});
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(MulIC)
+		{
+			ApplyToRegisterAndConstant(frame, *instruction, std::multiplies<TInt32>{});
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(DivI)
+		{
+			NEBULA_REGISTER_CHECK_ERROR(DivideRegisters<TInt32>(frame, *instruction));
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(AddF)
+		{
+			ApplyToRegisters<TFloat>(frame, *instruction, std::plus<TFloat>{});
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(SubF)
+		{
+			ApplyToRegisters<TFloat>(frame, *instruction, std::minus<TFloat>{});
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(MulF)
+		{
+			ApplyToRegisters<TFloat>(frame, *instruction, std::multiplies<TFloat>{});
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(DivF)
+		{
+			NEBULA_REGISTER_CHECK_ERROR(DivideRegisters<TFloat>(frame, *instruction));
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(CeqI)
+		{
+			ApplyToRegisters<TInt32>(frame, *instruction, CompareAs<std::equal_to<TInt32>>);
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(CeqIC)
+		{
+			ApplyToRegisterAndConstant(frame, *instruction, CompareAs<std::equal_to<TInt32>>);
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(CltI)
+		{
+			ApplyToRegisters<TInt32>(frame, *instruction, CompareAs<std::less<TInt32>>);
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(CltIC)
+		{
+			ApplyToRegisterAndConstant(frame, *instruction, CompareAs<std::less<TInt32>>);
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(CgtI)
+		{
+			ApplyToRegisters<TInt32>(frame, *instruction, CompareAs<std::greater<TInt32>>);
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(CgtIC)
+		{
+			ApplyToRegisterAndConstant(frame, *instruction, CompareAs<std::greater<TInt32>>);
+			NEBULA_REGISTER_NEXT();
+		}
+		NEBULA_REGISTER_TARGET(Br)
+			NEBULA_REGISTER_BRANCH(true)
+		NEBULA_REGISTER_TARGET(BrTrue)
+			NEBULA_REGISTER_BRANCH(RegisterAt(frame, instruction->A.Int).AsInt32() == 1)
+		NEBULA_REGISTER_TARGET(BrFalse)
+			NEBULA_REGISTER_BRANCH(RegisterAt(frame, instruction->A.Int).AsInt32() == 0)
+		NEBULA_REGISTER_TARGET(BrLtI)
+			NEBULA_REGISTER_BRANCH(CompareRegisters<std::less<TInt32>>(frame, *instruction))
+		NEBULA_REGISTER_TARGET(BrLtIC)
+			NEBULA_REGISTER_BRANCH(CompareRegisterAndConstant<std::less<TInt32>>(frame, *instruction))
+		NEBULA_REGISTER_TARGET(BrGeI)
+			NEBULA_REGISTER_BRANCH(CompareRegisters<std::greater_equal<TInt32>>(frame, *instruction))
+		NEBULA_REGISTER_TARGET(BrGeIC)
+			NEBULA_REGISTER_BRANCH(CompareRegisterAndConstant<std::greater_equal<TInt32>>(frame, *instruction))
+		NEBULA_REGISTER_TARGET(BrGtI)
+			NEBULA_REGISTER_BRANCH(CompareRegisters<std::greater<TInt32>>(frame, *instruction))
+		NEBULA_REGISTER_TARGET(BrGtIC)
+			NEBULA_REGISTER_BRANCH(CompareRegisterAndConstant<std::greater<TInt32>>(frame, *instruction))
+		NEBULA_REGISTER_TARGET(BrLeI)
+			NEBULA_REGISTER_BRANCH(CompareRegisters<std::less_equal<TInt32>>(frame, *instruction))
+		NEBULA_REGISTER_TARGET(BrLeIC)
+			NEBULA_REGISTER_BRANCH(CompareRegisterAndConstant<std::less_equal<TInt32>>(frame, *instruction))
+		NEBULA_REGISTER_TARGET(BrEqI)
+			NEBULA_REGISTER_BRANCH(CompareRegisters<std::equal_to<TInt32>>(frame, *instruction))
+		NEBULA_REGISTER_TARGET(BrEqIC)
+			NEBULA_REGISTER_BRANCH(CompareRegisterAndConstant<std::equal_to<TInt32>>(frame, *instruction))
+		NEBULA_REGISTER_TARGET(BrNeI)
+			NEBULA_REGISTER_BRANCH(CompareRegisters<std::not_equal_to<TInt32>>(frame, *instruction))
+		NEBULA_REGISTER_TARGET(BrNeIC)
+			NEBULA_REGISTER_BRANCH(CompareRegisterAndConstant<std::not_equal_to<TInt32>>(frame, *instruction))
+#if !NEBULA_COMPUTED_GOTO
+		default:
+			assert(false && "Unknown register opcode");
+			break;
+		}
+	}
+#endif
+
+fatal_error:
+	// Errors are reported on the linked instruction that raised them
+	if (instruction->Opcode != RegisterOp::Fallback)
+	{
+		ip = (size_t)instruction->Ip + 1;
+	}
+
+	budget = remaining;
+	context->m_LastErrorCode = error;
+	return Frame::Status::FatalError;
+}
+
+#undef NEBULA_REGISTER_CHECK_ERROR
+#undef NEBULA_REGISTER_BRANCH
+#undef NEBULA_REGISTER_CHARGE
+#undef NEBULA_REGISTER_NEXT
+#undef NEBULA_REGISTER_DISPATCH
+#undef NEBULA_REGISTER_TARGET
+#undef NEBULA_CHECK_ERROR
+#undef NEBULA_DISPATCH
+#undef NEBULA_TARGET_DEFAULT
+#undef NEBULA_TARGET
+#undef NEBULA_BATCH_FETCH
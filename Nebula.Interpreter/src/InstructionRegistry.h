@@ -3,6 +3,9 @@
 #include "LanguageTypes.h"
 #include "InstructionDefs.h"
 #include "Instruction.h"
+#include "LinkedCode.h"
+#include "RegisterCode.h"
+#include "Frame.h"
 
 namespace nebula
 {
@@ -13,6 +16,14 @@ namespace nebula
 namespace nebula
 {
     InstructionArguments	GenerateArgumentsForOpcode(VMInstruction, const RawArguments&);
-    InstructionErrorCode	ExecuteInstruction(VMInstruction, Interpreter*, Frame*, const InstructionArguments&);
+    InstructionErrorCode	ExecuteInstruction(const LinkedInstruction&, Interpreter*, Frame*);
+
+    // Runs instructions of the frame until it calls, returns, yields or the budget runs out
+    Frame::Status			ExecuteBatch(Interpreter*, Frame*, size_t& budget);
+    // Same as ExecuteBatch, TVerified skips the runtime checks that verified functions don't need (see Function::IsVerified)
+    template<bool TVerified>
+    Frame::Status			ExecuteBatch(Interpreter*, Frame*, size_t& budget);
+    // Same as ExecuteBatch for functions promoted to the register tier, the frame must be at one of its entries (see RegisterCode::EntryAt)
+    Frame::Status			ExecuteRegisterBatch(Interpreter*, Frame*, const RegisterCode&, size_t& budget);
 }
 
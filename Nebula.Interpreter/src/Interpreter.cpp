@@ -2,27 +2,42 @@
 
 #include "Frame.h"
 #include "Utility.h"
+#include "ScriptVerifier.h"
+#include "ParallelFor.h"
 #include "InterpreterStandardOutput.h"
 
-#include <chrono>
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <format>
+#include <thread>
 
 using namespace nebula;
 
+// Touches nothing but the script, scripts are linked and verified concurrently by AddScripts
+static bool LinkAndVerify(Script& script, const ScriptVerifier::ScriptLookup& lookup, shared::DiagnosticReport& report)
+{
+	if (!script.Link()) {
+		report.ReportError(std::format("Script '{}' contains malformed instructions", script.Namespace()));
+		return false;
+	}
+
+	ScriptVerifier verifier{ lookup };
+	return verifier.Verify(script, report);
+}
+
 Interpreter::Interpreter()
 	: m_LastErrorCallstack{ nullptr }, m_pStandardOutput{ nullptr }, m_Memory{ this }
 {
 	SetStandardOutput(new InterpreterStandardOutput());
+	InvalidateCallSites();
 }
 
 Interpreter::~Interpreter()
 {
-	// Run gc to avoid leaks
-	m_Memory.Collect(true);
-	assert(m_Memory.Empty());
-
+	// Objects still alive (e.g. referenced by globals) are destroyed with the heap
 	SetState(State::Exited);
+	m_ThreadScheduler.Clear();
 	m_Threads.Clear();
 	m_Scripts.clear();
 	m_NativeFunctions.clear();
@@ -33,8 +48,7 @@ Interpreter::~Interpreter()
 Interpreter::State Interpreter::Init(bool startPaused /*= false*/)
 {
 	SetState(startPaused ? State::Paused : State::Running);
-	m_LastSchedulingUpdate = std::chrono::high_resolution_clock::now();
-	SwapExecutingThread();
+	BeginTimeSlice();
 	return GetState();
 }
 
@@ -49,7 +63,10 @@ Interpreter::State Interpreter::Run()
 		}
 
 		// Exit once we can no longer step
-		if (!Step())
+		// Profiled instructions go through Frame::Tick
+		bool batched = m_ExecutionMode == ExecutionMode::Batched && m_pOpcodeProfiler == nullptr;
+		bool stepped = batched ? StepBatch() : Step();
+		if (!stepped)
 		{
 			break;
 		}
@@ -72,14 +89,15 @@ Interpreter::State Interpreter::Stop()
 
 void Interpreter::Reset()
 {
+	m_ThreadScheduler.Clear();
 	m_Threads.Clear();
-	m_CurrentThreadIndex = 0;
 	delete m_LastErrorCallstack;
 
 	m_NativeFunctions.clear();
 	m_Scripts.clear();
+	InvalidateCallSites();
 
-	m_LastSchedulingUpdate = std::chrono::high_resolution_clock::now();
+	UpdateSchedulerTime();
 
 	// Ready to go!
 	m_StartedOnce = false;
@@ -91,6 +109,8 @@ bool Interpreter::BindNativeFunction(const std::string& name, const NativeFuncti
 		return false;
 	}
 
+	// Implicit calls that previously failed may now resolve to this binding
+	InvalidateCallSites();
 	return m_NativeFunctions.insert(std::make_pair(name, callback)).second;
 }
 
@@ -109,23 +129,111 @@ bool Interpreter::BindTypeFunction(const std::string& name, DataStackVariantInde
 		return false;
 	}
 
+	// CallVirt sites that previously failed may now resolve to this binding
+	InvalidateCallSites();
 	return map.insert(std::make_pair(name, callback)).second;
 }
 
 bool Interpreter::AddScript(std::shared_ptr<Script> script)
 {
-	if (script->Namespace() == "") {
+	shared::DiagnosticReport report;
+	return AddScript(script, report);
+}
+
+bool Interpreter::AddScript(std::shared_ptr<Script> script, shared::DiagnosticReport& report)
+{
+	if (!CanAddScript(*script, report)) {
 		return false;
 	}
 
-	if (m_Scripts.find(script->Namespace()) != m_Scripts.end()) {
+	// Calls into scripts that are not loaded yet are left to the runtime checks
+	ScriptVerifier::ScriptLookup lookup = [this, &script](const std::string& ns) -> const Script* {
+		if (ns == script->Namespace())
+			return script.get();
+
+		auto it = m_Scripts.find(ns);
+		return it != m_Scripts.end() ? it->second.get() : nullptr;
+	};
+
+	if (!LinkAndVerify(*script, lookup, report)) {
 		return false;
 	}
 
-	m_Scripts.insert(std::make_pair(script->Namespace(), script));
+	return RegisterScript(script);
+}
+
+bool Interpreter::AddScripts(const std::vector<std::shared_ptr<Script>>& scripts, std::vector<shared::DiagnosticReport>& reports, size_t threadCount)
+{
+	reports.clear();
+	reports.resize(scripts.size());
+
+	// Namespaces are checked up front so that verifying a script only ever looks at the ones added before it
+	std::map<std::string_view, size_t> setNamespaces;
+	std::vector<char> accepted(scripts.size(), 0);
+	for (size_t i{ 0 }; i < scripts.size(); i++)
+	{
+		const Script& script = *scripts[i];
+		if (!CanAddScript(script, reports[i]))
+			continue;
+
+		if (!setNamespaces.insert(std::make_pair(std::string_view{ script.Namespace() }, i)).second) {
+			reports[i].ReportError(std::format("A script with namespace '{}' was already added", script.Namespace()));
+			continue;
+		}
+
+		accepted[i] = 1;
+	}
+
+	// Nothing is added to the interpreter until every script is verified, m_Scripts is only read here
+	ParallelFor(scripts.size(), threadCount, [&](size_t i) {
+		if (!accepted[i])
+			return;
+
+		ScriptVerifier::ScriptLookup lookup = [this, &setNamespaces, &scripts, i](const std::string& ns) -> const Script* {
+			auto setIt = setNamespaces.find(ns);
+			if (setIt != setNamespaces.end())
+				return setIt->second <= i ? scripts[setIt->second].get() : nullptr;
+
+			auto it = m_Scripts.find(ns);
+			return it != m_Scripts.end() ? it->second.get() : nullptr;
+		};
+
+		accepted[i] = LinkAndVerify(*scripts[i], lookup, reports[i]) ? 1 : 0;
+	});
+
+	for (size_t i{ 0 }; i < scripts.size(); i++)
+	{
+		if (!accepted[i] || !RegisterScript(scripts[i]))
+			return false;
+	}
+
+	return true;
+}
 
+bool Interpreter::CanAddScript(const Script& script, shared::DiagnosticReport& report) const
+{
+	if (script.Namespace() == "") {
+		report.ReportError("Scripts without a namespace can't be added");
+		return false;
+	}
+
+	if (m_Scripts.find(script.Namespace()) != m_Scripts.end()) {
+		report.ReportError(std::format("A script with namespace '{}' was already added", script.Namespace()));
+		return false;
+	}
+
+	return true;
+}
+
+bool Interpreter::RegisterScript(std::shared_ptr<Script> script)
+{
+	m_Scripts.insert(std::make_pair(script->Namespace(), script));
 	m_Memory.AddGlobals(script.get());
 
+	// The new script can satisfy calls of already loaded scripts, invalidate them and link the new ones eagerly
+	InvalidateCallSites();
+	ResolveCallSites(script.get());
+
 	for (auto& kvp : script->Functions()) {
 		if (!kvp.second.HasAttribute(VMAttribute::AutoExec)) {
 			continue;
@@ -134,12 +242,18 @@ bool Interpreter::AddScript(std::shared_ptr<Script> script)
 		bool highPriority = kvp.second.HasAttribute(VMAttribute::Initializer);
 		if (highPriority)
 		{
-			Frame newFrame{ nullptr, &kvp.second, true };
-			Frame::Status initResult = newFrame.RunToCompletion(this);
+			// The frame is on no callstack, it must be rooted explicitly while it runs
+			Frame* newFrame = m_Threads.CreateFrame(nullptr, &kvp.second, true);
+			m_Memory.PushFrameRoot(newFrame);
+			Frame::Status initResult = newFrame->RunToCompletion(this);
+			m_Memory.PopFrameRoot();
 			if (initResult != Frame::Status::Finished) {
-				BuildErrorStack(&newFrame);
+				BuildErrorStack(newFrame);
+				m_Threads.DestroyFrame(newFrame);
 				return false;
 			}
+
+			m_Threads.DestroyFrame(newFrame);
 		}
 		else {
 			CreateFrameOnStack(&kvp.second, true);
@@ -176,8 +290,57 @@ bool Interpreter::Step()
 	if (CheckAndSetExitState())
 		return false; // Early exit
 
+	if (GetCurrentCallstack() == nullptr)
+	{
+		WaitForRunnableThread();
+		return true;
+	}
+
 	Frame* currentFrame = GetCurrentCallstack()->back();
 	Frame::Status frameStatus = currentFrame->Tick(this);
+	OnFrameTicked(currentFrame, frameStatus, 1);
+
+	// Incremental collections advance between steps, never in the middle of an instruction
+	if (m_Memory.IsCollecting())
+	{
+		m_Memory.CollectSlice();
+	}
+	return true;
+}
+
+bool Interpreter::StepBatch()
+{
+	if (CheckAndSetExitState())
+		return false; // Early exit
+
+	if (GetCurrentCallstack() == nullptr)
+	{
+		WaitForRunnableThread();
+		return true;
+	}
+
+	Frame* currentFrame = GetCurrentCallstack()->back();
+	size_t batchSize = m_BatchSize;
+	if (m_SchedulingMode == SchedulingMode::InstructionBudget && m_SliceInstructionCount < m_InstructionBudget)
+	{
+		// Don't run past the end of the time slice
+		batchSize = std::min(batchSize, m_InstructionBudget - m_SliceInstructionCount);
+	}
+
+	size_t budget = batchSize;
+	Frame::Status frameStatus = currentFrame->TickBatch(this, budget);
+	OnFrameTicked(currentFrame, frameStatus, batchSize - budget);
+
+	if (m_Memory.IsCollecting())
+	{
+		m_Memory.CollectSlice();
+	}
+	return true;
+}
+
+void Interpreter::OnFrameTicked(Frame* currentFrame, Frame::Status frameStatus, size_t executedInstructions)
+{
+	CallStack* currentCallstack = GetCurrentCallstack();
 	switch (frameStatus)
 	{
 	case Frame::Status::FatalError:
@@ -194,30 +357,38 @@ bool Interpreter::Step()
 			assert(false && "Stack is not empty at the end of frame execution!");
 		}
 
-		delete currentFrame;
-		GetCurrentCallstack()->pop_back();
+		m_Threads.DestroyFrame(currentFrame);
+		currentCallstack->pop_back();
 		break;
 	}
 	}
 
-	if (GetCurrentCallstack()->empty())
+	if (currentCallstack->empty())
 	{
-		m_Threads.RemoveCallstack(m_CurrentThreadIndex);
-		SwapExecutingThread();
+		m_ThreadScheduler.RemoveCurrent();
+		m_Threads.RemoveCallstack(currentCallstack);
+		BeginTimeSlice();
+	}
+	else if (frameStatus == Frame::Status::Paused)
+	{
+		// A blocked frame has nothing to do with the rest of its time slice, keep it out of the
+		// run queue until its timer expires or a notification wakes it up
+		m_ThreadScheduler.ParkCurrent(currentCallstack->back()->WakeTime());
+		BeginTimeSlice();
 	}
-	else if (ShouldScheduleNewFrame())
+	else if (ShouldScheduleNewFrame(executedInstructions))
 	{
 		SwapExecutingThread();
 	}
 
 	CheckAndSetExitState();
-	return true;
 }
 
 bool Interpreter::CheckAndSetExitState()
 {
 	if (GetState() == State::Abort)
 	{
+		m_ThreadScheduler.Clear();
 		m_Threads.Clear();
 		return true;
 	}
@@ -261,47 +432,86 @@ void Interpreter::SetState(State state)
 	}
 }
 
-bool Interpreter::ShouldScheduleNewFrame()
+bool Interpreter::ShouldScheduleNewFrame(size_t executedInstructions)
 {
-	if (m_Threads.Count() == 1 || m_Threads.Count() == 0)
+	// Sleeping threads are only woken up when the time slice ends
+	if (m_ThreadScheduler.RunnableCount() <= 1 && !m_ThreadScheduler.HasTimers())
 	{
 		return false;
 	}
 
-	auto newUpdate = std::chrono::high_resolution_clock::now();
-	long long passedMs = std::chrono::duration_cast<std::chrono::milliseconds>(newUpdate - m_LastSchedulingUpdate).count();
+	m_SliceInstructionCount += executedInstructions;
+	if (m_SchedulingMode == SchedulingMode::InstructionBudget)
+	{
+		return m_SliceInstructionCount >= m_InstructionBudget;
+	}
 
-	if (passedMs >= m_MaxExecutionTime)
+	// Reading the clock is expensive compared to an instruction, only do it every few of them
+	if (m_SliceInstructionCount < m_NextClockSample)
 	{
-		m_LastSchedulingUpdate = newUpdate;
-		return true;
+		return false;
 	}
 
-	return false;
+	m_NextClockSample = m_SliceInstructionCount + m_ClockSampleInterval;
+	UpdateSchedulerTime();
+	return m_SchedulerTime - m_SliceStartTime >= (unsigned long long)m_MaxExecutionTime;
+}
+
+void Interpreter::UpdateSchedulerTime()
+{
+	m_SchedulerTime = GetCurrentMillis();
 }
 
 void Interpreter::SwapExecutingThread()
 {
-	if (m_Threads.Count() == 0 || m_Threads.Count() == 1)
+	m_ThreadScheduler.Rotate();
+	BeginTimeSlice();
+}
+
+void Interpreter::BeginTimeSlice()
+{
+	// The clock is only needed to measure time slices and to expire timers of sleeping threads
+	if (m_SchedulingMode == SchedulingMode::TimeSlice || m_ThreadScheduler.HasTimers())
+	{
+		UpdateSchedulerTime();
+		m_ThreadScheduler.WakeExpired(m_SchedulerTime);
+	}
+
+	m_SliceStartTime = m_SchedulerTime;
+	m_SliceInstructionCount = 0;
+	m_NextClockSample = m_ClockSampleInterval;
+}
+
+void Interpreter::WaitForRunnableThread()
+{
+	// Every thread is blocked, idle until the closest timer expires instead of spinning on the clock
+	UpdateSchedulerTime();
+	if (m_ThreadScheduler.WakeExpired(m_SchedulerTime))
 	{
-		m_CurrentThreadIndex = 0;
+		BeginTimeSlice();
 		return;
 	}
 
-	// Calculate the new index
+	// Rather than sleeping, give the time to an incremental collector that has work left
+	if (m_Memory.IsIncremental() && !m_Memory.CollectFor(1000))
 	{
-		m_CurrentThreadIndex++;
-		if (m_CurrentThreadIndex >= m_Threads.Count())
-		{
-			m_CurrentThreadIndex = 0;
-		}
+		return;
 	}
+
+	// Timers have a millisecond resolution, sleeping for one also keeps Pause() and Stop() responsive
+	std::this_thread::sleep_for(std::chrono::milliseconds(1));
 }
 
 void Interpreter::CreateFrameOnStack(const Function* f, bool separateThread)
 {
 	assert(f);
 
+	// Hot functions move to the register tier, frames already running switch at their next block
+	if (m_HotCallThreshold > 0 && f->CountCall() == m_HotCallThreshold)
+	{
+		f->PromoteToRegisterTier();
+	}
+
 	Frame* parent{ nullptr };
 
 	CallStack* cStack = GetCurrentCallstack();
@@ -310,12 +520,14 @@ void Interpreter::CreateFrameOnStack(const Function* f, bool separateThread)
 		parent = cStack->back();
 	}
 
-	Frame* newFrame = new Frame(parent, f, separateThread);
+	Frame* newFrame = m_Threads.CreateFrame(parent, f, separateThread);
+	newFrame->SetThreadScheduler(&m_ThreadScheduler);
 	if (separateThread)
 	{
 		CallStack* newThreadCallstack = m_Threads.CreateNewThread();
 		newThreadCallstack->reserve(2);
 		newThreadCallstack->push_back(newFrame);
+		m_ThreadScheduler.AddThread(newThreadCallstack);
 		return;
 	}
 
@@ -358,7 +570,7 @@ std::string Interpreter::BuildGuiltyInstructionLineForCallStack(Frame* f)
 {
 	size_t labelIndex = f->NextInstructionIndex() - 1;
 
-	auto& currInstruction = f->GetFunction()->Instructions()[labelIndex];
+	FunctionInstruction currInstruction = f->GetFunction()->InstructionAt(labelIndex);
 	VMInstruction currentOpcode = currInstruction.first;
 
 	std::string line = itos(currentOpcode);
@@ -372,6 +584,81 @@ std::string Interpreter::BuildGuiltyInstructionLineForCallStack(Frame* f)
 	return line;
 }
 
+void Interpreter::InvalidateCallSites()
+{
+	// Generations are shared by all interpreters so that a script added to more
+	// than one interpreter never mistakes a cache filled by another one as valid
+	static std::atomic<uint32_t> s_NextGeneration{ UnresolvedCallSiteGeneration + 1 };
+
+	uint32_t generation = s_NextGeneration.fetch_add(1);
+	if (generation == UnresolvedCallSiteGeneration)
+	{
+		generation = s_NextGeneration.fetch_add(1);
+	}
+
+	m_CallSiteGeneration = generation;
+}
+
+void Interpreter::ResolveCallSites(const Script* script)
+{
+	for (const auto& kvp : script->Functions())
+	{
+		const LinkedCode& code = kvp.second.Code();
+		for (size_t i{ 0 }; i < code.Size(); i++)
+		{
+			const LinkedInstruction& instruction = code[i];
+			switch (instruction.Opcode)
+			{
+			case VMInstruction::Call:
+			case VMInstruction::Call_t:
+			case VMInstruction::Newobj:
+				ResolveCallSite(&kvp.second, instruction, code.CallSiteAt(instruction.C.Int));
+				break;
+			case VMInstruction::LdSfld:
+			case VMInstruction::StsFld:
+				ResolveGlobalSite(&kvp.second, instruction, code.GlobalSiteAt(instruction.C.Int));
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
+void Interpreter::ResolveCallSite(const Function* caller, const LinkedInstruction& instruction, CallSite& site) const
+{
+	const LinkedCode& code = caller->Code();
+	const std::string& name = code.String(instruction.A.String);
+	bool implicitNamespace = instruction.B.String == InvalidStringId;
+	const std::string& ns = implicitNamespace ? caller->Namespace() : code.String(instruction.B.String);
+
+	site = CallSite{};
+	site.Generation = m_CallSiteGeneration;
+
+	if (instruction.Opcode == VMInstruction::Newobj)
+	{
+		site.BundleTarget = GetBundleDefinition(ns, name);
+		return;
+	}
+
+	site.Target = GetFunction(ns, name);
+
+	// Only calls without an explicit namespace can fall back to native functions
+	if (site.Target == nullptr && implicitNamespace)
+	{
+		site.NativeTarget = GetNativeFunction(name);
+	}
+}
+
+void Interpreter::ResolveGlobalSite(const Function* caller, const LinkedInstruction& instruction, GlobalSite& site) const
+{
+	const LinkedCode& code = caller->Code();
+	const std::string& ns = instruction.B.String == InvalidStringId ? caller->Namespace() : code.String(instruction.B.String);
+
+	site.Slot = m_Memory.GlobalSlot(ns, instruction.A.Int);
+	site.Generation = m_CallSiteGeneration;
+}
+
 const Function* Interpreter::GetFunction(const std::string& scriptNamespace, const std::string& funcName) const
 {
 	auto scriptIt = m_Scripts.find(scriptNamespace);
@@ -425,11 +712,3 @@ const NativeFunctionCallback* nebula::Interpreter::GetTypeFunction(DataStackVari
 	const NativeFunctionCallback& func = it2->second;
 	return &func;
 }
-
-CallStack* Interpreter::GetCurrentCallstack()
-{
-	if (!m_Threads.HasCallStacks())
-		return nullptr;
-
-	return &m_Threads.At(m_CurrentThreadIndex);
-}
@@ -3,61 +3,158 @@
 #include "VariantArray.h"
 #include "Interpreter.h"
 
-#include <stack>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <unordered_set>
 
 using namespace nebula;
 
 constexpr size_t g_MinGCThreshold = 128;
+// Young objects allocated before a nursery collection
+constexpr size_t g_NurserySize = 1024;
+constexpr size_t g_DefaultSliceWork = 4096;
+// Work done between two reads of the clock during a timed slice
+constexpr size_t g_SliceClockInterval = 256;
+// In stress mode, allocations between two full collections and work of the slices run by allocations
+constexpr size_t g_StressFullInterval = 8;
+constexpr size_t g_StressSliceWork = 16;
+
+static unsigned long long GetCurrentMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
-static void GatherStackRoots(Interpreter* vm, std::vector<AllocableObjectPtr>& foundRoots)
+void InterpreterMemory::MarkObject(IGCObject* obj, std::vector<IGCObject*>& grayObjects, bool youngOnly)
 {
-    const ThreadMap& tm = vm->GetThreadMap();
-    size_t threadCount = tm.Count();
-    for (int i = 0; i < threadCount; i++)
+    // Nursery collections stop at old objects, the young objects they reference are in the remembered set
+    if (obj == nullptr || obj->m_bIsMarked || (youngOnly && obj->m_bIsOld))
+        return;
+
+    obj->m_bIsMarked = true;
+    grayObjects.push_back(obj);
+}
+
+template<typename TFunc>
+static void ForEachChild(IGCObject* obj, TFunc&& func)
+{
+    switch (obj->GetType())
     {
-        const CallStack& t = tm.At(i);
+    case ObjectType::Bundle:
+    {
+        Bundle* bundle = static_cast<Bundle*>(obj);
+        for (int f{ 0 }; f < bundle->FieldCount(); f++)
+        {
+            func(bundle->Get(f).AsObject());
+        }
+        break;
+    }
+    case ObjectType::Array:
+    {
+        VariantArray* array = static_cast<VariantArray*>(obj);
+        for (int e{ 0 }; e < array->Size(); e++)
+        {
+            func((*array)[e].AsObject());
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
 
+void InterpreterMemory::MarkChildren(IGCObject* obj, std::vector<IGCObject*>& grayObjects, bool youngOnly)
+{
+    ForEachChild(obj, [&grayObjects, youngOnly](IGCObject* child) { MarkObject(child, grayObjects, youngOnly); });
+}
 
-        size_t frameCount = t.size();
+template<typename TFunc>
+static void ForEachFrameRoot(const Frame* frame, TFunc& func)
+{
+    const FrameMemory& memory = frame->Memory();
 
-        [[unlikely]]
-        if (frameCount == 0)
-            continue;
+    size_t paramCount = memory.ParamCount();
+    for (int j{ 0 }; j < paramCount; j++)
+    {
+        func(memory.ParamAt(j).AsObject());
+    }
 
-        for (int f{ 0 }; f < frameCount; f++)
-        {
-            const Frame* rootFrame = t[f];
-            const FrameMemory& memory = rootFrame->Memory();
+    size_t localCount = memory.LocalCount();
+    for (int j{ 0 }; j < localCount; j++)
+    {
+        func(memory.LocalAt(j).AsObject());
+    }
+
+    const DataStack& stack = frame->Stack();
+    auto it = stack.begin();
+    while (it != stack.end())
+    {
+        func(it->AsObject());
+        it++;
+    }
+
+    // Objects a frame waits on may only be referenced by its scheduler
+    frame->Scheduler().ForEachNotifier(func);
+}
 
-            size_t localCount = memory.LocalCount();
-            for (int j{ 0 }; j < localCount; j++)
+template<typename TFunc>
+void InterpreterMemory::ForEachRootFrame(TFunc&& func) const
+{
+    auto visitCalls = [&func](const Frame* frame)
+        {
+            // A call made by a frame is only on a callstack if the caller is, follow the chain of callees
+            for (const Frame* child = frame->Child(); child != nullptr; child = child->Child())
             {
-                const Variable& fv = memory.LocalAt(j);
-                if (const TGCObject* obj = std::get_if<TGCObject>(&fv.Value()))
-                {
-                    foundRoots.push_back(*obj);
-                }
+                func(child);
             }
+        };
 
-            const DataStack& stack = rootFrame->Stack();
-            auto it = stack.begin();
-            while (it != stack.end())
-            {
-                const DataStackVariant& variant = *it;
-                if (const TGCObject* obj = std::get_if<TGCObject>(&variant))
-                {
-                    foundRoots.push_back(*obj);
-                }
+    const ThreadMap& tm = m_pParent->GetThreadMap();
+    size_t threadCount = tm.Count();
+    for (int i = 0; i < threadCount; i++)
+    {
+        // Callees are pushed on the callstack of their caller, only the innermost frame can have calls elsewhere
+        const CallStack& t = tm.At(i);
+        size_t frameCount = t.size();
+        for (int f{ 0 }; f < frameCount; f++)
+        {
+            func(t[f]);
+        }
 
-                it++;
-            }
+        if (frameCount > 0)
+        {
+            visitCalls(t[frameCount - 1]);
         }
+    }
 
+    for (const Frame* frame : m_FrameRoots)
+    {
+        func(frame);
+        visitCalls(frame);
     }
 }
 
+template<typename TFunc>
+void InterpreterMemory::ForEachStackRoot(TFunc&& func) const
+{
+    ForEachRootFrame([&func](const Frame* frame) { ForEachFrameRoot(frame, func); });
+
+    for (const auto& kvp : m_PinnedObjects)
+    {
+        func(kvp.first);
+    }
+}
+
+void InterpreterMemory::GatherStackRoots(std::vector<IGCObject*>& grayObjects, bool youngOnly) const
+{
+    ForEachStackRoot([&grayObjects, youngOnly](IGCObject* obj) { MarkObject(obj, grayObjects, youngOnly); });
+}
+
 InterpreterMemory::InterpreterMemory(Interpreter* parent)
-    : m_pParent{ parent }, m_IGCObjects{}, m_iGCThreshold{ g_MinGCThreshold }
+    : m_pParent{ parent }, m_iGCThreshold{ g_MinGCThreshold }, m_SliceWork{ g_DefaultSliceWork }
 {
 }
 
@@ -65,127 +162,417 @@ TBundle InterpreterMemory::AllocBundle(const BundleDefinition& definition)
 {
     // Attempt to free memory at each allocation
     Collect();
-    // This shared pointer is passed around function frames
-    TBundle ptr = Bundle::FromDefinition(definition);
-    // Keep track of the allocated objectsw
-    m_IGCObjects.push_back(dynamic_pointer_cast<IGCObject>(ptr));
-
-    return ptr;
+    return m_Heap.New<Bundle>(definition);
 }
 
 TArray InterpreterMemory::AllocArray(const DataStackVariantIndex& type)
 {
     // Attempt to free memory at each allocation
     Collect();
-    TArray ptr = std::make_shared<VariantArray>(type);
-    m_IGCObjects.push_back(dynamic_pointer_cast<IGCObject>(ptr));
-
-    return ptr;
+    return m_Heap.New<VariantArray>(type);
 }
 
 void InterpreterMemory::Collect(bool force)
 {
-    Interpreter* vm = m_pParent;
-    size_t startingSize = m_IGCObjects.size();
-
-    if (force || startingSize >= m_iGCThreshold)
+    if (force)
     {
-        std::vector<AllocableObjectPtr> roots;
-        GatherStackRoots(vm, roots);
+        FinishCycle();
+        CollectAll();
+        return;
+    }
 
-        std::stack<AllocableObjectPtr> grayObjects;
+    [[unlikely]]
+    if (m_bStressMode)
+    {
+        CollectStress();
+        return;
+    }
 
-        for (int i{ 0 }; i < roots.size(); i++)
+    // Young objects are kept until the incremental collection completed
+    if (IsCollecting())
+    {
+        // The slices can't keep up with the allocations, stop letting the heap grow
+        if (m_Heap.ObjectCount() >= m_iGCThreshold * 2)
         {
-            roots[i]->m_bIsMarked = true;
-            grayObjects.push(roots[i]);
+            FinishCycle();
         }
+        return;
+    }
 
-        while (!grayObjects.empty())
+    if (m_Heap.NurseryCount() < g_NurserySize)
+        return;
+
+    CollectNursery();
+
+    // Everything left survived at least one collection, only look at old objects again once there are enough of them
+    if (m_Heap.ObjectCount() >= m_iGCThreshold)
+    {
+        if (m_bIncremental)
         {
-            AllocableObjectPtr ptr = grayObjects.top();
-            grayObjects.pop();
+            BeginCycle();
+        }
+        else
+        {
+            CollectAll();
+        }
+    }
+}
 
-            if (TBundle bundle = std::dynamic_pointer_cast<Bundle>(ptr))
+void InterpreterMemory::CollectStress()
+{
+    if (IsCollecting())
+    {
+        // Tiny slices so that the barriers run in the middle of the cycle
+        RunSlice(g_StressSliceWork, 0);
+    }
+    else
+    {
+        CollectNursery();
+        if (++m_StressCollections % g_StressFullInterval == 0)
+        {
+            if (m_bIncremental)
             {
-                for (int f{ 0 }; f < bundle->FieldCount(); f++)
-                {
-                    auto& variant = bundle->Get(f);
-                    if (variant.index() == DataStackVariantIndex::_TypeObject)
-                    {
-                        AllocableObjectPtr childPtr = std::get<TGCObject>(variant);
-                        if (childPtr->m_bIsMarked)
-                            continue;
-
-                        childPtr->m_bIsMarked = true;
-                        grayObjects.push(childPtr);
-                    }
-                }
+                BeginCycle();
+            }
+            else
+            {
+                CollectAll();
             }
         }
+    }
+
+    std::string error;
+    if (!VerifyHeap(error))
+    {
+        // Going on would use destroyed objects
+        std::cerr << "Heap integrity check failed: " << error << "\n";
+        assert(false && "Heap integrity check failed");
+        std::abort();
+    }
+}
+
+bool InterpreterMemory::VerifyHeap(std::string& error) const
+{
+    std::unordered_set<const IGCObject*> objects;
+    size_t youngCount{ 0 };
+    m_Heap.ForEachObject([&objects, &youngCount](IGCObject* obj)
+        {
+            objects.insert(obj);
+            youngCount += obj->m_bIsOld ? 0 : 1;
+        });
+
+    if (objects.size() != m_Heap.ObjectCount())
+    {
+        error = "The object count doesn't match the objects in the heap";
+        return false;
+    }
+
+    bool nurseryValid{ true };
+    m_Heap.ForEachYoungObject([&nurseryValid](IGCObject* obj) { nurseryValid &= !obj->m_bIsOld; });
+    if (!nurseryValid || youngCount != m_Heap.NurseryCount())
+    {
+        error = "The nursery doesn't hold exactly the young objects";
+        return false;
+    }
+
+    // A frame missing from the roots would have its objects collected while it still uses them
+    std::unordered_set<const Frame*> rootFrames;
+    ForEachRootFrame([&rootFrames](const Frame* frame) { rootFrames.insert(frame); });
+    if (rootFrames.size() != m_pParent->GetThreadMap().FrameCount())
+    {
+        error = std::format("{} frames are alive but only {} are roots", m_pParent->GetThreadMap().FrameCount(), rootFrames.size());
+        return false;
+    }
 
-        Sweep();
+    // Walk the reachable objects, garbage may legitimately reference destroyed objects
+    const char* problem{ nullptr };
+    std::unordered_set<const IGCObject*> visited;
+    std::vector<IGCObject*> pending;
+    auto visit = [&](IGCObject* obj)
+        {
+            if (obj == nullptr || problem != nullptr)
+                return;
+
+            if (!objects.contains(obj))
+            {
+                problem = "A reachable object was destroyed";
+                return;
+            }
+
+            if (visited.insert(obj).second)
+            {
+                pending.push_back(obj);
+            }
+        };
 
-        size_t reductionAmount = startingSize - m_IGCObjects.size();
-        size_t quarter = startingSize / 4;
-        if (reductionAmount < quarter)
+    ForEachStackRoot(visit);
+    for (size_t slot{ 0 }; slot < m_Globals.size(); slot++)
+    {
+        IGCObject* obj = m_Globals[slot].AsObject();
+        visit(obj);
+        if (problem == nullptr && obj != nullptr && !obj->m_bIsOld && !m_DirtyGlobals[slot])
         {
-            m_iGCThreshold *= 2;
+            problem = "A global references a young object without being remembered";
         }
-        else if (reductionAmount > quarter * 3)
+    }
+
+    while (!pending.empty() && problem == nullptr)
+    {
+        IGCObject* obj = pending.back();
+        pending.pop_back();
+
+        // Marks only outlive a collection while an incremental one is in progress
+        if (obj->m_bIsMarked && !IsCollecting())
         {
-            m_iGCThreshold /= 2;
+            problem = "An object is still marked after a collection";
+            break;
         }
 
-        if (m_iGCThreshold < g_MinGCThreshold)
-            m_iGCThreshold = g_MinGCThreshold;
+        ForEachChild(obj, [&](IGCObject* child)
+            {
+                visit(child);
+                if (problem == nullptr && child != nullptr && obj->m_bIsOld && !child->m_bIsOld && !obj->m_bIsRemembered)
+                {
+                    problem = "An old object references a young object without being remembered";
+                }
+            });
+    }
+
+    if (problem != nullptr)
+    {
+        error = problem;
+        return false;
     }
+
+    return true;
+}
+
+void InterpreterMemory::CollectSlice()
+{
+    unsigned long long deadline = m_SliceTime > 0 ? GetCurrentMicros() + m_SliceTime : 0;
+    RunSlice(m_SliceWork, deadline);
+}
+
+bool InterpreterMemory::CollectFor(unsigned int microseconds)
+{
+    unsigned long long deadline = GetCurrentMicros() + microseconds;
+    if (!IsCollecting())
+    {
+        // Idle time is cheaper than a pause, don't wait for the heap to reach its threshold
+        if (m_Heap.ObjectCount() < m_iGCThreshold / 2)
+            return true;
+
+        CollectNursery();
+        BeginCycle();
+    }
+
+    return RunSlice(SIZE_MAX, deadline);
+}
+
+void InterpreterMemory::CollectNursery()
+{
+    std::vector<IGCObject*> grayObjects;
+    GatherStackRoots(grayObjects, true);
+
+    for (size_t slot : m_RememberedGlobals)
+    {
+        MarkObject(m_Globals[slot].AsObject(), grayObjects, true);
+    }
+
+    for (IGCObject* obj : m_RememberedObjects)
+    {
+        MarkChildren(obj, grayObjects, true);
+    }
+
+    while (!grayObjects.empty())
+    {
+        IGCObject* ptr = grayObjects.back();
+        grayObjects.pop_back();
+        MarkChildren(ptr, grayObjects, true);
+    }
+
+    m_Heap.SweepNursery();
+    ClearRememberedSets();
+}
+
+void InterpreterMemory::CollectAll()
+{
+    size_t startingSize = m_Heap.ObjectCount();
+
+    std::vector<IGCObject*> grayObjects;
+    GatherStackRoots(grayObjects, false);
+
+    for (const Variable& global : m_Globals)
+    {
+        MarkObject(global.AsObject(), grayObjects, false);
+    }
+
+    while (!grayObjects.empty())
+    {
+        IGCObject* ptr = grayObjects.back();
+        grayObjects.pop_back();
+        MarkChildren(ptr, grayObjects, false);
+    }
+
+    size_t reductionAmount = m_Heap.Sweep();
+    ClearRememberedSets();
+    AdaptThreshold(startingSize, reductionAmount);
 }
 
-void InterpreterMemory::Sweep()
+void InterpreterMemory::AdaptThreshold(size_t startingSize, size_t reductionAmount)
 {
-    auto it = m_IGCObjects.begin();
-    while (it != m_IGCObjects.end())
+    size_t quarter = startingSize / 4;
+    if (reductionAmount < quarter)
     {
-        AllocableObjectPtr obj = *it;
-        // We didn't reach it, so release it
-        if (!obj->m_bIsMarked)
+        m_iGCThreshold *= 2;
+    }
+    else if (reductionAmount > quarter * 3)
+    {
+        m_iGCThreshold /= 2;
+    }
+
+    if (m_iGCThreshold < g_MinGCThreshold)
+        m_iGCThreshold = g_MinGCThreshold;
+}
+
+void InterpreterMemory::BeginCycle()
+{
+    assert(m_Phase == CollectionPhase::Idle);
+    m_Phase = CollectionPhase::Mark;
+    m_CycleStartingSize = m_Heap.ObjectCount();
+
+    // From now on the write barriers shade every object stored in the heap or in a global
+    GatherStackRoots(m_GrayObjects, false);
+    for (const Variable& global : m_Globals)
+    {
+        MarkObject(global.AsObject(), m_GrayObjects, false);
+    }
+}
+
+bool InterpreterMemory::RunSlice(size_t work, unsigned long long deadline)
+{
+    while (IsCollecting() && work > 0)
+    {
+        size_t chunk = std::min(work, g_SliceClockInterval);
+        work -= chunk;
+
+        if (m_Phase == CollectionPhase::Mark)
         {
-            if (TBundle bundle = std::dynamic_pointer_cast<Bundle>(obj))
+            while (!m_GrayObjects.empty() && chunk > 0)
             {
-                bundle->ClearFields();
+                IGCObject* ptr = m_GrayObjects.back();
+                m_GrayObjects.pop_back();
+                MarkChildren(ptr, m_GrayObjects, false);
+                chunk--;
             }
 
-            it = m_IGCObjects.erase(it);
+            if (m_GrayObjects.empty())
+            {
+                FinishMarking();
+            }
         }
-        else
+        else if (m_Heap.SweepSlice(chunk))
         {
-            // reset for next gc run
-            obj->m_bIsMarked = false;
-            it++;
+            m_Phase = CollectionPhase::Idle;
+            AdaptThreshold(m_CycleStartingSize, m_Heap.SweptCount());
         }
+
+        if (deadline != 0 && GetCurrentMicros() >= deadline)
+            break;
+    }
+
+    return !IsCollecting();
+}
+
+void InterpreterMemory::FinishMarking()
+{
+    // Stacks have no write barrier, what they gained since the cycle began is only found by scanning them again
+    GatherStackRoots(m_GrayObjects, false);
+    while (!m_GrayObjects.empty())
+    {
+        IGCObject* ptr = m_GrayObjects.back();
+        m_GrayObjects.pop_back();
+        MarkChildren(ptr, m_GrayObjects, false);
+    }
+
+    // Young objects survive the cycle, the old objects still remembered because of them may not
+    auto it = std::remove_if(m_RememberedObjects.begin(), m_RememberedObjects.end(),
+        [](IGCObject* obj) { return !obj->m_bIsMarked; });
+    m_RememberedObjects.erase(it, m_RememberedObjects.end());
+
+    m_Heap.BeginSweep();
+    m_Phase = CollectionPhase::Sweep;
+}
+
+void InterpreterMemory::FinishCycle()
+{
+    RunSlice(SIZE_MAX, 0);
+}
+
+void InterpreterMemory::ClearRememberedSets()
+{
+    // Every survivor is old now, old objects and globals can't reference young objects anymore
+    for (IGCObject* obj : m_RememberedObjects)
+    {
+        obj->m_bIsRemembered = false;
+    }
+    m_RememberedObjects.clear();
+
+    for (size_t slot : m_RememberedGlobals)
+    {
+        m_DirtyGlobals[slot] = false;
+    }
+    m_RememberedGlobals.clear();
+}
+
+void InterpreterMemory::Pin(IGCObject* object)
+{
+    assert(object);
+    m_PinnedObjects[object]++;
+
+    // The host may have read the object from a place only traced earlier
+    if (m_Phase == CollectionPhase::Mark)
+    {
+        MarkObject(object, m_GrayObjects, false);
+    }
+}
+
+void InterpreterMemory::Unpin(IGCObject* object)
+{
+    auto it = m_PinnedObjects.find(object);
+    assert(it != m_PinnedObjects.end() && "Unpinning an object that was never pinned");
+    if (it != m_PinnedObjects.end() && --it->second == 0)
+    {
+        m_PinnedObjects.erase(it);
     }
 }
 
 void InterpreterMemory::AddGlobals(const Script* script)
 {
-    std::vector<Variable> variables{};
-    variables.reserve(script->Globals().size());
+    size_t base = m_Globals.size();
+    m_Globals.reserve(base + script->Globals().size());
 
     for (auto& global : script->Globals())
     {
-        variables.emplace_back(global.GetType());
+        m_Globals.emplace_back(global.GetType());
     }
-    m_ScriptGlobals[script->Namespace()] = variables;
+    m_DirtyGlobals.resize(m_Globals.size(), false);
+    m_ScriptGlobalRanges[script->Namespace()] = { base, script->Globals().size() };
 }
 
-Variable* InterpreterMemory::GetGlobal(const std::string_view& script, TInt32 index)
+size_t InterpreterMemory::GlobalSlot(const std::string_view& script, TInt32 index) const
 {
-    auto it = m_ScriptGlobals.find(script);
-    if (it == m_ScriptGlobals.end())
+    auto it = m_ScriptGlobalRanges.find(script);
+    if (it == m_ScriptGlobalRanges.end())
+    {
+        return InvalidGlobalSlot;
+    }
+
+    auto [base, count] = it->second;
+    if (index < 0 || (size_t)index >= count)
     {
-        return nullptr;
+        return InvalidGlobalSlot;
     }
 
-    return &it->second.at(index);
+    return base + index;
 }
@@ -0,0 +1,483 @@
+#include <cassert>
+#include <limits>
+
+#include "LinkedCode.h"
+
+using namespace nebula;
+
+bool LinkedCode::Link(const FunctionBody& body)
+{
+	Clear();
+	m_Instructions.reserve(body.size());
+
+	for (const FunctionInstruction& instruction : body)
+	{
+		LinkedInstruction linked{};
+		linked.Opcode = instruction.first;
+		linked.B.String = InvalidStringId;
+		linked.C.String = InvalidStringId;
+
+		if (!Lower(instruction.first, instruction.second, linked))
+		{
+			Clear();
+			return false;
+		}
+
+		m_Instructions.push_back(linked);
+	}
+
+	m_StringLookup.clear();
+	m_Strings.shrink_to_fit();
+	return true;
+}
+
+bool LinkedCode::Load(std::vector<LinkedInstruction>&& instructions, std::vector<SharedString*>&& strings)
+{
+	Clear();
+	if (!IsLoadable(instructions, strings.size()))
+		return false;
+
+	m_Instructions = std::move(instructions);
+	m_Strings = std::move(strings);
+	BuildSites();
+	return true;
+}
+
+void LinkedCode::Restore()
+{
+	for (size_t i{ 0 }; i < m_Instructions.size(); i++)
+	{
+		m_Instructions[i] = Original(i);
+	}
+
+	assert(IsLoadable(m_Instructions, m_Strings.size()) && "Linked code was changed by something else than the verifier");
+	BuildSites();
+}
+
+void LinkedCode::Clear()
+{
+	m_Instructions.clear();
+	m_Strings.clear();
+	m_CallSites.clear();
+	m_GlobalSites.clear();
+	m_StringLookup.clear();
+}
+
+LinkedInstruction LinkedCode::Original(size_t index) const
+{
+	LinkedInstruction instruction = m_Instructions[index];
+	VMInstruction unfused = UnfusedOpcode(instruction.Opcode);
+	if (unfused == instruction.Opcode)
+	{
+		instruction.Opcode = GenericOpcode(instruction.Opcode);
+		return instruction;
+	}
+
+	// Superinstructions keep the operand of the load they replaced in A
+	LinkedInstruction load{};
+	load.Opcode = unfused;
+	load.A = instruction.A;
+	load.B.String = InvalidStringId;
+	load.C.String = InvalidStringId;
+	return load;
+}
+
+FunctionInstruction LinkedCode::Unlower(size_t index) const
+{
+	const LinkedInstruction instruction = Original(index);
+	InstructionArguments args;
+
+	switch (instruction.Opcode)
+	{
+	case VMInstruction::Call_t:
+	case VMInstruction::Call:
+	case VMInstruction::Newobj:
+		if (instruction.B.String != InvalidStringId)
+			args.emplace_back(SharedStringAt(instruction.B.String));
+
+		args.emplace_back(SharedStringAt(instruction.A.String));
+		break;
+	case VMInstruction::NewArr:
+		args.emplace_back(instruction.A.Int);
+		if (instruction.B.String != InvalidStringId)
+			args.emplace_back(SharedStringAt(instruction.B.String));
+
+		if (instruction.C.String != InvalidStringId)
+			args.emplace_back(SharedStringAt(instruction.C.String));
+		break;
+	case VMInstruction::CallVirt:
+		args.emplace_back(instruction.A.Int);
+		args.emplace_back(SharedStringAt(instruction.B.String));
+		break;
+	case VMInstruction::StsFld:
+	case VMInstruction::LdSfld:
+		args.emplace_back(instruction.A.Int);
+		if (instruction.B.String != InvalidStringId)
+			args.emplace_back(SharedStringAt(instruction.B.String));
+		break;
+	case VMInstruction::AddStr:
+	case VMInstruction::Stloc:
+	case VMInstruction::StArg:
+	case VMInstruction::Ldloc:
+	case VMInstruction::Ldarg:
+	case VMInstruction::BrFalse:
+	case VMInstruction::BrTrue:
+	case VMInstruction::Br:
+	case VMInstruction::LdFld:
+	case VMInstruction::StFld:
+	case VMInstruction::ConvType:
+	case VMInstruction::Ldc_i4:
+		args.emplace_back(instruction.A.Int);
+		break;
+	case VMInstruction::Ldc_r4:
+		args.emplace_back(instruction.A.Float);
+		break;
+	case VMInstruction::Ldc_s:
+		args.emplace_back(SharedStringAt(instruction.A.String));
+		break;
+	default:
+		// No arguments
+		break;
+	}
+
+	return std::make_pair(instruction.Opcode, std::move(args));
+}
+
+bool LinkedCode::IsLoadable(const std::vector<LinkedInstruction>& instructions, size_t stringCount)
+{
+	auto isString = [stringCount](StringId id, bool optional)
+	{
+		return id < stringCount || (optional && id == InvalidStringId);
+	};
+
+	// Sites are numbered in the order of the instructions using them
+	TInt32 callSiteCount{ 0 };
+	TInt32 globalSiteCount{ 0 };
+	for (const LinkedInstruction& instruction : instructions)
+	{
+		switch (instruction.Opcode)
+		{
+		case VMInstruction::Call_t:
+		case VMInstruction::Call:
+		case VMInstruction::Newobj:
+			if (!isString(instruction.A.String, false) || !isString(instruction.B.String, true) || instruction.C.Int != callSiteCount++)
+				return false;
+			break;
+		case VMInstruction::CallVirt:
+			if (!isString(instruction.B.String, false) || instruction.C.Int != callSiteCount++)
+				return false;
+			break;
+		case VMInstruction::StsFld:
+		case VMInstruction::LdSfld:
+			if (!isString(instruction.B.String, true) || instruction.C.Int != globalSiteCount++)
+				return false;
+			break;
+		case VMInstruction::NewArr:
+			// The namespace is only there with the object name
+			if (!isString(instruction.B.String, true) || !isString(instruction.C.String, true))
+				return false;
+
+			if (instruction.B.String != InvalidStringId && instruction.C.String == InvalidStringId)
+				return false;
+			break;
+		case VMInstruction::Ldc_s:
+			if (!isString(instruction.A.String, false))
+				return false;
+			break;
+		default:
+			// Specialized opcodes and superinstructions only come from the verifier
+			if (instruction.Opcode < VMInstruction::Nop || instruction.Opcode >= VMInstruction::Add_i4)
+				return false;
+			break;
+		}
+	}
+
+	return true;
+}
+
+void LinkedCode::BuildSites()
+{
+	m_CallSites.clear();
+	m_GlobalSites.clear();
+
+	for (const LinkedInstruction& instruction : m_Instructions)
+	{
+		switch (instruction.Opcode)
+		{
+		case VMInstruction::Call_t:
+		case VMInstruction::Call:
+		case VMInstruction::Newobj:
+			m_CallSites.emplace_back();
+			break;
+		case VMInstruction::CallVirt:
+			m_CallSites.emplace_back().Method = VirtualMethodOf(String(instruction.B.String));
+			break;
+		case VMInstruction::StsFld:
+		case VMInstruction::LdSfld:
+			m_GlobalSites.emplace_back();
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+bool LinkedCode::Lower(VMInstruction opcode, const InstructionArguments& args, LinkedInstruction& out)
+{
+	switch (opcode)
+	{
+	case VMInstruction::Call_t:
+	case VMInstruction::Call:
+	case VMInstruction::Newobj:
+	{
+		out.C.Int = (TInt32)m_CallSites.size();
+		m_CallSites.emplace_back();
+
+		// [name] or [namespace, name]
+		if (args.size() == 1)
+			return InternArgument(args, 0, out.A.String);
+
+		if (args.size() == 2)
+			return InternArgument(args, 0, out.B.String) && InternArgument(args, 1, out.A.String);
+
+		return false;
+	}
+	case VMInstruction::NewArr:
+	{
+		// [type], [type, name] or [type, namespace, name]
+		if (args.empty() || !args[0].Is<TInt32>())
+			return false;
+
+		out.A.Int = args[0].AsInt32();
+		if (args.size() == 2)
+			return InternArgument(args, 1, out.C.String);
+
+		if (args.size() == 3)
+			return InternArgument(args, 1, out.B.String) && InternArgument(args, 2, out.C.String);
+
+		return args.size() == 1;
+	}
+	case VMInstruction::CallVirt:
+	{
+		if (args.size() != 2 || !args[0].Is<TInt32>())
+			return false;
+
+		out.A.Int = args[0].AsInt32();
+		if (!InternArgument(args, 1, out.B.String))
+			return false;
+
+		out.C.Int = (TInt32)m_CallSites.size();
+		m_CallSites.emplace_back().Method = VirtualMethodOf(String(out.B.String));
+		return true;
+	}
+	case VMInstruction::StsFld:
+	case VMInstruction::LdSfld:
+	{
+		if (args.empty() || !args[0].Is<TInt32>())
+			return false;
+
+		out.A.Int = args[0].AsInt32();
+		out.C.Int = (TInt32)m_GlobalSites.size();
+		m_GlobalSites.emplace_back();
+		if (args.size() == 2)
+			return InternArgument(args, 1, out.B.String);
+
+		return args.size() == 1;
+	}
+	case VMInstruction::AddStr:
+	case VMInstruction::Stloc:
+	case VMInstruction::StArg:
+	case VMInstruction::Ldloc:
+	case VMInstruction::Ldarg:
+	case VMInstruction::BrFalse:
+	case VMInstruction::BrTrue:
+	case VMInstruction::Br:
+	case VMInstruction::LdFld:
+	case VMInstruction::StFld:
+	case VMInstruction::ConvType:
+	case VMInstruction::Ldc_i4:
+	{
+		if (args.size() != 1 || !args[0].Is<TInt32>())
+			return false;
+
+		out.A.Int = args[0].AsInt32();
+		return true;
+	}
+	case VMInstruction::Ldc_r4:
+	{
+		if (args.size() != 1 || !args[0].Is<TFloat>())
+			return false;
+
+		out.A.Float = args[0].AsFloat();
+		return true;
+	}
+	case VMInstruction::Ldc_s:
+	{
+		if (args.size() != 1)
+			return false;
+
+		return InternArgument(args, 0, out.A.String);
+	}
+	case VMInstruction::LastInstruction:
+		return false;
+	default:
+		// No arguments
+		return args.empty();
+	}
+}
+
+// Value pushed by an integer constant load
+static bool ConstantOf(const LinkedInstruction& instruction, TInt32& out)
+{
+	if (instruction.Opcode >= VMInstruction::Ldc_i4_0 && instruction.Opcode <= VMInstruction::Ldc_i4_9)
+	{
+		out = (TInt32)instruction.Opcode - (TInt32)VMInstruction::Ldc_i4_0;
+		return true;
+	}
+
+	if (instruction.Opcode == VMInstruction::Ldc_i4)
+	{
+		out = instruction.A.Int;
+		return true;
+	}
+
+	return false;
+}
+
+// Constant added by ldc k; add|sub, sub is folded by negating the constant
+static bool AddedConstantOf(const LinkedInstruction& load, const LinkedInstruction& op, TInt32& out)
+{
+	TInt32 constant{ 0 };
+	if (!ConstantOf(load, constant))
+		return false;
+
+	if (op.Opcode == VMInstruction::Add_i4)
+	{
+		out = constant;
+		return true;
+	}
+
+	if (op.Opcode == VMInstruction::Sub_i4 && constant != std::numeric_limits<TInt32>::min())
+	{
+		out = -constant;
+		return true;
+	}
+
+	return false;
+}
+
+// Superinstruction branching when compare (followed by brtrue or brfalse) holds
+static VMInstruction CompareBranchOf(const LinkedInstruction& compare, const LinkedInstruction& branch, bool constant)
+{
+	bool onTrue = branch.Opcode == VMInstruction::BrTrue;
+	if (!onTrue && branch.Opcode != VMInstruction::BrFalse)
+		return VMInstruction::LastInstruction;
+
+	switch (compare.Opcode)
+	{
+	case VMInstruction::Clt_i4:
+		if (constant) return onTrue ? VMInstruction::BrLocLtC_i4 : VMInstruction::BrLocGeC_i4;
+		return onTrue ? VMInstruction::BrLocLt_i4 : VMInstruction::BrLocGe_i4;
+	case VMInstruction::Cgt_i4:
+		if (constant) return onTrue ? VMInstruction::BrLocGtC_i4 : VMInstruction::BrLocLeC_i4;
+		return onTrue ? VMInstruction::BrLocGt_i4 : VMInstruction::BrLocLe_i4;
+	case VMInstruction::Ceq_i4:
+		if (constant) return onTrue ? VMInstruction::BrLocEqC_i4 : VMInstruction::BrLocNeC_i4;
+		return onTrue ? VMInstruction::BrLocEq_i4 : VMInstruction::BrLocNe_i4;
+	default:
+		return VMInstruction::LastInstruction;
+	}
+}
+
+void LinkedCode::FuseSuperinstructions()
+{
+	// Sequences are matched on the original instructions following index, those are never replaced before
+	for (size_t i{ 0 }; i < m_Instructions.size(); i++)
+	{
+		LinkedInstruction fused{};
+		if (FuseAt(i, fused))
+		{
+			m_Instructions[i] = fused;
+		}
+	}
+}
+
+bool LinkedCode::FuseAt(size_t index, LinkedInstruction& out) const
+{
+	size_t remaining = m_Instructions.size() - index;
+	const LinkedInstruction* in = m_Instructions.data() + index;
+	TInt32 constant{ 0 };
+
+	if (in[0].Opcode == VMInstruction::Ldarg)
+	{
+		if (remaining >= 3 && AddedConstantOf(in[1], in[2], constant))
+		{
+			out = { VMInstruction::LdargAddC_i4, in[0].A, { constant }, {} };
+			return true;
+		}
+
+		return false;
+	}
+
+	if (in[0].Opcode != VMInstruction::Ldloc || remaining < 2)
+		return false;
+
+	// Longest sequences first
+	if (remaining >= 4)
+	{
+		bool constantOperand = ConstantOf(in[1], constant);
+		if (constantOperand || in[1].Opcode == VMInstruction::Ldloc)
+		{
+			VMInstruction opcode = CompareBranchOf(in[2], in[3], constantOperand);
+			if (opcode != VMInstruction::LastInstruction)
+			{
+				LinkedOperand second{};
+				second.Int = constantOperand ? constant : in[1].A.Int;
+				out = { opcode, in[0].A, second, in[3].A };
+				return true;
+			}
+		}
+
+		if (in[3].Opcode == VMInstruction::Stloc && AddedConstantOf(in[1], in[2], constant))
+		{
+			out = { VMInstruction::IncLoc_i4, in[0].A, { constant }, in[3].A };
+			return true;
+		}
+	}
+
+	if (remaining >= 3 && AddedConstantOf(in[1], in[2], constant))
+	{
+		out = { VMInstruction::LdlocAddC_i4, in[0].A, { constant }, {} };
+		return true;
+	}
+
+	if (in[1].Opcode == VMInstruction::Ldloc)
+	{
+		out = { VMInstruction::Ldloc2, in[0].A, in[1].A, {} };
+		return true;
+	}
+
+	return false;
+}
+
+bool LinkedCode::InternArgument(const InstructionArguments& args, size_t index, StringId& out)
+{
+	const TString* str = args[index].GetIf<TString>();
+	if (str == nullptr)
+		return false;
+
+	out = Intern(SharedString::Intern(*str));
+	return true;
+}
+
+StringId LinkedCode::Intern(SharedString* str)
+{
+	auto it = m_StringLookup.find(str);
+	if (it != m_StringLookup.end())
+		return it->second;
+
+	StringId id = (StringId)m_Strings.size();
+	m_Strings.push_back(str);
+	m_StringLookup.insert(std::make_pair(str, id));
+	return id;
+}
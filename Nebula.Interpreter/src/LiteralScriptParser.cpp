@@ -1,7 +1,8 @@
 #include "LiteralScriptParser.h"
 
+#include <algorithm>
 #include <cassert>
-#include <cwctype>
+#include <cctype>
 #include <format>
 
 #include "Script.h"
@@ -125,7 +126,7 @@ bool LiteralScriptParser::ParseGlobals()
 	SkipWhitespace(true);
 	while (Current() != ']' && Current() != '\n' && Current() != '\r')
 	{
-		std::string name;
+		std::string_view name;
 		if (!ReadLiteralUntil(name, ':', true))
 		{
 			return false;
@@ -141,7 +142,7 @@ bool LiteralScriptParser::ParseGlobals()
 		{
 			return false;
 		}
-		this->m_ScriptBuilder->AddGlobal(name, index);
+		this->m_ScriptBuilder->AddGlobal(std::string{ name }, index);
 
 		if (Peek(","))
 		{
@@ -166,13 +167,13 @@ bool LiteralScriptParser::ParseFunction()
 	if (!ParseType(returnType))
 		return false;
 
-	std::string funcName;
+	std::string_view funcName;
 	if (!ReadLiteralUntil(funcName, '(')) {
 		m_Report.ReportError("Could not read function name.");
 		return false;
 	}
 
-	Function newFunc{ m_ScriptBuilder->Get(), returnType, funcName };
+	Function newFunc{ m_ScriptBuilder->Get(), returnType, std::string{ funcName } };
 
 	if (!ParseFunctionParameters(&newFunc))
 	{
@@ -197,7 +198,7 @@ bool LiteralScriptParser::ParseFunction()
 
 bool LiteralScriptParser::ParseType(DataStackVariantIndex& result, char stopAt)
 {
-	std::string strType;
+	std::string_view strType;
 	if (!ReadLiteralUntil(strType, stopAt, true)) {
 		m_Report.ReportError("Could not read type identifier.");
 		return false;
@@ -228,7 +229,7 @@ bool LiteralScriptParser::ParseFunctionParameters(Function* newFunc)
 		if (!ParseType(type))
 			return false;
 
-		std::string paramName;
+		std::string_view paramName;
 		ReadLiteral(paramName, true);
 
 		newFunc->AddParameter(type);
@@ -255,13 +256,13 @@ bool LiteralScriptParser::ParseFunctionAttributes(Function* newFunc)
 	// One or more attributes present?
 	while (MatchIfNext(";"))
 	{
-		std::string out;
+		std::string_view out;
 		if (!ReadLiteral(out)) {
 			return false;
 		}
 
 		VMAttribute attr;
-		if (!stoattr(out.data(), attr)) {
+		if (!stoattr(out, attr)) {
 			ReportUnknownAttribute(out, m_CurrentDataIndex - out.size());
 			return false;
 		}
@@ -271,6 +272,19 @@ bool LiteralScriptParser::ParseFunctionAttributes(Function* newFunc)
 	return true;
 }
 
+uint32_t LiteralScriptParser::CurrentLine()
+{
+	// Lines are counted incrementally, the parser never goes back
+	size_t end = std::min(m_CurrentDataIndex, m_CurrentData.size());
+	if (end > m_LineCountedUpTo)
+	{
+		m_CurrentLine += (uint32_t)std::count(m_CurrentData.begin() + m_LineCountedUpTo, m_CurrentData.begin() + end, '\n');
+		m_LineCountedUpTo = end;
+	}
+
+	return m_CurrentLine;
+}
+
 bool LiteralScriptParser::ParseFunctionBody(Function* newFunc)
 {
 	if (!MatchWord("{")) {
@@ -284,10 +298,13 @@ bool LiteralScriptParser::ParseFunctionBody(Function* newFunc)
 		return false;
 	}
 
-	while (Current() != '}')
+	std::vector<uint32_t> lines;
+	while (m_CurrentDataIndex < m_CurrentData.size() && Current() != '}')
 	{
 		// Each line is an instruction
-		std::string num;
+		SkipWhitespace();
+		uint32_t line = CurrentLine();
+		std::string_view num;
 		ReadLiteral(num);
 
 		if (num.starts_with('#'))
@@ -296,7 +313,7 @@ bool LiteralScriptParser::ParseFunctionBody(Function* newFunc)
 			continue;
 		}
 
-		std::string instName;
+		std::string_view instName;
 		ReadLiteral(instName);
 
 		VMInstruction opcode;
@@ -309,12 +326,14 @@ bool LiteralScriptParser::ParseFunctionBody(Function* newFunc)
 			return false;
 		}
 
-		newFunc->AppendInstruction(std::make_pair(opcode, args));
+		newFunc->AppendInstruction(std::make_pair(opcode, std::move(args)));
+		lines.push_back(line);
 
 		m_CurrentDataIndex++;
 		SkipWhitespace();
 	}
 	// Read body!
+	newFunc->SetSourceLines(std::move(lines));
 
 	if (!MatchWord("}"))
 	{
@@ -330,7 +349,7 @@ bool LiteralScriptParser::ParseFunctionSpecialData(Function* newFunc)
 {
 	while (MatchIfNext("."))
 	{
-		std::string specialDataMarker;
+		std::string_view specialDataMarker;
 		if (!ReadLiteral(specialDataMarker))
 		{
 			return false;
@@ -389,7 +408,7 @@ bool LiteralScriptParser::ParseFunctionLocals(Function* newFunc)
 
 bool LiteralScriptParser::ParseBundleDefinitions()
 {
-	std::string bundleName;
+	std::string_view bundleName;
 	if (!ReadLiteralUntil(bundleName, '(', true))
 	{
 		ReportUnexpectedCharacter(m_CurrentDataIndex, "(");
@@ -404,12 +423,12 @@ bool LiteralScriptParser::ParseBundleDefinitions()
 
 	SkipWhitespace(true);
 
-	BundleDefinition newBundle(bundleName);
+	BundleDefinition newBundle(std::string{ bundleName });
 	// Parse all fields
 	while (Current() != ')')
 	{
 		DataStackVariantIndex fieldType;
-		std::string fieldName;
+		std::string_view fieldName;
 		if (!ParseType(fieldType))
 		{
 			ReportUnexpectedCharacter(m_CurrentDataIndex, "type - " + fieldType);
@@ -422,7 +441,7 @@ bool LiteralScriptParser::ParseBundleDefinitions()
 			return false;
 		}
 
-		BundleFieldDefinition field(fieldName, (DataStackVariantIndex)fieldType);
+		BundleFieldDefinition field(std::string{ fieldName }, (DataStackVariantIndex)fieldType);
 		newBundle.AddField(field);
 
 		// Peek skips whitespace
@@ -441,13 +460,13 @@ bool LiteralScriptParser::ParseBundleDefinitions()
 
 bool LiteralScriptParser::ParseInstructionArguments(VMInstruction opcode, InstructionArguments& out)
 {
-	// Read entire line
-	std::vector<std::string> litArguments;
+	// Read entire line, strings may span more than one
+	m_Arguments.clear();
 	SkipWhitespace(true);
-	while (Current() != '\n' && Current() != '\r')
+	while (m_CurrentDataIndex < m_CurrentData.size() && Current() != '\n' && Current() != '\r')
 	{
-		std::string lit;
-		if (Peek("\""))
+		std::string_view lit;
+		if (Current() == '\"')
 		{
 			ReadString(lit);
 		}
@@ -456,20 +475,27 @@ bool LiteralScriptParser::ParseInstructionArguments(VMInstruction opcode, Instru
 			ReadLiteral(lit, true);
 		}
 
-
-		litArguments.push_back(lit);
+		m_Arguments.push_back(lit);
+		SkipWhitespace(true);
 	}
 
-	out = GenerateArgumentsForOpcode(opcode, litArguments);
+	out = GenerateArgumentsForOpcode(opcode, m_Arguments);
 	return true;
 }
 
+// Same characters as std::iswspace in the "C" locale, text outside of ASCII is never whitespace
+static inline bool IsWhitespace(char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
 void LiteralScriptParser::SkipWhitespace(bool stopAtEndOfLine)
 {
-	while (m_CurrentDataIndex < m_CurrentData.size())
+	const size_t size = m_CurrentData.size();
+	while (m_CurrentDataIndex < size)
 	{
-		char c = Current();
-		if (!std::iswspace(c))
+		char c = m_CurrentData[m_CurrentDataIndex];
+		if (!IsWhitespace(c))
 		{
 			break;
 		}
@@ -486,26 +512,27 @@ void LiteralScriptParser::SkipWhitespace(bool stopAtEndOfLine)
 
 void LiteralScriptParser::SkipLine()
 {
-	while (m_CurrentDataIndex < m_CurrentData.size())
-	{
-		char c = Current();
-		if (c == '\n' || c == '\r')
-			break;
+	if (m_CurrentDataIndex >= m_CurrentData.size())
+		return;
 
-		m_CurrentDataIndex++;
-	}
+	m_CurrentDataIndex = std::min(m_CurrentData.find_first_of("\r\n", m_CurrentDataIndex), m_CurrentData.size());
+}
+
+bool LiteralScriptParser::IsNext(const std::string_view& word) const
+{
+	return m_CurrentDataIndex <= m_CurrentData.size() && m_CurrentData.substr(m_CurrentDataIndex).starts_with(word);
 }
 
 bool LiteralScriptParser::Peek(const std::string_view& c)
 {
 	SkipWhitespace();
-	return m_CurrentData.find(c.data(), m_CurrentDataIndex, c.size()) == m_CurrentDataIndex;
+	return IsNext(c);
 }
 
 bool LiteralScriptParser::MatchIfNext(const std::string_view& word)
 {
 	SkipWhitespace();
-	if (m_CurrentData.find(word.data(), m_CurrentDataIndex, word.size()) == m_CurrentDataIndex) {
+	if (IsNext(word)) {
 		m_CurrentDataIndex += word.size();
 		return true;
 	}
@@ -516,7 +543,7 @@ bool LiteralScriptParser::MatchWord(const std::string_view& word)
 {
 	SkipWhitespace();
 
-	if (m_CurrentData.find(word.data(), m_CurrentDataIndex, word.size()) == m_CurrentDataIndex) {
+	if (IsNext(word)) {
 		m_CurrentDataIndex += word.size();
 		return true;
 	}
@@ -525,27 +552,41 @@ bool LiteralScriptParser::MatchWord(const std::string_view& word)
 	return false;
 }
 
-bool LiteralScriptParser::ReadLiteral(std::string& out, bool stopAtNewline)
+bool LiteralScriptParser::ReadLiteral(std::string_view& out, bool stopAtNewline)
 {
 	SkipWhitespace(stopAtNewline);
-	while (!std::iswspace(Current()))
+	if (m_CurrentDataIndex >= m_CurrentData.size())
+	{
+		out = {};
+		return false;
+	}
+
+	size_t start = m_CurrentDataIndex;
+	while (m_CurrentDataIndex < m_CurrentData.size() && !IsWhitespace(m_CurrentData[m_CurrentDataIndex]))
 	{
-		out += Current();
 		m_CurrentDataIndex++;
 	}
 
+	out = m_CurrentData.substr(start, m_CurrentDataIndex - start);
 	return out.size() > 0;
 }
 
-bool LiteralScriptParser::ReadLiteralUntil(std::string& out, char c, bool stopAtNewline)
+bool LiteralScriptParser::ReadLiteralUntil(std::string_view& out, char c, bool stopAtNewline)
 {
 	SkipWhitespace(stopAtNewline);
-	while (!std::iswspace(Current()) && Current() != c)
+	if (m_CurrentDataIndex >= m_CurrentData.size())
+	{
+		out = {};
+		return false;
+	}
+
+	size_t start = m_CurrentDataIndex;
+	while (m_CurrentDataIndex < m_CurrentData.size() && !IsWhitespace(m_CurrentData[m_CurrentDataIndex]) && m_CurrentData[m_CurrentDataIndex] != c)
 	{
-		out += Current();
 		m_CurrentDataIndex++;
 	}
 
+	out = m_CurrentData.substr(start, m_CurrentDataIndex - start);
 	return out.size() > 0;
 }
 
@@ -5,6 +5,7 @@
 #include "DiagnosticReport.h"
 #include "LanguageTypes.h"
 #include "InstructionDefs.h"
+#include "Instruction.h"
 
 
 namespace nebula
@@ -42,14 +43,24 @@ namespace nebula::parsing
 
         void SkipWhitespace(bool stopAtEndOfLine = false);
         void SkipLine();
+        bool IsNext(const std::string_view&) const;
         bool Peek(const std::string_view&);
         bool MatchIfNext(const std::string_view&);
         bool MatchWord(const std::string_view&);
 
-        bool ReadLiteral(std::string&, bool = false);
-        bool ReadLiteralUntil(std::string&, char c, bool = false);
+        // Literals are views of the data being parsed, nothing is copied until a definition keeps them
+        bool ReadLiteral(std::string_view&, bool = false);
+        bool ReadLiteralUntil(std::string_view&, char c, bool = false);
         bool ReadInt(TInt32& i);
         bool ReadFloat(TFloat& f);
+
+        // Line (1 based) of the current character
+        uint32_t CurrentLine();
+
+        // Arguments of the instruction being parsed, reused so that parsing one doesn't allocate
+        RawArguments m_Arguments;
+        size_t m_LineCountedUpTo{ 0 };
+        uint32_t m_CurrentLine{ 1 };
     };
 }
 
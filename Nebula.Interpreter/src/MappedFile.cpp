@@ -0,0 +1,132 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace nebula;
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& filePath)
+{
+	Close();
+
+	HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	m_File = file;
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(file, &size))
+	{
+		Close();
+		return false;
+	}
+
+	// Empty files can't be mapped
+	if (size.QuadPart == 0)
+		return true;
+
+	m_Mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_Mapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	m_Data = static_cast<const char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_Data == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	m_Size = (size_t)size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_Data != nullptr)
+	{
+		UnmapViewOfFile(m_Data);
+	}
+
+	if (m_Mapping != nullptr)
+	{
+		CloseHandle(m_Mapping);
+	}
+
+	if (m_File != nullptr)
+	{
+		CloseHandle(m_File);
+	}
+
+	m_Data = nullptr;
+	m_Size = 0;
+	m_Mapping = nullptr;
+	m_File = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& filePath)
+{
+	Close();
+
+	int file = open(filePath.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat info {};
+	if (fstat(file, &info) != 0)
+	{
+		close(file);
+		return false;
+	}
+
+	// Empty files can't be mapped
+	if (info.st_size > 0)
+	{
+		void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (data == MAP_FAILED)
+		{
+			close(file);
+			return false;
+		}
+
+		m_Data = static_cast<const char*>(data);
+		m_Size = (size_t)info.st_size;
+	}
+
+	// The mapping keeps the file alive
+	close(file);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_Data != nullptr)
+	{
+		munmap(const_cast<char*>(m_Data), m_Size);
+	}
+
+	m_Data = nullptr;
+	m_Size = 0;
+}
+
+#endif // !_WIN32
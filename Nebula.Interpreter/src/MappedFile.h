@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace nebula
+{
+	// Read-only view of a whole file mapped in memory, pages are only read from disk when touched.
+	// The view is valid until the file is closed or the object destroyed
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		// Returns false if the file can't be opened or mapped, an empty file gives an empty view
+		bool Open(const std::string& filePath);
+		void Close();
+
+		inline std::string_view View() const { return { m_Data, m_Size }; }
+
+	private:
+		const char* m_Data{ nullptr };
+		size_t m_Size{ 0 };
+#ifdef _WIN32
+		void* m_File{ nullptr };
+		void* m_Mapping{ nullptr };
+#endif
+	};
+}
@@ -0,0 +1,86 @@
+#include <map>
+#include <string>
+#include <algorithm>
+
+#include "OpcodeProfiler.h"
+#include "Function.h"
+
+using namespace nebula;
+
+// Instructions after these aren't executed right after them
+static bool EndsSequence(VMInstruction opcode)
+{
+	switch (opcode)
+	{
+	case VMInstruction::Ret:
+	case VMInstruction::Br:
+	case VMInstruction::BrTrue:
+	case VMInstruction::BrFalse:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void OpcodeProfiler::Record(const Function* function, size_t instructionIndex)
+{
+	if (function != m_LastFunction)
+	{
+		std::vector<size_t>& counts = m_Counts[function];
+		if (counts.empty())
+		{
+			counts.resize(function->Code().Size());
+		}
+
+		m_LastFunction = function;
+		m_LastCounts = &counts;
+	}
+
+	(*m_LastCounts)[instructionIndex]++;
+}
+
+void OpcodeProfiler::Clear()
+{
+	m_Counts.clear();
+	m_LastFunction = nullptr;
+	m_LastCounts = nullptr;
+}
+
+void OpcodeProfiler::Dump(std::ostream& out, size_t maxLength, size_t top) const
+{
+	std::map<std::string, size_t> sequences;
+	for (const auto& kvp : m_Counts)
+	{
+		const LinkedCode& code = kvp.first->Code();
+		const std::vector<size_t>& counts = kvp.second;
+
+		for (size_t begin{ 0 }; begin < code.Size(); begin++)
+		{
+			size_t count = counts[begin];
+			std::string sequence = itos(UnfusedOpcode(code[begin].Opcode));
+
+			for (size_t end{ begin + 1 }; end < code.Size() && end - begin < maxLength; end++)
+			{
+				if (EndsSequence(UnfusedOpcode(code[end - 1].Opcode)))
+					break;
+
+				count = std::min(count, counts[end]);
+				if (count == 0)
+					break;
+
+				sequence += "; ";
+				sequence += itos(UnfusedOpcode(code[end].Opcode));
+				sequences[sequence] += count;
+			}
+		}
+	}
+
+	std::vector<std::pair<std::string, size_t>> sorted{ sequences.begin(), sequences.end() };
+	std::stable_sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+
+	size_t printed = std::min(top, sorted.size());
+	for (size_t i{ 0 }; i < printed; i++)
+	{
+		out << sorted[i].second << "\t" << sorted[i].first << "\n";
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nebula
+{
+	// Calls func(index) for every index in [0, count) on up to threadCount threads, 0 to use every core.
+	// The calling thread takes part in the work, indices are handed out one at a time so uneven work stays balanced.
+	// Returns once every call completed, the first exception thrown by func is rethrown then
+	template<typename TFunc>
+	void ParallelFor(size_t count, size_t threadCount, TFunc&& func)
+	{
+		if (threadCount == 0)
+		{
+			threadCount = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+		}
+
+		threadCount = std::min(threadCount, count);
+		if (threadCount <= 1)
+		{
+			for (size_t i{ 0 }; i < count; i++)
+			{
+				func(i);
+			}
+			return;
+		}
+
+		std::atomic<size_t> next{ 0 };
+		std::exception_ptr error;
+		std::mutex errorMutex;
+
+		auto worker = [&]() {
+			for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+			{
+				try
+				{
+					func(i);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock{ errorMutex };
+					if (!error)
+					{
+						error = std::current_exception();
+					}
+				}
+			}
+		};
+
+		{
+			std::vector<std::jthread> threads;
+			threads.reserve(threadCount - 1);
+			for (size_t t{ 1 }; t < threadCount; t++)
+			{
+				threads.emplace_back(worker);
+			}
+
+			worker();
+		}
+
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+}
@@ -0,0 +1,541 @@
+#include <cassert>
+#include <limits>
+
+#include "RegisterCode.h"
+#include "Function.h"
+#include "Frame.h"
+
+using namespace nebula;
+
+// Operand stack value the translation hasn't written to its slot yet
+struct PendingValue
+{
+	enum class Source
+	{
+		Slot,		// Already in its stack slot
+		Register,	// Load of a variable
+		Int,
+		Float,
+	};
+
+	Source From{ Source::Slot };
+	LinkedOperand Value{};
+	DataStackVariantIndex Type{ _UnknownType };
+	// Register instruction that wrote the slot, -1 if it can't be retargeted
+	TInt32 Producer{ -1 };
+};
+
+static bool IsRegisterType(DataStackVariantIndex type)
+{
+	return type == _TypeInt32 || type == _TypeFloat;
+}
+
+// Keeps the operand stack of the linked code as pending values while walking a block,
+// they are only written to their slot when an instruction needs them there
+class RegisterTranslator
+{
+public:
+	RegisterTranslator(const Function& function, const std::vector<size_t>& heights, std::vector<RegisterInstruction>& out, std::vector<TInt32>& entries)
+		: m_Function{ function }, m_Code{ function.Code() }, m_Heights{ heights }, m_Out{ out }, m_Entries{ entries }
+	{
+	}
+
+	// Returns false if no instruction was translated
+	bool Run();
+
+private:
+	void Translate(size_t index, bool& synced);
+	void Fallback(size_t index);
+	void Load(DataStackVariantIndex type, TInt32 variable);
+	void Store(DataStackVariantIndex type, TInt32 variable);
+	void Binary(size_t index, RegisterOp op, RegisterOp constantOp, DataStackVariantIndex type, bool commutative);
+	void CompareAndBranch(size_t index, RegisterOp op, RegisterOp constantOp, TInt32 target);
+	void Branch(size_t index, RegisterOp op, TInt32 target, TInt32 condition);
+
+	TInt32 Emit(const RegisterInstruction& instruction);
+	TInt32 EmitCheckpoint(RegisterInstruction instruction);
+	void Materialize(size_t position);
+	void Flush();
+	void Reset(size_t height);
+
+	TInt32 RegisterOf(size_t position);
+	bool ConstantOf(size_t position, TInt32& out) const;
+	TInt32 StackRegister(size_t slot) const { return Frame::StackRegister(&m_Function, slot); }
+
+	const Function& m_Function;
+	const LinkedCode& m_Code;
+	const std::vector<size_t>& m_Heights;
+	std::vector<RegisterInstruction>& m_Out;
+	std::vector<TInt32>& m_Entries;
+
+	std::vector<PendingValue> m_Stack;
+	TInt32 m_SinceCheckpoint{ 0 };
+	size_t m_Translated{ 0 };
+};
+
+std::unique_ptr<RegisterCode> RegisterCode::Translate(const Function& function)
+{
+	// Translation relies on the operand types and stack heights proven by the verifier,
+	// temporaries live in the stack slots of the frame allocation
+	if (!function.IsVerified() || function.m_StackHeights.size() != function.Code().Size() || function.Code().Empty())
+		return nullptr;
+
+	if (function.MaxStackDepth() > Frame::MaxReservedStackDepth)
+		return nullptr;
+
+	auto code = std::make_unique<RegisterCode>();
+	RegisterTranslator translator{ function, function.m_StackHeights, code->m_Instructions, code->m_Entries };
+	if (!translator.Run())
+		return nullptr;
+
+	return code;
+}
+
+bool RegisterTranslator::Run()
+{
+	const size_t count = m_Code.Size();
+	m_Entries.assign(count, -1);
+
+	std::vector<bool> targets(count, false);
+	for (size_t i{ 0 }; i < count; i++)
+	{
+		// The verifier never checked the branches it didn't reach
+		if (m_Heights[i] == Function::UnreachedStackHeight)
+			continue;
+
+		switch (m_Code[i].Opcode)
+		{
+		case VMInstruction::Br:
+		case VMInstruction::BrTrue:
+		case VMInstruction::BrFalse:
+		{
+			TInt32 target = m_Code[i].A.Int;
+			if (target < 0 || (size_t)target >= count)
+				return false;
+
+			targets[target] = true;
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	bool synced = true;
+	for (size_t i{ 0 }; i < count; i++)
+	{
+		// Never executed, nothing to translate
+		if (m_Heights[i] == Function::UnreachedStackHeight)
+		{
+			synced = true;
+			continue;
+		}
+
+		// Blocks start with every value in its slot, the execution can move between tiers there
+		if (synced || targets[i])
+		{
+			Flush();
+			Reset(m_Heights[i]);
+			m_Entries[i] = (TInt32)m_Out.size();
+			synced = false;
+		}
+
+		// Compare and branch only fuse if nothing jumps to the branch
+		if (i + 1 < count && targets[i + 1])
+		{
+			Translate(i, synced);
+			continue;
+		}
+
+		VMInstruction opcode = m_Code[i].Opcode;
+		VMInstruction next = i + 1 < count ? m_Code[i + 1].Opcode : VMInstruction::Nop;
+		if ((next == VMInstruction::BrTrue || next == VMInstruction::BrFalse) && m_Stack.size() >= 2)
+		{
+			bool onTrue = next == VMInstruction::BrTrue;
+			TInt32 target = m_Code[i + 1].A.Int;
+			bool fused = true;
+			switch (opcode)
+			{
+			case VMInstruction::Clt_i4:
+				CompareAndBranch(i + 1, onTrue ? RegisterOp::BrLtI : RegisterOp::BrGeI, onTrue ? RegisterOp::BrLtIC : RegisterOp::BrGeIC, target);
+				break;
+			case VMInstruction::Cgt_i4:
+				CompareAndBranch(i + 1, onTrue ? RegisterOp::BrGtI : RegisterOp::BrLeI, onTrue ? RegisterOp::BrGtIC : RegisterOp::BrLeIC, target);
+				break;
+			case VMInstruction::Ceq_i4:
+				CompareAndBranch(i + 1, onTrue ? RegisterOp::BrEqI : RegisterOp::BrNeI, onTrue ? RegisterOp::BrEqIC : RegisterOp::BrNeIC, target);
+				break;
+			default:
+				fused = false;
+				break;
+			}
+
+			if (fused)
+			{
+				i++;
+				synced = true;
+				continue;
+			}
+		}
+
+		Translate(i, synced);
+	}
+
+	// Branch targets are all block starts
+	for (RegisterInstruction& instruction : m_Out)
+	{
+		if (instruction.Opcode >= RegisterOp::Br && instruction.Opcode < RegisterOp::LastOp)
+		{
+			instruction.Target = m_Entries[instruction.Dst];
+			assert(instruction.Target >= 0);
+		}
+	}
+
+	return m_Translated > 0;
+}
+
+void RegisterTranslator::Translate(size_t index, bool& synced)
+{
+	const LinkedInstruction& instruction = m_Code[index];
+	const VariableList& params = m_Function.Parameters();
+	const VariableList& locals = m_Function.Locals();
+
+	// Superinstructions are translated as the sequence they replaced, the rest of it follows them
+	VMInstruction opcode = UnfusedOpcode(instruction.Opcode);
+	switch (opcode)
+	{
+	case VMInstruction::Nop:
+		return;
+	case VMInstruction::Ldc_i4_0:
+	case VMInstruction::Ldc_i4_1:
+	case VMInstruction::Ldc_i4_2:
+	case VMInstruction::Ldc_i4_3:
+	case VMInstruction::Ldc_i4_4:
+	case VMInstruction::Ldc_i4_5:
+	case VMInstruction::Ldc_i4_6:
+	case VMInstruction::Ldc_i4_7:
+	case VMInstruction::Ldc_i4_8:
+	case VMInstruction::Ldc_i4_9:
+	{
+		PendingValue value{ PendingValue::Source::Int, {}, _TypeInt32 };
+		value.Value.Int = (TInt32)opcode - (TInt32)VMInstruction::Ldc_i4_0;
+		m_Stack.push_back(value);
+		m_Translated++;
+		return;
+	}
+	case VMInstruction::Ldc_i4:
+		m_Stack.push_back({ PendingValue::Source::Int, instruction.A, _TypeInt32 });
+		m_Translated++;
+		return;
+	case VMInstruction::Ldc_r4:
+		m_Stack.push_back({ PendingValue::Source::Float, instruction.A, _TypeFloat });
+		m_Translated++;
+		return;
+	case VMInstruction::Ldloc:
+		if (!IsRegisterType(locals[instruction.A.Int]))
+			break;
+
+		Load(locals[instruction.A.Int], Frame::VariableRegister(params.size() + instruction.A.Int));
+		return;
+	case VMInstruction::Ldarg:
+		if (!IsRegisterType(params[instruction.A.Int]))
+			break;
+
+		Load(params[instruction.A.Int], Frame::VariableRegister(instruction.A.Int));
+		return;
+	case VMInstruction::Stloc:
+		if (!IsRegisterType(locals[instruction.A.Int]))
+			break;
+
+		Store(locals[instruction.A.Int], Frame::VariableRegister(params.size() + instruction.A.Int));
+		return;
+	case VMInstruction::StArg:
+		if (!IsRegisterType(params[instruction.A.Int]))
+			break;
+
+		Store(params[instruction.A.Int], Frame::VariableRegister(instruction.A.Int));
+		return;
+	case VMInstruction::Pop:
+		// Values in registers are simply dropped, the slot of anything else must be destroyed
+		if (m_Stack.back().From == PendingValue::Source::Slot && !IsRegisterType(m_Stack.back().Type))
+			break;
+
+		m_Stack.pop_back();
+		m_Translated++;
+		return;
+	case VMInstruction::Add_i4:
+		Binary(index, RegisterOp::AddI, RegisterOp::AddIC, _TypeInt32, true);
+		return;
+	case VMInstruction::Sub_i4:
+		Binary(index, RegisterOp::SubI, RegisterOp::AddIC, _TypeInt32, false);
+		return;
+	case VMInstruction::Mul_i4:
+		Binary(index, RegisterOp::MulI, RegisterOp::MulIC, _TypeInt32, true);
+		return;
+	case VMInstruction::Div_i4:
+		Binary(index, RegisterOp::DivI, RegisterOp::LastOp, _TypeInt32, false);
+		return;
+	case VMInstruction::Add_r4:
+		Binary(index, RegisterOp::AddF, RegisterOp::LastOp, _TypeFloat, false);
+		return;
+	case VMInstruction::Sub_r4:
+		Binary(index, RegisterOp::SubF, RegisterOp::LastOp, _TypeFloat, false);
+		return;
+	case VMInstruction::Mul_r4:
+		Binary(index, RegisterOp::MulF, RegisterOp::LastOp, _TypeFloat, false);
+		return;
+	case VMInstruction::Div_r4:
+		Binary(index, RegisterOp::DivF, RegisterOp::LastOp, _TypeFloat, false);
+		return;
+	case VMInstruction::Ceq_i4:
+		Binary(index, RegisterOp::CeqI, RegisterOp::CeqIC, _TypeInt32, true);
+		return;
+	case VMInstruction::Clt_i4:
+		Binary(index, RegisterOp::CltI, RegisterOp::CltIC, _TypeInt32, false);
+		return;
+	case VMInstruction::Cgt_i4:
+		Binary(index, RegisterOp::CgtI, RegisterOp::CgtIC, _TypeInt32, false);
+		return;
+	case VMInstruction::Br:
+		Branch(index, RegisterOp::Br, instruction.A.Int, 0);
+		synced = true;
+		return;
+	case VMInstruction::BrTrue:
+	case VMInstruction::BrFalse:
+	{
+		TInt32 condition = RegisterOf(m_Stack.size() - 1);
+		m_Stack.pop_back();
+		Branch(index, opcode == VMInstruction::BrTrue ? RegisterOp::BrTrue : RegisterOp::BrFalse, instruction.A.Int, condition);
+		synced = true;
+		return;
+	}
+	default:
+		break;
+	}
+
+	Fallback(index);
+	synced = true;
+}
+
+void RegisterTranslator::Fallback(size_t index)
+{
+	Flush();
+	assert(m_Stack.size() == m_Heights[index]);
+
+	RegisterInstruction instruction{ RegisterOp::Fallback };
+	instruction.Ip = (TInt32)index;
+	instruction.Depth = (TInt32)m_Heights[index];
+	EmitCheckpoint(instruction);
+}
+
+void RegisterTranslator::Load(DataStackVariantIndex type, TInt32 variable)
+{
+	PendingValue value{ PendingValue::Source::Register, {}, type };
+	value.Value.Int = variable;
+	m_Stack.push_back(value);
+	m_Translated++;
+}
+
+void RegisterTranslator::Store(DataStackVariantIndex type, TInt32 variable)
+{
+	size_t position = m_Stack.size() - 1;
+	PendingValue value = m_Stack.back();
+	m_Stack.pop_back();
+
+	// Loads of the variable that are still pending must read the value it holds now
+	for (size_t i{ 0 }; i < m_Stack.size(); i++)
+	{
+		if (m_Stack[i].From == PendingValue::Source::Register && m_Stack[i].Value.Int == variable)
+		{
+			Materialize(i);
+		}
+	}
+
+	m_Translated++;
+
+	// The instruction computing the value can write it to the variable itself if nothing ran since
+	if (value.From == PendingValue::Source::Slot && value.Producer >= 0 && (size_t)value.Producer + 1 == m_Out.size())
+	{
+		m_Out[value.Producer].Dst = variable;
+		return;
+	}
+
+	RegisterInstruction instruction{ RegisterOp::Mov };
+	instruction.Dst = variable;
+	switch (value.From)
+	{
+	case PendingValue::Source::Register:
+		if (value.Value.Int == variable)
+			return;
+
+		instruction.A = value.Value;
+		break;
+	case PendingValue::Source::Int:
+		instruction.Opcode = RegisterOp::LdcI;
+		instruction.A = value.Value;
+		break;
+	case PendingValue::Source::Float:
+		instruction.Opcode = RegisterOp::LdcF;
+		instruction.A = value.Value;
+		break;
+	case PendingValue::Source::Slot:
+		instruction.A.Int = StackRegister(position);
+		break;
+	}
+
+	// Verified code only stores values of the variable type
+	assert(value.Type == type || value.Type == _UnknownType);
+	Emit(instruction);
+}
+
+void RegisterTranslator::Binary(size_t index, RegisterOp op, RegisterOp constantOp, DataStackVariantIndex type, bool commutative)
+{
+	size_t b = m_Stack.size() - 1;
+	size_t a = b - 1;
+
+	TInt32 constant{ 0 };
+	size_t left = a;
+	size_t right = b;
+	if (commutative && ConstantOf(a, constant) && !ConstantOf(b, constant))
+	{
+		std::swap(left, right);
+	}
+
+	// Sub is an add of the negated constant
+	bool useConstant = constantOp != RegisterOp::LastOp && ConstantOf(right, constant);
+	if (useConstant && op == RegisterOp::SubI)
+	{
+		useConstant = constant != std::numeric_limits<TInt32>::min();
+		constant = -constant;
+	}
+
+	RegisterInstruction instruction{ useConstant ? constantOp : op };
+	instruction.Ip = (TInt32)index;
+	instruction.Dst = StackRegister(a);
+	instruction.A.Int = RegisterOf(left);
+	instruction.B.Int = useConstant ? constant : RegisterOf(right);
+
+	m_Stack.pop_back();
+	m_Stack.pop_back();
+	m_Translated++;
+
+	PendingValue result{ PendingValue::Source::Slot, {}, type };
+	result.Producer = Emit(instruction);
+	m_Stack.push_back(result);
+}
+
+void RegisterTranslator::CompareAndBranch(size_t index, RegisterOp op, RegisterOp constantOp, TInt32 target)
+{
+	size_t b = m_Stack.size() - 1;
+	size_t a = b - 1;
+
+	RegisterInstruction instruction{ op };
+	instruction.Ip = (TInt32)index;
+	instruction.Dst = target;
+
+	TInt32 constant{ 0 };
+	instruction.A.Int = RegisterOf(a);
+	if (ConstantOf(b, constant))
+	{
+		instruction.Opcode = constantOp;
+		instruction.B.Int = constant;
+	}
+	else
+	{
+		instruction.B.Int = RegisterOf(b);
+	}
+
+	m_Stack.pop_back();
+	m_Stack.pop_back();
+	m_Translated += 2;
+
+	Flush();
+	instruction.Depth = (TInt32)m_Stack.size();
+	EmitCheckpoint(instruction);
+}
+
+void RegisterTranslator::Branch(size_t index, RegisterOp op, TInt32 target, TInt32 condition)
+{
+	m_Translated++;
+	Flush();
+
+	RegisterInstruction instruction{ op };
+	instruction.Ip = (TInt32)index;
+	instruction.Dst = target;
+	instruction.A.Int = condition;
+	instruction.Depth = (TInt32)m_Stack.size();
+	EmitCheckpoint(instruction);
+}
+
+TInt32 RegisterTranslator::Emit(const RegisterInstruction& instruction)
+{
+	m_Out.push_back(instruction);
+	m_SinceCheckpoint++;
+	return (TInt32)m_Out.size() - 1;
+}
+
+TInt32 RegisterTranslator::EmitCheckpoint(RegisterInstruction instruction)
+{
+	instruction.Cost = m_SinceCheckpoint + 1;
+	m_SinceCheckpoint = 0;
+
+	m_Out.push_back(instruction);
+	return (TInt32)m_Out.size() - 1;
+}
+
+void RegisterTranslator::Materialize(size_t position)
+{
+	PendingValue& value = m_Stack[position];
+
+	RegisterInstruction instruction{ RegisterOp::Mov };
+	instruction.Dst = StackRegister(position);
+	instruction.A = value.Value;
+	switch (value.From)
+	{
+	case PendingValue::Source::Slot:
+		return;
+	case PendingValue::Source::Register:
+		break;
+	case PendingValue::Source::Int:
+		instruction.Opcode = RegisterOp::LdcI;
+		break;
+	case PendingValue::Source::Float:
+		instruction.Opcode = RegisterOp::LdcF;
+		break;
+	}
+
+	Emit(instruction);
+	value.From = PendingValue::Source::Slot;
+	value.Producer = -1;
+}
+
+void RegisterTranslator::Flush()
+{
+	for (size_t i{ 0 }; i < m_Stack.size(); i++)
+	{
+		Materialize(i);
+	}
+}
+
+void RegisterTranslator::Reset(size_t height)
+{
+	m_Stack.assign(height, PendingValue{});
+}
+
+TInt32 RegisterTranslator::RegisterOf(size_t position)
+{
+	if (m_Stack[position].From == PendingValue::Source::Register)
+		return m_Stack[position].Value.Int;
+
+	Materialize(position);
+	return StackRegister(position);
+}
+
+bool RegisterTranslator::ConstantOf(size_t position, TInt32& out) const
+{
+	if (m_Stack[position].From != PendingValue::Source::Int)
+		return false;
+
+	out = m_Stack[position].Value.Int;
+	return true;
+}
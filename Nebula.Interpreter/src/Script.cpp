@@ -6,6 +6,10 @@
 #include "Script.h"
 #include "interfaces\IScriptParser.h"
 #include "LiteralScriptParser.h"
+#include "ScriptImageParser.h"
+#include "ScriptImage.h"
+#include "MappedFile.h"
+#include "ParallelFor.h"
 #include "Function.h"
 #include "DebugServer.h"
 
@@ -13,6 +17,14 @@ using namespace nebula;
 
 ScriptLoadResult nebula::Script::FromFile(const std::string& filePath)
 {
+	// Images are read straight from the mapped file
+	MappedFile mapped;
+	if (mapped.Open(filePath) && ScriptImage::IsImage(mapped.View()))
+	{
+		return FromMemory(mapped.View(), filePath);
+	}
+
+	mapped.Close();
 	std::ifstream fs(filePath);
 
 	if (!fs.is_open() || fs.bad())
@@ -29,7 +41,15 @@ ScriptLoadResult nebula::Script::FromFile(const std::string& filePath)
 
 ScriptLoadResult nebula::Script::FromMemory(const std::string_view& data, const std::string& sourcePath)
 {
-	std::unique_ptr<IScriptParser> parser = std::make_unique<parsing::LiteralScriptParser>();
+	std::unique_ptr<IScriptParser> parser;
+	if (ScriptImage::IsImage(data))
+	{
+		parser = std::make_unique<parsing::ScriptImageParser>();
+	}
+	else
+	{
+		parser = std::make_unique<parsing::LiteralScriptParser>();
+	}
 
 	ScriptLoadResult result;
 	result.Script = parser->ParseScript(data);
@@ -41,6 +61,16 @@ ScriptLoadResult nebula::Script::FromMemory(const std::string_view& data, const
 	return result;
 }
 
+std::vector<ScriptLoadResult> nebula::Script::FromFiles(const std::vector<std::string>& filePaths, size_t threadCount)
+{
+	std::vector<ScriptLoadResult> results(filePaths.size());
+	ParallelFor(filePaths.size(), threadCount, [&](size_t i) {
+		results[i] = FromFile(filePaths[i]);
+	});
+
+	return results;
+}
+
 nebula::Script::~Script()
 {
 	if (DebugServer::Instance())
@@ -53,6 +83,17 @@ Script::Script()
 {
 }
 
+bool Script::Link()
+{
+	for (auto& kvp : m_Functions)
+	{
+		if (!kvp.second.Link())
+			return false;
+	}
+
+	return true;
+}
+
 ScriptBuilder::ScriptBuilder()
 {
 	m_InternalScript = new Script();
@@ -91,7 +132,7 @@ bool ScriptBuilder::AddFunction(Function&& func)
 		return false;
 	}
 
-	m_InternalScript->m_Functions.emplace(func.Name(), func);
+	m_InternalScript->m_Functions.emplace(func.Name(), std::move(func));
 	return true;
 }
 
@@ -0,0 +1,307 @@
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <random>
+
+#include "ScriptCache.h"
+#include "ScriptImage.h"
+#include "LinkedCode.h"
+#include "MappedFile.h"
+#include "ParallelFor.h"
+
+using namespace nebula;
+
+static_assert(std::endian::native == std::endian::little, "Entries are read and written as little endian words");
+
+static constexpr char EntryMagic[4]{ 'N', 'E', 'B', 'K' };
+static constexpr uint64_t ChecksumSeed = 0x6e6562636b73756dULL;
+
+// Every entry is this header followed by the image, then by the messages of the parsing report.
+// Each message is its report type and its length as words followed by its text
+struct EntryHeader
+{
+	char Magic[4];
+	uint32_t Version;
+	uint64_t Key;
+	uint64_t SourceSize;
+	uint64_t ImageSize;
+	uint64_t ReportSize;
+	uint64_t Checksum; // Of everything after the header
+};
+
+static_assert(sizeof(EntryHeader) == 48, "Entry headers must stay fixed-width");
+
+static constexpr uint64_t Prime1 = 0x9e3779b185ebca87ULL;
+static constexpr uint64_t Prime2 = 0xc2b2ae3d27d4eb4fULL;
+static constexpr uint64_t Prime3 = 0x165667b19e3779f9ULL;
+
+static inline uint64_t Round(uint64_t accumulator, uint64_t word)
+{
+	return std::rotl(accumulator + word * Prime2, 31) * Prime1;
+}
+
+static inline uint64_t Avalanche(uint64_t value)
+{
+	value ^= value >> 33;
+	value *= Prime2;
+	value ^= value >> 29;
+	value *= Prime3;
+	value ^= value >> 32;
+	return value;
+}
+
+// Not cryptographic, four independent lanes so that hashing keeps up with reading the file
+static uint64_t HashBytes(std::string_view data, uint64_t seed)
+{
+	const char* bytes = data.data();
+	size_t remaining = data.size();
+
+	uint64_t lanes[4]{ seed + Prime1 + Prime2, seed + Prime2, seed, seed - Prime1 };
+	while (remaining >= sizeof(lanes))
+	{
+		for (uint64_t& lane : lanes)
+		{
+			uint64_t word;
+			std::memcpy(&word, bytes, sizeof(word));
+			lane = Round(lane, word);
+			bytes += sizeof(word);
+		}
+		remaining -= sizeof(lanes);
+	}
+
+	uint64_t hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+	hash += data.size();
+
+	while (remaining >= sizeof(uint64_t))
+	{
+		uint64_t word;
+		std::memcpy(&word, bytes, sizeof(word));
+		hash = std::rotl(hash ^ Round(0, word), 27) * Prime1 + Prime3;
+		bytes += sizeof(word);
+		remaining -= sizeof(word);
+	}
+
+	while (remaining > 0)
+	{
+		hash = std::rotl(hash ^ ((uint64_t)(unsigned char)*bytes * Prime3), 11) * Prime1;
+		bytes++;
+		remaining--;
+	}
+
+	return Avalanche(hash);
+}
+
+ScriptCache::ScriptCache(std::string directory, bool debugLines)
+	: m_Directory{ std::move(directory) }, m_DebugLines{ debugLines }
+{
+	// Whatever changes the images a build writes must change the keys too
+	const uint64_t keyParts[]{
+		Version,
+		ScriptImage::Version,
+		(uint64_t)VMInstruction::LastInstruction,
+		sizeof(LinkedInstruction),
+		debugLines ? ScriptImage::DebugLines : ScriptImage::NoFlags,
+	};
+
+	m_KeySeed = HashBytes({ reinterpret_cast<const char*>(keyParts), sizeof(keyParts) }, 0);
+}
+
+// Only warnings and information are kept, scripts with errors are never stored
+static void WriteReport(const shared::DiagnosticReport& report, std::vector<char>& out)
+{
+	auto writeMessages = [&out](const std::vector<shared::Report>& messages)
+		{
+			for (const shared::Report& message : messages)
+			{
+				const uint32_t words[2]{ (uint32_t)message.Type(), (uint32_t)message.Message().size() };
+				out.insert(out.end(), reinterpret_cast<const char*>(words), reinterpret_cast<const char*>(words) + sizeof(words));
+				out.insert(out.end(), message.Message().begin(), message.Message().end());
+			}
+		};
+
+	writeMessages(report.Warnings());
+	writeMessages(report.Information());
+}
+
+static bool ReadReport(std::string_view data, shared::DiagnosticReport& report)
+{
+	while (!data.empty())
+	{
+		uint32_t words[2];
+		if (data.size() < sizeof(words))
+			return false;
+
+		std::memcpy(words, data.data(), sizeof(words));
+		data.remove_prefix(sizeof(words));
+		if (words[1] > data.size())
+			return false;
+
+		std::string message{ data.substr(0, words[1]) };
+		data.remove_prefix(words[1]);
+		switch ((shared::ReportType)words[0])
+		{
+		case shared::ReportType::Warning:
+			report.ReportWarning(message);
+			break;
+		case shared::ReportType::Information:
+			report.ReportInformation(message);
+			break;
+		default:
+			return false;
+		}
+	}
+
+	return true;
+}
+
+ScriptLoadResult ScriptCache::Load(const std::string& filePath)
+{
+	MappedFile source;
+	if (!source.Open(filePath) || ScriptImage::IsImage(source.View()))
+	{
+		// Images are already as fast to load as the cache, unreadable files are reported as usual
+		source.Close();
+		return Script::FromFile(filePath);
+	}
+
+	std::string_view text = source.View();
+	uint64_t key = HashBytes(text, m_KeySeed);
+	std::string entryPath = EntryPath(key);
+
+	ScriptLoadResult result = LoadEntry(entryPath, key, text, filePath);
+	if (result.Script != nullptr)
+	{
+		m_Hits++;
+		return result;
+	}
+
+	m_Misses++;
+	result = Script::FromMemory(text, filePath);
+	if (result.Script != nullptr)
+	{
+		StoreEntry(entryPath, key, text, *result.Script, result.ParsingReport);
+	}
+
+	return result;
+}
+
+std::vector<ScriptLoadResult> ScriptCache::LoadAll(const std::vector<std::string>& filePaths, size_t threadCount)
+{
+	std::vector<ScriptLoadResult> results(filePaths.size());
+	ParallelFor(filePaths.size(), threadCount, [&](size_t i) {
+		results[i] = Load(filePaths[i]);
+	});
+
+	return results;
+}
+
+std::string ScriptCache::EntryPath(uint64_t key) const
+{
+	return (std::filesystem::path{ m_Directory } / std::format("{:016x}.nebk", key)).string();
+}
+
+ScriptLoadResult ScriptCache::LoadEntry(const std::string& entryPath, uint64_t key, std::string_view source, const std::string& filePath) const
+{
+	ScriptLoadResult missed;
+	MappedFile entry;
+	if (!entry.Open(entryPath))
+		return missed;
+
+	std::string_view data = entry.View();
+	if (data.size() < sizeof(EntryHeader))
+		return missed;
+
+	EntryHeader header;
+	std::memcpy(&header, data.data(), sizeof(header));
+	std::string_view body = data.substr(sizeof(header));
+
+	bool valid = std::memcmp(header.Magic, EntryMagic, sizeof(EntryMagic)) == 0
+		&& header.Version == Version
+		&& header.Key == key
+		&& header.SourceSize == source.size()
+		&& header.ImageSize <= body.size()
+		&& header.ReportSize == body.size() - header.ImageSize
+		&& header.Checksum == HashBytes(body, ChecksumSeed);
+
+	if (!valid)
+		return missed;
+
+	// The parser messages come first, as if the text had been parsed
+	shared::DiagnosticReport report;
+	if (!ReadReport(body.substr(header.ImageSize), report))
+		return missed;
+
+	ScriptLoadResult loaded = Script::FromMemory(body.substr(0, header.ImageSize), filePath);
+	if (loaded.ParsingReport.Errors().size() > 0)
+	{
+		delete loaded.Script;
+		return missed;
+	}
+
+	loaded.ParsingReport = std::move(report);
+	return loaded;
+}
+
+void ScriptCache::StoreEntry(const std::string& entryPath, uint64_t key, std::string_view source, Script& script, shared::DiagnosticReport& report) const
+{
+	// Scripts that don't link are refused when added, there is nothing worth caching.
+	// Linking again once added to an interpreter starts over from the parsed instructions
+	if (!script.Link())
+		return;
+
+	std::vector<char> body;
+	shared::DiagnosticReport imageReport;
+	if (!ScriptImage::Write(script, body, imageReport, m_DebugLines))
+	{
+		report.ReportWarning(std::format("Script {} can't be cached as an image", script.GetSourcePath()));
+		return;
+	}
+
+	size_t imageSize = body.size();
+	WriteReport(report, body);
+
+	EntryHeader header{};
+	std::memcpy(header.Magic, EntryMagic, sizeof(EntryMagic));
+	header.Version = Version;
+	header.Key = key;
+	header.SourceSize = source.size();
+	header.ImageSize = imageSize;
+	header.ReportSize = body.size() - imageSize;
+	header.Checksum = HashBytes({ body.data(), body.size() }, ChecksumSeed);
+
+	// Entries are written aside and renamed in place so that concurrent loaders never see a partial one
+	std::error_code error;
+	std::filesystem::create_directories(m_Directory, error);
+
+	uint64_t suffix = ((uint64_t)std::random_device{}() << 32) ^ (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+	std::string tempPath = std::format("{}.{:x}.tmp", entryPath, suffix);
+
+	bool written{ false };
+	{
+		std::ofstream fs(tempPath, std::ios::binary | std::ios::trunc);
+		written = fs.is_open()
+			&& fs.write(reinterpret_cast<const char*>(&header), sizeof(header))
+			&& fs.write(body.data(), (std::streamsize)body.size());
+		fs.close();
+		written = written && !fs.fail();
+	}
+
+	if (written)
+	{
+		std::filesystem::rename(tempPath, entryPath, error);
+	}
+
+	if (!written || error)
+	{
+		std::filesystem::remove(tempPath, error);
+
+		// Another loader storing the same entry first is fine
+		if (!std::filesystem::exists(entryPath, error))
+		{
+			report.ReportWarning(std::format("Could not write cache entry at: {}", entryPath));
+		}
+	}
+}
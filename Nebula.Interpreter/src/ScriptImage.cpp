@@ -0,0 +1,185 @@
+#include <bit>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <map>
+
+#include "ScriptImage.h"
+#include "Script.h"
+
+using namespace nebula;
+
+static_assert(std::endian::native == std::endian::little, "Images are read and written as little endian words");
+static_assert(sizeof(LinkedInstruction) == 4 * sizeof(uint32_t), "Linked instructions are stored as four words");
+
+static void AppendWords(std::vector<char>& out, const void* data, size_t count)
+{
+	const char* bytes = static_cast<const char*>(data);
+	out.insert(out.end(), bytes, bytes + count * sizeof(uint32_t));
+}
+
+static void AppendWord(std::vector<char>& out, uint32_t value)
+{
+	AppendWords(out, &value, 1);
+}
+
+// Sections are written after the string pool but the pool is only known once they are all written,
+// they are buffered and strings are added to the pool as they are met
+class ImageWriter
+{
+public:
+	inline void Word(uint32_t value) { AppendWord(m_Sections, value); }
+	inline void Words(const void* data, size_t count) { AppendWords(m_Sections, data, count); }
+	inline void String(std::string_view str) { Word(PoolIndexOf(str)); }
+
+	void Finish(uint32_t flags, std::vector<char>& out) const
+	{
+		out.clear();
+		out.insert(out.end(), std::begin(ScriptImage::Magic), std::end(ScriptImage::Magic));
+		AppendWord(out, ScriptImage::Version);
+		AppendWord(out, flags);
+
+		AppendWord(out, (uint32_t)m_Pool.size());
+		uint32_t textSize{ 0 };
+		for (std::string_view str : m_Pool)
+		{
+			AppendWord(out, textSize);
+			AppendWord(out, (uint32_t)str.size());
+			textSize += (uint32_t)str.size();
+		}
+
+		AppendWord(out, textSize);
+		for (std::string_view str : m_Pool)
+		{
+			out.insert(out.end(), str.begin(), str.end());
+		}
+
+		// Keep the following sections aligned on words
+		out.resize(out.size() + (sizeof(uint32_t) - textSize % sizeof(uint32_t)) % sizeof(uint32_t), '\0');
+		out.insert(out.end(), m_Sections.begin(), m_Sections.end());
+	}
+
+private:
+	uint32_t PoolIndexOf(std::string_view str)
+	{
+		auto it = m_Lookup.find(str);
+		if (it != m_Lookup.end())
+			return it->second;
+
+		uint32_t index = (uint32_t)m_Pool.size();
+		it = m_Lookup.emplace(std::string{ str }, index).first;
+		m_Pool.push_back(it->first);
+		return index;
+	}
+
+	std::vector<char> m_Sections;
+	// Views of the lookup keys, map nodes never move
+	std::vector<std::string_view> m_Pool;
+	std::map<std::string, uint32_t, std::less<>> m_Lookup;
+};
+
+bool ScriptImage::IsImage(std::string_view data)
+{
+	return data.size() >= sizeof(Magic) && std::memcmp(data.data(), Magic, sizeof(Magic)) == 0;
+}
+
+bool ScriptImage::Write(const Script& script, std::vector<char>& out, shared::DiagnosticReport& report, bool debugLines)
+{
+	ImageWriter writer;
+	writer.String(script.Namespace());
+
+	writer.Word((uint32_t)script.Globals().size());
+	for (const GlobalVariable& global : script.Globals())
+	{
+		writer.String(global.GetName());
+		writer.Word(global.GetType());
+	}
+
+	writer.Word((uint32_t)script.Bundles().size());
+	for (const auto& kvp : script.Bundles())
+	{
+		const BundleFields& fields = kvp.second.Fields();
+		writer.String(kvp.second.Name());
+		writer.Word((uint32_t)fields.size());
+		for (const BundleFieldDefinition& field : fields)
+		{
+			writer.String(field.first);
+			writer.Word(field.second);
+		}
+	}
+
+	writer.Word((uint32_t)script.Functions().size());
+	for (const auto& kvp : script.Functions())
+	{
+		const Function& function = kvp.second;
+		const LinkedCode& code = function.Code();
+		if (code.Size() < function.Instructions().size())
+		{
+			report.ReportError(std::format("Function '{}' must be linked before its script is written as an image", function.Name()));
+			return false;
+		}
+
+		writer.String(function.Name());
+		writer.Word(function.ReturnType());
+		writer.Word((uint32_t)function.Parameters().size());
+		writer.Word((uint32_t)function.Locals().size());
+		writer.Word((uint32_t)function.Attributes().size());
+		writer.Word((uint32_t)code.StringCount());
+		writer.Word((uint32_t)code.Size());
+
+		for (DataStackVariantIndex type : function.Parameters())
+		{
+			writer.Word(type);
+		}
+
+		for (DataStackVariantIndex type : function.Locals())
+		{
+			writer.Word(type);
+		}
+
+		for (VMAttribute attribute : function.Attributes())
+		{
+			writer.Word((uint32_t)attribute);
+		}
+
+		for (StringId id{ 0 }; id < code.StringCount(); id++)
+		{
+			writer.String(code.String(id));
+		}
+
+		// The code may already be specialized by an interpreter
+		for (size_t i{ 0 }; i < code.Size(); i++)
+		{
+			LinkedInstruction instruction = code.Original(i);
+			writer.Words(&instruction, 4);
+		}
+
+		if (debugLines)
+		{
+			const std::vector<uint32_t>& lines = function.SourceLines();
+			for (size_t i{ 0 }; i < code.Size(); i++)
+			{
+				writer.Word(i < lines.size() ? lines[i] : 0);
+			}
+		}
+	}
+
+	writer.Finish(debugLines ? DebugLines : NoFlags, out);
+	return true;
+}
+
+bool ScriptImage::Save(const Script& script, const std::string& filePath, shared::DiagnosticReport& report, bool debugLines)
+{
+	std::vector<char> image;
+	if (!Write(script, image, report, debugLines))
+		return false;
+
+	std::ofstream fs(filePath, std::ios::binary | std::ios::trunc);
+	if (!fs.is_open() || !fs.write(image.data(), (std::streamsize)image.size()))
+	{
+		report.ReportError(std::format("Could not write file at: {}", filePath));
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,344 @@
+#include "ScriptImageParser.h"
+
+#include <cassert>
+#include <cstring>
+#include <format>
+
+#include "Script.h"
+#include "Function.h"
+#include "ScriptImage.h"
+
+using namespace nebula;
+using namespace nebula::parsing;
+
+static constexpr size_t WordSize = sizeof(uint32_t);
+
+Script* ScriptImageParser::ParseScript(const std::string_view& data)
+{
+	m_ScriptBuilder = new ScriptBuilder();
+	m_CurrentData = data;
+	m_CurrentDataIndex = 0;
+
+	bool parsed = ParseHeader()
+		&& ParseStringPool()
+		&& ParseNamespace()
+		&& ParseGlobals()
+		&& ParseBundles()
+		&& ParseFunctions();
+
+	if (parsed && m_CurrentDataIndex != m_CurrentData.size())
+	{
+		ReportMalformed("end of image");
+	}
+
+	// Interned strings are never released, nothing is interned before the whole image is known to be valid
+	if (m_Report.Errors().size() == 0)
+	{
+		LoadFunctions();
+	}
+
+	if (m_Report.Errors().size() > 0)
+	{
+		delete m_ScriptBuilder;
+		return nullptr;
+	}
+
+	Script* script = m_ScriptBuilder->Finalize();
+	delete m_ScriptBuilder;
+
+	return script;
+}
+
+bool ScriptImageParser::ParseHeader()
+{
+	if (!ScriptImage::IsImage(m_CurrentData))
+		return ReportMalformed("header");
+
+	m_CurrentDataIndex += sizeof(ScriptImage::Magic);
+
+	uint32_t version{ 0 };
+	if (!ReadWord(version) || !ReadWord(m_Flags))
+		return ReportMalformed("header");
+
+	if (version != ScriptImage::Version)
+	{
+		m_Report.ReportError(std::format("Script image version {} is not supported, expected version {}", version, ScriptImage::Version));
+		return false;
+	}
+
+	return true;
+}
+
+bool ScriptImageParser::ParseStringPool()
+{
+	uint32_t count{ 0 };
+	const char* entries{ nullptr };
+	uint32_t textSize{ 0 };
+	const char* text{ nullptr };
+	if (!ReadWord(count) || !ReadWords(entries, 2 * (size_t)count) || !ReadWord(textSize))
+		return ReportMalformed("string pool");
+
+	// The text is padded to a word
+	if (!ReadWords(text, ((size_t)textSize + WordSize - 1) / WordSize))
+		return ReportMalformed("string pool");
+
+	m_Pool.reserve(count);
+	for (uint32_t i{ 0 }; i < count; i++)
+	{
+		uint32_t entry[2];
+		std::memcpy(entry, entries + i * sizeof(entry), sizeof(entry));
+		if (entry[0] > textSize || entry[1] > textSize - entry[0])
+			return ReportMalformed("string pool");
+
+		m_Pool.emplace_back(text + entry[0], entry[1]);
+	}
+
+	return true;
+}
+
+bool ScriptImageParser::ParseNamespace()
+{
+	std::string_view ns;
+	if (!ReadPoolString(ns))
+		return ReportMalformed("namespace");
+
+	if (!m_ScriptBuilder->SetNamespace(std::string{ ns }))
+	{
+		ReportCouldNotParseNameSpace(m_CurrentDataIndex);
+		return false;
+	}
+
+	return true;
+}
+
+bool ScriptImageParser::ParseGlobals()
+{
+	uint32_t count{ 0 };
+	if (!ReadWord(count))
+		return ReportMalformed("globals");
+
+	for (uint32_t i{ 0 }; i < count; i++)
+	{
+		std::string_view name;
+		DataStackVariantIndex type;
+		if (!ReadPoolString(name) || !ReadType(type))
+			return ReportMalformed("globals");
+
+		m_ScriptBuilder->AddGlobal(std::string{ name }, type);
+	}
+
+	return true;
+}
+
+bool ScriptImageParser::ParseBundles()
+{
+	uint32_t count{ 0 };
+	if (!ReadWord(count))
+		return ReportMalformed("bundles");
+
+	for (uint32_t i{ 0 }; i < count; i++)
+	{
+		std::string_view name;
+		uint32_t fieldCount{ 0 };
+		if (!ReadPoolString(name) || !ReadWord(fieldCount))
+			return ReportMalformed("bundles");
+
+		BundleDefinition bundle{ std::string{ name } };
+		for (uint32_t f{ 0 }; f < fieldCount; f++)
+		{
+			std::string_view fieldName;
+			DataStackVariantIndex fieldType;
+			if (!ReadPoolString(fieldName) || !ReadType(fieldType))
+				return ReportMalformed("bundles");
+
+			bundle.AddField({ std::string{ fieldName }, fieldType });
+		}
+
+		if (!m_ScriptBuilder->AddBundle(std::move(bundle)))
+		{
+			ReportErrorWhileParsingBundle(name);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool ScriptImageParser::ParseFunctions()
+{
+	uint32_t count{ 0 };
+	if (!ReadWord(count))
+		return ReportMalformed("functions");
+
+	for (uint32_t i{ 0 }; i < count; i++)
+	{
+		if (!ParseFunction())
+			return false;
+	}
+
+	return true;
+}
+
+bool ScriptImageParser::ParseFunction()
+{
+	std::string_view name;
+	DataStackVariantIndex returnType;
+	uint32_t counts[5]{};
+	if (!ReadPoolString(name) || name.empty() || !ReadType(returnType))
+		return ReportMalformed("functions");
+
+	for (uint32_t& count : counts)
+	{
+		if (!ReadWord(count))
+			return ReportMalformed("functions");
+	}
+
+	const auto [parameterCount, localCount, attributeCount, stringCount, instructionCount] = counts;
+
+	Function newFunc{ m_ScriptBuilder->Get(), returnType, std::string{ name } };
+	for (uint32_t p{ 0 }; p < parameterCount; p++)
+	{
+		DataStackVariantIndex type;
+		if (!ReadType(type))
+			return ReportMalformed(name);
+
+		newFunc.AddParameter(type);
+	}
+
+	for (uint32_t l{ 0 }; l < localCount; l++)
+	{
+		DataStackVariantIndex type;
+		if (!ReadType(type))
+			return ReportMalformed(name);
+
+		newFunc.AddLocalVariable(type);
+	}
+
+	for (uint32_t a{ 0 }; a < attributeCount; a++)
+	{
+		uint32_t attribute{ 0 };
+		if (!ReadWord(attribute) || attribute >= (uint32_t)VMAttribute::LastAttribute)
+			return ReportMalformed(name);
+
+		newFunc.AddAttribute((VMAttribute)attribute);
+	}
+
+	PendingFunction pending{ std::move(newFunc) };
+	pending.Strings.reserve(stringCount);
+	for (uint32_t s{ 0 }; s < stringCount; s++)
+	{
+		uint32_t index{ 0 };
+		if (!ReadWord(index) || index >= m_Pool.size())
+			return ReportMalformed(name);
+
+		pending.Strings.push_back(index);
+	}
+
+	// The whole stream is copied at once, operands are only range checked (see LinkedCode::Load)
+	const char* code{ nullptr };
+	if (!ReadWords(code, (size_t)instructionCount * 4))
+		return ReportMalformed(name);
+
+	pending.Instructions.resize(instructionCount);
+	std::memcpy(pending.Instructions.data(), code, pending.Instructions.size() * sizeof(LinkedInstruction));
+	if (!LinkedCode::IsLoadable(pending.Instructions, pending.Strings.size()))
+	{
+		m_Report.ReportError(std::format("Function '{}' of the script image has malformed instructions", name));
+		return false;
+	}
+
+	if (m_Flags & ScriptImage::DebugLines)
+	{
+		const char* lines{ nullptr };
+		if (!ReadWords(lines, instructionCount))
+			return ReportMalformed(name);
+
+		std::vector<uint32_t> sourceLines(instructionCount);
+		std::memcpy(sourceLines.data(), lines, sourceLines.size() * sizeof(uint32_t));
+		pending.Definition.SetSourceLines(std::move(sourceLines));
+	}
+
+	if (!m_FunctionNames.insert(name).second)
+	{
+		m_Report.ReportError(std::format("Function '{}' is defined more than once in the script image", name));
+		return false;
+	}
+
+	m_PendingFunctions.push_back(std::move(pending));
+	return true;
+}
+
+void ScriptImageParser::LoadFunctions()
+{
+	std::vector<SharedString*> interned(m_Pool.size(), nullptr);
+	for (PendingFunction& pending : m_PendingFunctions)
+	{
+		std::vector<SharedString*> strings;
+		strings.reserve(pending.Strings.size());
+		for (uint32_t index : pending.Strings)
+		{
+			if (interned[index] == nullptr)
+			{
+				interned[index] = SharedString::Intern(m_Pool[index]);
+			}
+
+			strings.push_back(interned[index]);
+		}
+
+		// Both were checked while parsing
+		[[maybe_unused]] bool loaded = pending.Definition.LoadCode(std::move(pending.Instructions), std::move(strings));
+		assert(loaded && "Instructions were checked while parsing");
+
+		[[maybe_unused]] bool added = m_ScriptBuilder->AddFunction(std::move(pending.Definition));
+		assert(added && "Function names were checked while parsing");
+	}
+
+	m_PendingFunctions.clear();
+}
+
+bool ScriptImageParser::ReadWord(uint32_t& out)
+{
+	const char* word{ nullptr };
+	if (!ReadWords(word, 1))
+		return false;
+
+	std::memcpy(&out, word, sizeof(out));
+	return true;
+}
+
+bool ScriptImageParser::ReadWords(const char*& out, size_t count)
+{
+	size_t remaining = m_CurrentData.size() - m_CurrentDataIndex;
+	if (count > remaining / WordSize)
+		return false;
+
+	out = m_CurrentData.data() + m_CurrentDataIndex;
+	m_CurrentDataIndex += count * WordSize;
+	return true;
+}
+
+bool ScriptImageParser::ReadPoolString(std::string_view& out)
+{
+	uint32_t index{ 0 };
+	if (!ReadWord(index) || index >= m_Pool.size())
+		return false;
+
+	out = m_Pool[index];
+	return true;
+}
+
+bool ScriptImageParser::ReadType(DataStackVariantIndex& out)
+{
+	uint32_t type{ 0 };
+	if (!ReadWord(type) || type >= _TypeLast)
+		return false;
+
+	out = (DataStackVariantIndex)type;
+	return true;
+}
+
+bool ScriptImageParser::ReportMalformed(std::string_view section)
+{
+	m_Report.ReportError(std::format("Malformed script image at '{}' while reading '{}'.", m_CurrentDataIndex, section));
+	return false;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "interfaces\IScriptParser.h"
+
+#include "DiagnosticReport.h"
+#include "LanguageTypes.h"
+#include "Function.h"
+
+namespace nebula::parsing
+{
+    // Loads a binary script image (see ScriptImage), the data is only read in place while parsing.
+    // Every count and index is checked against the data, malformed images are reported and rejected
+    class ScriptImageParser
+        : public IScriptParser
+    {
+    public:
+        virtual Script* ParseScript(const std::string_view& data) override;
+        virtual shared::DiagnosticReport& GetLastParsingReport() override { return m_Report; }
+
+    private:
+        bool ParseHeader();
+        bool ParseStringPool();
+        bool ParseNamespace();
+        bool ParseGlobals();
+        bool ParseBundles();
+        bool ParseFunctions();
+        bool ParseFunction();
+        // Interns the strings of the parsed functions and adds them to the script, once the whole image is known to be valid
+        void LoadFunctions();
+
+        bool ReadWord(uint32_t& out);
+        // Points out to count words in place, false if the data is shorter
+        bool ReadWords(const char*& out, size_t count);
+        bool ReadPoolString(std::string_view& out);
+        bool ReadType(DataStackVariantIndex& out);
+        bool ReportMalformed(std::string_view section);
+
+        // Function read from the image, its string table is still made of pool indices
+        struct PendingFunction
+        {
+            Function Definition;
+            std::vector<uint32_t> Strings{};
+            std::vector<LinkedInstruction> Instructions{};
+        };
+
+        uint32_t m_Flags{ 0 };
+        std::vector<std::string_view> m_Pool;
+        std::vector<PendingFunction> m_PendingFunctions;
+        std::unordered_set<std::string_view> m_FunctionNames;
+    };
+}
@@ -0,0 +1,739 @@
+#include <format>
+#include <algorithm>
+#include <vector>
+
+#include "ScriptVerifier.h"
+#include "Script.h"
+#include "Function.h"
+#include "Bundle.h"
+
+using namespace nebula;
+
+// Abstract value of an operand stack slot, _UnknownType when the type can't be known before running
+struct StackSlot
+{
+	DataStackVariantIndex Type{ _UnknownType };
+	const BundleDefinition* Bundle{ nullptr };
+
+	bool operator==(const StackSlot&) const = default;
+};
+
+// Operand stack at the start of an instruction, the last slot is the top of the stack.
+// Native functions (and functions of scripts that are not loaded yet) consume an unknown number of values,
+// after calling one the stack is imprecise: only the values pushed since then are known.
+struct StackState
+{
+	bool Reached{ false };
+	bool Imprecise{ false };
+	std::vector<StackSlot> Slots;
+};
+
+// Slot at offset from the top of the stack, nullptr if its value is not known
+static const StackSlot* SlotAt(const StackState& state, size_t offset)
+{
+	if (offset >= state.Slots.size())
+		return nullptr;
+
+	return &state.Slots[state.Slots.size() - 1 - offset];
+}
+
+static DataStackVariantIndex TypeAt(const StackState& state, size_t offset)
+{
+	const StackSlot* slot = SlotAt(state, offset);
+	return slot != nullptr ? slot->Type : _UnknownType;
+}
+
+using TypeMask = uint32_t;
+
+static constexpr TypeMask MaskOf(DataStackVariantIndex type) { return 1u << type; }
+static constexpr TypeMask IntMask = MaskOf(_TypeInt32);
+static constexpr TypeMask NumericMask = MaskOf(_TypeInt32) | MaskOf(_TypeFloat);
+static constexpr TypeMask StringMask = MaskOf(_TypeString);
+static constexpr TypeMask ObjectMask = MaskOf(_TypeObject);
+static constexpr TypeMask AnyMask = ~0u;
+
+static const char* TypeName(DataStackVariantIndex type)
+{
+	switch (type)
+	{
+	case _TypeInt32: return "int32";
+	case _TypeFloat: return "float";
+	case _TypeString: return "string";
+	case _TypeObject: return "object";
+	case _TypeVoid: return "void";
+	default: return "unknown";
+	}
+}
+
+// What a mismatching operand means for the function
+enum class Mismatch
+{
+	Reject,     // The instruction fails or corrupts memory, the bytecode is invalid
+	Unverified, // The instruction copes with it, the function keeps its runtime checks
+};
+
+// Verifies a single function, stops at the first error
+class FunctionVerifier
+{
+public:
+	FunctionVerifier(const Script& script, const Function& function, const ScriptVerifier::ScriptLookup& lookup, shared::DiagnosticReport& report)
+		: m_Script{ script }, m_Function{ function }, m_Code{ function.Code() }, m_Lookup{ lookup }, m_Report{ report }
+	{
+	}
+
+	bool Run();
+	bool IsVerified() const { return m_IsVerified; }
+	// Opcode to run at index once the operand types are known, the same opcode if they are not
+	VMInstruction SpecializedOpcode(size_t index) const;
+	// Operand stack height before each instruction, Function::UnreachedStackHeight for unreached ones
+	std::vector<size_t> StackHeights() const;
+
+private:
+	bool Step(size_t index, StackState& state);
+	bool Flow(size_t target, const StackState& state);
+	bool FlowNext(size_t index, const StackState& state);
+
+	bool Error(const std::string& message);
+	bool CheckBranchTarget(TInt32 target);
+	bool CheckIndex(TInt32 index, size_t count, const char* what);
+
+	// Checks the operand at offset from the top of the stack
+	bool Require(const StackState& state, size_t offset, TypeMask allowed, Mismatch mismatch);
+	bool RequireDepth(const StackState& state, size_t count);
+	bool Pop(StackState& state, size_t count);
+	void Push(StackState& state, DataStackVariantIndex type, const BundleDefinition* bundle = nullptr);
+	bool CallUnknown(StackState& state);
+
+	const Script* FindScript(StringId ns) const;
+	const Function* FindFunction(const LinkedInstruction& instruction) const;
+	const BundleDefinition* FindBundle(const LinkedInstruction& instruction) const;
+	const GlobalVariable* FindGlobal(const LinkedInstruction& instruction, bool& scriptFound) const;
+
+	const Script& m_Script;
+	const Function& m_Function;
+	const LinkedCode& m_Code;
+	const ScriptVerifier::ScriptLookup& m_Lookup;
+	shared::DiagnosticReport& m_Report;
+
+	std::vector<StackState> m_States;
+	std::vector<size_t> m_Pending;
+	size_t m_CurrentIndex{ 0 };
+	bool m_IsVerified{ true };
+};
+
+ScriptVerifier::ScriptVerifier(ScriptLookup lookup)
+	: m_Lookup{ std::move(lookup) }
+{
+}
+
+bool ScriptVerifier::Verify(Script& script, shared::DiagnosticReport& report)
+{
+	bool valid = true;
+	for (auto& kvp : script.m_Functions)
+	{
+		Function& function = kvp.second;
+		FunctionVerifier verifier{ script, function, m_Lookup, report };
+		if (!verifier.Run())
+		{
+			valid = false;
+			continue;
+		}
+
+		function.m_IsVerified = verifier.IsVerified();
+		if (function.m_IsVerified)
+		{
+			function.m_StackHeights = verifier.StackHeights();
+		}
+
+		for (size_t i{ 0 }; i < function.m_Code.Size(); i++)
+		{
+			VMInstruction opcode = verifier.SpecializedOpcode(i);
+			if (opcode != function.m_Code[i].Opcode)
+			{
+				function.m_Code.Specialize(i, opcode);
+			}
+		}
+
+		function.m_Code.FuseSuperinstructions();
+	}
+
+	return valid;
+}
+
+bool FunctionVerifier::Run()
+{
+	if (m_Code.Empty())
+		return Error("function has no instructions");
+
+	if (m_Function.HasAttribute(VMAttribute::AutoExec) && !m_Function.Parameters().empty())
+		return Error("autoexec functions can't have parameters");
+
+	m_States.resize(m_Code.Size());
+	m_States[0].Reached = true;
+	m_Pending.push_back(0);
+
+	while (!m_Pending.empty())
+	{
+		size_t index = m_Pending.back();
+		m_Pending.pop_back();
+
+		StackState state = m_States[index];
+		m_CurrentIndex = index;
+		if (!Step(index, state))
+			return false;
+	}
+
+	return true;
+}
+
+bool FunctionVerifier::Step(size_t index, StackState& state)
+{
+	const LinkedInstruction& instruction = m_Code[index];
+	if (state.Imprecise)
+	{
+		m_IsVerified = false;
+	}
+
+	switch (instruction.Opcode)
+	{
+	case VMInstruction::Nop:
+		break;
+	case VMInstruction::Pop:
+		if (!Pop(state, 1)) return false;
+		break;
+	case VMInstruction::Dup:
+	{
+		if (!RequireDepth(state, 1)) return false;
+		const StackSlot* top = SlotAt(state, 0);
+		Push(state, top != nullptr ? top->Type : _UnknownType, top != nullptr ? top->Bundle : nullptr);
+		break;
+	}
+	case VMInstruction::Call:
+	case VMInstruction::Call_t:
+	{
+		const Function* callee = FindFunction(instruction);
+		if (callee == nullptr)
+		{
+			if (!CallUnknown(state)) return false;
+			break;
+		}
+
+		const VariableList& params = callee->Parameters();
+		if (!RequireDepth(state, params.size())) return false;
+		for (size_t i{ 0 }; i < params.size(); i++)
+		{
+			if (!Require(state, params.size() - 1 - i, MaskOf(params[i]), Mismatch::Reject)) return false;
+		}
+
+		if (!Pop(state, params.size())) return false;
+
+		// Threaded calls discard the return value
+		if (instruction.Opcode == VMInstruction::Call && callee->ReturnType() != _TypeVoid)
+		{
+			Push(state, callee->ReturnType());
+		}
+		break;
+	}
+	case VMInstruction::CallVirt:
+	{
+		if (!CheckIndex(instruction.A.Int, m_Function.Locals().size(), "local")) return false;
+		if (!CallUnknown(state)) return false;
+		break;
+	}
+	case VMInstruction::ConvType:
+	{
+		DataStackVariantIndex target = (DataStackVariantIndex)instruction.A.Int;
+		if (target != _TypeInt32 && target != _TypeFloat && target != _TypeString)
+			return Error(std::format("can't convert to type {}", TypeName(target)));
+
+		TypeMask allowed = target == _TypeString ? AnyMask : NumericMask;
+		if (!Require(state, 0, allowed, Mismatch::Reject)) return false;
+		if (!Pop(state, 1)) return false;
+		Push(state, target);
+		break;
+	}
+	case VMInstruction::ChkDef:
+	{
+		if (!Require(state, 0, ObjectMask, Mismatch::Unverified)) return false;
+		if (!Pop(state, 1)) return false;
+		Push(state, _TypeInt32);
+		break;
+	}
+	case VMInstruction::Ret:
+	{
+		if (m_Function.ReturnType() == _TypeVoid)
+		{
+			if (!state.Slots.empty())
+				return Error("the operand stack must be empty when returning");
+			return true;
+		}
+
+		if (!Require(state, 0, MaskOf(m_Function.ReturnType()), Mismatch::Reject)) return false;
+		if (state.Slots.size() > 1 || (!state.Imprecise && state.Slots.size() != 1))
+			return Error("the operand stack must only hold the return value when returning");
+		return true;
+	}
+	case VMInstruction::Br:
+	{
+		if (!CheckBranchTarget(instruction.A.Int)) return false;
+		return Flow((size_t)instruction.A.Int, state);
+	}
+	case VMInstruction::BrTrue:
+	case VMInstruction::BrFalse:
+	{
+		if (!CheckBranchTarget(instruction.A.Int)) return false;
+		if (!Require(state, 0, IntMask, Mismatch::Unverified)) return false;
+		if (!Pop(state, 1)) return false;
+		if (!Flow((size_t)instruction.A.Int, state)) return false;
+		break;
+	}
+	case VMInstruction::Ceq:
+	case VMInstruction::Clt:
+	case VMInstruction::Cgt:
+	case VMInstruction::And:
+	case VMInstruction::Or:
+	case VMInstruction::Xor:
+	case VMInstruction::Rem:
+	{
+		if (!RequireDepth(state, 2)) return false;
+		if (!Require(state, 0, IntMask, Mismatch::Unverified)) return false;
+		if (!Require(state, 1, IntMask, Mismatch::Unverified)) return false;
+		if (!Pop(state, 2)) return false;
+		Push(state, _TypeInt32);
+		break;
+	}
+	case VMInstruction::Add:
+	case VMInstruction::Sub:
+	case VMInstruction::Mul:
+	case VMInstruction::Div:
+	{
+		if (!RequireDepth(state, 2)) return false;
+		if (!Require(state, 0, NumericMask, Mismatch::Reject)) return false;
+		if (!Require(state, 1, NumericMask, Mismatch::Reject)) return false;
+
+		DataStackVariantIndex result = _UnknownType;
+		DataStackVariantIndex a = TypeAt(state, 0);
+		DataStackVariantIndex b = TypeAt(state, 1);
+		if (a != _UnknownType && b != _UnknownType)
+		{
+			result = a == _TypeInt32 && b == _TypeInt32 ? _TypeInt32 : _TypeFloat;
+		}
+
+		if (!Pop(state, 2)) return false;
+		Push(state, result);
+		break;
+	}
+	case VMInstruction::Neg:
+	{
+		if (!Require(state, 0, NumericMask, Mismatch::Reject)) return false;
+		// Same type as the operand
+		break;
+	}
+	case VMInstruction::Not:
+	{
+		if (!Require(state, 0, IntMask, Mismatch::Unverified)) return false;
+		if (!Pop(state, 1)) return false;
+		Push(state, _TypeInt32);
+		break;
+	}
+	case VMInstruction::Wait:
+	{
+		if (!Require(state, 0, NumericMask, Mismatch::Unverified)) return false;
+		if (!Pop(state, 1)) return false;
+		break;
+	}
+	case VMInstruction::Wait_n:
+	case VMInstruction::Endon:
+	case VMInstruction::Notify:
+	{
+		// Notification name then the notifier
+		if (!RequireDepth(state, 2)) return false;
+		if (!Require(state, 0, StringMask, Mismatch::Reject)) return false;
+		if (!Require(state, 1, ObjectMask, Mismatch::Reject)) return false;
+		if (!Pop(state, 2)) return false;
+		break;
+	}
+	case VMInstruction::AddStr:
+	{
+		TInt32 count = instruction.A.Int;
+		if (count < 0)
+			return Error(std::format("can't concatenate {} strings", count));
+
+		if (!RequireDepth(state, (size_t)count)) return false;
+		for (TInt32 i{ 0 }; i < count; i++)
+		{
+			if (!Require(state, (size_t)i, StringMask, Mismatch::Reject)) return false;
+		}
+
+		if (!Pop(state, (size_t)count)) return false;
+		Push(state, _TypeString);
+		break;
+	}
+	case VMInstruction::LdNull:
+		Push(state, _TypeObject);
+		break;
+	case VMInstruction::Ldc_i4_0:
+	case VMInstruction::Ldc_i4_1:
+	case VMInstruction::Ldc_i4_2:
+	case VMInstruction::Ldc_i4_3:
+	case VMInstruction::Ldc_i4_4:
+	case VMInstruction::Ldc_i4_5:
+	case VMInstruction::Ldc_i4_6:
+	case VMInstruction::Ldc_i4_7:
+	case VMInstruction::Ldc_i4_8:
+	case VMInstruction::Ldc_i4_9:
+	case VMInstruction::Ldc_i4:
+		Push(state, _TypeInt32);
+		break;
+	case VMInstruction::Ldc_r4:
+		Push(state, _TypeFloat);
+		break;
+	case VMInstruction::Ldc_s:
+		Push(state, _TypeString);
+		break;
+	case VMInstruction::Newobj:
+		Push(state, _TypeObject, FindBundle(instruction));
+		break;
+	case VMInstruction::NewArr:
+		Push(state, _TypeObject);
+		break;
+	case VMInstruction::Ldarg:
+	{
+		if (!CheckIndex(instruction.A.Int, m_Function.Parameters().size(), "parameter")) return false;
+		Push(state, m_Function.Parameters()[instruction.A.Int]);
+		break;
+	}
+	case VMInstruction::Ldloc:
+	{
+		if (!CheckIndex(instruction.A.Int, m_Function.Locals().size(), "local")) return false;
+		Push(state, m_Function.Locals()[instruction.A.Int]);
+		break;
+	}
+	case VMInstruction::LdElem:
+	{
+		// Index then array, the type of the elements is not known
+		if (!RequireDepth(state, 2)) return false;
+		if (!Require(state, 0, IntMask, Mismatch::Unverified)) return false;
+		if (!Require(state, 1, ObjectMask, Mismatch::Unverified)) return false;
+		if (!Pop(state, 2)) return false;
+		Push(state, _UnknownType);
+		break;
+	}
+	case VMInstruction::LdFld:
+	{
+		if (!Require(state, 0, ObjectMask, Mismatch::Reject)) return false;
+
+		const BundleDefinition* bundle = SlotAt(state, 0) != nullptr ? SlotAt(state, 0)->Bundle : nullptr;
+		if (bundle != nullptr)
+		{
+			if (!CheckIndex(instruction.A.Int, bundle->Fields().size(), "field")) return false;
+		}
+		else if (instruction.A.Int < 0)
+		{
+			return Error(std::format("field index {} is out of range", instruction.A.Int));
+		}
+
+		// Fields can be assigned values of another type by native code, their type is only known at runtime
+		if (!Pop(state, 1)) return false;
+		Push(state, _UnknownType);
+		break;
+	}
+	case VMInstruction::LdSfld:
+	case VMInstruction::StsFld:
+	{
+		bool scriptFound{ false };
+		const GlobalVariable* global = FindGlobal(instruction, scriptFound);
+		if (scriptFound && global == nullptr)
+			return Error(std::format("global index {} is out of range", instruction.A.Int));
+
+		// Globals hold no value of their type until first stored to, their type is only known at runtime
+		if (instruction.Opcode == VMInstruction::LdSfld)
+		{
+			Push(state, _UnknownType);
+			break;
+		}
+
+		if (!Require(state, 0, global != nullptr ? MaskOf(global->GetType()) : AnyMask, Mismatch::Reject)) return false;
+		if (global == nullptr)
+		{
+			m_IsVerified = false;
+		}
+
+		if (!Pop(state, 1)) return false;
+		break;
+	}
+	case VMInstruction::Stloc:
+	{
+		if (!CheckIndex(instruction.A.Int, m_Function.Locals().size(), "local")) return false;
+		if (!Require(state, 0, MaskOf(m_Function.Locals()[instruction.A.Int]), Mismatch::Reject)) return false;
+		if (!Pop(state, 1)) return false;
+		break;
+	}
+	case VMInstruction::StArg:
+	{
+		if (!CheckIndex(instruction.A.Int, m_Function.Parameters().size(), "parameter")) return false;
+		if (!Require(state, 0, MaskOf(m_Function.Parameters()[instruction.A.Int]), Mismatch::Reject)) return false;
+		if (!Pop(state, 1)) return false;
+		break;
+	}
+	case VMInstruction::StElem:
+	{
+		// Value, index then array
+		m_IsVerified = false;
+		if (!Pop(state, 3)) return false;
+		break;
+	}
+	case VMInstruction::StFld:
+	{
+		// Value then bundle
+		if (!RequireDepth(state, 2)) return false;
+		if (!Require(state, 1, ObjectMask, Mismatch::Reject)) return false;
+
+		const BundleDefinition* bundle = SlotAt(state, 1) != nullptr ? SlotAt(state, 1)->Bundle : nullptr;
+		if (bundle != nullptr)
+		{
+			if (!CheckIndex(instruction.A.Int, bundle->Fields().size(), "field")) return false;
+			if (!Require(state, 0, MaskOf(bundle->Fields()[instruction.A.Int].second), Mismatch::Unverified)) return false;
+		}
+		else
+		{
+			if (instruction.A.Int < 0)
+				return Error(std::format("field index {} is out of range", instruction.A.Int));
+
+			m_IsVerified = false;
+		}
+
+		if (!Pop(state, 2)) return false;
+		break;
+	}
+	default:
+		return Error("unknown opcode");
+	}
+
+	return FlowNext(index, state);
+}
+
+bool FunctionVerifier::FlowNext(size_t index, const StackState& state)
+{
+	if (index + 1 >= m_Code.Size())
+		return Error("execution falls off the end of the function");
+
+	return Flow(index + 1, state);
+}
+
+bool FunctionVerifier::Flow(size_t target, const StackState& state)
+{
+	StackState& targetState = m_States[target];
+	if (!targetState.Reached)
+	{
+		targetState = state;
+		targetState.Reached = true;
+		m_Pending.push_back(target);
+		return true;
+	}
+
+	if (!targetState.Imprecise && !state.Imprecise && targetState.Slots.size() != state.Slots.size())
+		return Error(std::format("the operand stack height at instruction {:04X} depends on the path taken", target));
+
+	bool changed{ false };
+	if (state.Imprecise && !targetState.Imprecise)
+	{
+		targetState.Imprecise = true;
+		changed = true;
+	}
+
+	// Only the values on top of both stacks stay known
+	size_t known = std::min(targetState.Slots.size(), state.Slots.size());
+	if (known < targetState.Slots.size())
+	{
+		targetState.Slots.erase(targetState.Slots.begin(), targetState.Slots.end() - known);
+		changed = true;
+	}
+
+	// Slots reached with different types are only known at runtime
+	for (size_t i{ 0 }; i < known; i++)
+	{
+		StackSlot& slot = targetState.Slots[known - 1 - i];
+		const StackSlot& incoming = *SlotAt(state, i);
+		if (slot == incoming)
+			continue;
+
+		if (slot.Type != incoming.Type)
+		{
+			slot.Type = _UnknownType;
+		}
+
+		slot.Bundle = nullptr;
+		changed = true;
+	}
+
+	if (changed)
+	{
+		m_Pending.push_back(target);
+	}
+
+	return true;
+}
+
+bool FunctionVerifier::Error(const std::string& message)
+{
+	m_Report.ReportError(std::format("{}::{} at {:04X}: {}", m_Script.Namespace(), m_Function.Name(), m_CurrentIndex, message));
+	return false;
+}
+
+bool FunctionVerifier::CheckBranchTarget(TInt32 target)
+{
+	if (target < 0 || (size_t)target >= m_Code.Size())
+		return Error(std::format("branch target {:04X} is out of range", target));
+
+	return true;
+}
+
+bool FunctionVerifier::CheckIndex(TInt32 index, size_t count, const char* what)
+{
+	if (index < 0 || (size_t)index >= count)
+		return Error(std::format("{} index {} is out of range", what, index));
+
+	return true;
+}
+
+bool FunctionVerifier::Require(const StackState& state, size_t offset, TypeMask allowed, Mismatch mismatch)
+{
+	if (!state.Imprecise && offset >= state.Slots.size())
+		return Error("operand stack underflow");
+
+	DataStackVariantIndex type = TypeAt(state, offset);
+	if (type == _UnknownType)
+	{
+		m_IsVerified = false;
+		return true;
+	}
+
+	if ((MaskOf(type) & allowed) != 0)
+		return true;
+
+	if (mismatch == Mismatch::Reject)
+		return Error(std::format("operand {} can't be of type {}", offset, TypeName(type)));
+
+	m_IsVerified = false;
+	return true;
+}
+
+bool FunctionVerifier::RequireDepth(const StackState& state, size_t count)
+{
+	if (!state.Imprecise && state.Slots.size() < count)
+		return Error("operand stack underflow");
+
+	return true;
+}
+
+bool FunctionVerifier::Pop(StackState& state, size_t count)
+{
+	if (!RequireDepth(state, count))
+		return false;
+
+	state.Slots.resize(state.Slots.size() - std::min(count, state.Slots.size()));
+	return true;
+}
+
+void FunctionVerifier::Push(StackState& state, DataStackVariantIndex type, const BundleDefinition* bundle)
+{
+	state.Slots.push_back(StackSlot{ type, bundle });
+}
+
+bool FunctionVerifier::CallUnknown(StackState& state)
+{
+	state.Imprecise = true;
+	state.Slots.clear();
+	m_IsVerified = false;
+	return true;
+}
+
+VMInstruction FunctionVerifier::SpecializedOpcode(size_t index) const
+{
+	VMInstruction opcode = m_Code[index].Opcode;
+	const StackState& state = m_States[index];
+	if (!state.Reached)
+		return opcode;
+
+	DataStackVariantIndex b = TypeAt(state, 0);
+	DataStackVariantIndex a = TypeAt(state, 1);
+	bool ints = a == _TypeInt32 && b == _TypeInt32;
+	bool floats = a == _TypeFloat && b == _TypeFloat;
+
+	switch (opcode)
+	{
+	case VMInstruction::Add: return ints ? VMInstruction::Add_i4 : floats ? VMInstruction::Add_r4 : opcode;
+	case VMInstruction::Sub: return ints ? VMInstruction::Sub_i4 : floats ? VMInstruction::Sub_r4 : opcode;
+	case VMInstruction::Mul: return ints ? VMInstruction::Mul_i4 : floats ? VMInstruction::Mul_r4 : opcode;
+	case VMInstruction::Div: return ints ? VMInstruction::Div_i4 : floats ? VMInstruction::Div_r4 : opcode;
+	case VMInstruction::Ceq: return ints ? VMInstruction::Ceq_i4 : opcode;
+	case VMInstruction::Clt: return ints ? VMInstruction::Clt_i4 : opcode;
+	case VMInstruction::Cgt: return ints ? VMInstruction::Cgt_i4 : opcode;
+	default:
+		return opcode;
+	}
+}
+
+std::vector<size_t> FunctionVerifier::StackHeights() const
+{
+	std::vector<size_t> heights(m_States.size(), Function::UnreachedStackHeight);
+	for (size_t i{ 0 }; i < m_States.size(); i++)
+	{
+		if (m_States[i].Reached)
+		{
+			heights[i] = m_States[i].Slots.size();
+		}
+	}
+
+	return heights;
+}
+
+const Script* FunctionVerifier::FindScript(StringId ns) const
+{
+	if (ns == InvalidStringId || m_Code.String(ns) == m_Script.Namespace())
+		return &m_Script;
+
+	return m_Lookup ? m_Lookup(m_Code.String(ns)) : nullptr;
+}
+
+const Function* FunctionVerifier::FindFunction(const LinkedInstruction& instruction) const
+{
+	const Script* script = FindScript(instruction.B.String);
+	if (script == nullptr)
+		return nullptr;
+
+	// Implicit calls that are not found in the script are native calls
+	auto it = script->Functions().find(m_Code.String(instruction.A.String));
+	if (it == script->Functions().end())
+		return nullptr;
+
+	return &it->second;
+}
+
+const BundleDefinition* FunctionVerifier::FindBundle(const LinkedInstruction& instruction) const
+{
+	const Script* script = FindScript(instruction.B.String);
+	if (script == nullptr)
+		return nullptr;
+
+	auto it = script->Bundles().find(m_Code.String(instruction.A.String));
+	if (it == script->Bundles().end())
+		return nullptr;
+
+	return &it->second;
+}
+
+const GlobalVariable* FunctionVerifier::FindGlobal(const LinkedInstruction& instruction, bool& scriptFound) const
+{
+	const Script* script = FindScript(instruction.B.String);
+	scriptFound = script != nullptr;
+	if (script == nullptr)
+		return nullptr;
+
+	TInt32 index = instruction.A.Int;
+	if (index < 0 || (size_t)index >= script->Globals().size())
+		return nullptr;
+
+	return &script->Globals()[index];
+}
@@ -5,23 +5,62 @@ using namespace nebula;
 
 void ThreadMap::RemoveCallstack(size_t index)
 {
-    DeleteCallstackFrames(m_Callstacks[index]);
+    CallStack* removed = m_Callstacks[index];
+    DeleteCallstackFrames(*removed);
+    m_Indices.erase(removed);
+    delete removed;
+
     m_Callstacks[index] = m_Callstacks.back();
-    m_Callstacks.pop_back();    
+    m_Callstacks.pop_back();
+    if (index < m_Callstacks.size())
+    {
+        m_Indices[m_Callstacks[index]] = index;
+    }
+}
+
+void ThreadMap::RemoveCallstack(const CallStack* callstack)
+{
+    size_t index = IndexOf(callstack);
+    if (index < m_Callstacks.size())
+    {
+        RemoveCallstack(index);
+    }
 }
 
 void ThreadMap::Clear()
 {
-    for (auto& stack : m_Callstacks)
-        DeleteCallstackFrames(stack);
+    for (CallStack* stack : m_Callstacks)
+    {
+        DeleteCallstackFrames(*stack);
+        delete stack;
+    }
 
     m_Callstacks.clear();
+    m_Indices.clear();
+}
+
+size_t ThreadMap::IndexOf(const CallStack* callstack) const
+{
+    auto it = m_Indices.find(callstack);
+    if (it == m_Indices.end())
+        return m_Callstacks.size();
+
+    return it->second;
+}
+
+CallStack* ThreadMap::CreateNewThread()
+{
+    CallStack* callstack = new CallStack();
+    m_Indices[callstack] = m_Callstacks.size();
+    m_Callstacks.push_back(callstack);
+    return callstack;
 }
 
 void ThreadMap::DeleteCallstackFrames(CallStack& c)
 {
-    for (Frame* frame : c)
-        delete frame;
+    // Children first, frames detach themselves from their parent
+    for (auto it = c.rbegin(); it != c.rend(); it++)
+        m_FramePool.Destroy(*it);
 
     c.clear();
 }
@@ -0,0 +1,86 @@
+#include "ThreadScheduler.h"
+#include "Frame.h"
+
+#include <cassert>
+
+using namespace nebula;
+
+void ThreadScheduler::AddThread(CallStack* thread)
+{
+	assert(thread);
+	m_RunQueue.push_back(thread);
+}
+
+void ThreadScheduler::RemoveCurrent()
+{
+	if (!m_RunQueue.empty())
+	{
+		m_RunQueue.pop_front();
+	}
+}
+
+void ThreadScheduler::Clear()
+{
+	m_RunQueue.clear();
+	m_Parked.clear();
+	m_Timers = {};
+}
+
+void ThreadScheduler::Rotate()
+{
+	if (m_RunQueue.size() < 2)
+		return;
+
+	m_RunQueue.push_back(m_RunQueue.front());
+	m_RunQueue.pop_front();
+}
+
+void ThreadScheduler::ParkCurrent(unsigned long long wakeTime)
+{
+	CallStack* thread = Current();
+	assert(thread && !thread->empty());
+	if (thread == nullptr || thread->empty())
+		return;
+
+	m_RunQueue.pop_front();
+
+	// Only the top frame of a thread can block it
+	Frame* blockedFrame = thread->back();
+	size_t ticket = m_NextTicket++;
+	m_Parked[blockedFrame] = ParkedThread{ thread, ticket };
+
+	if (wakeTime > 0)
+	{
+		m_Timers.push(Timer{ wakeTime, blockedFrame, ticket });
+	}
+}
+
+void ThreadScheduler::Wake(Frame* blockedFrame)
+{
+	auto it = m_Parked.find(blockedFrame);
+	if (it == m_Parked.end())
+		return;
+
+	m_RunQueue.push_back(it->second.Thread);
+	m_Parked.erase(it);
+}
+
+bool ThreadScheduler::WakeExpired(unsigned long long currentMillis)
+{
+	bool wokeAny = false;
+	while (!m_Timers.empty() && m_Timers.top().WakeTime <= currentMillis)
+	{
+		Timer timer = m_Timers.top();
+		m_Timers.pop();
+
+		auto it = m_Parked.find(timer.BlockedFrame);
+		if (it == m_Parked.end() || it->second.Ticket != timer.Ticket)
+			continue; // Already woken up by a notification
+
+		m_RunQueue.push_back(it->second.Thread);
+		m_Parked.erase(it);
+		wokeAny = true;
+	}
+
+	return wokeAny;
+}
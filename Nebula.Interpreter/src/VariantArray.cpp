@@ -9,13 +9,20 @@ nebula::VariantArray::VariantArray(const DataStackVariantIndex& type)
 {
 }
 
-InstructionErrorCode VariantArray::CallVirtual(const std::string_view& funcName, nebula::Interpreter*, Frame* context)
+InstructionErrorCode VariantArray::CallVirtual(VirtualMethod method, nebula::Interpreter*, Frame* context)
 {
-    if (funcName == "Append")
+    return CallMethod(method, context);
+}
+
+InstructionErrorCode VariantArray::CallMethod(VirtualMethod method, Frame* context)
+{
+    switch (method)
+    {
+    case VirtualMethod::Append:
     {
         DataStackVariant& v = context->Stack().Peek();
 
-        if (v.index() != this->m_eVariantType)
+        if (v.Type() != this->m_eVariantType)
         {
             return InstructionErrorCode::Fatal;
         }
@@ -24,18 +31,17 @@ InstructionErrorCode VariantArray::CallVirtual(const std::string_view& funcName,
         context->Stack().Pop();
         return InstructionErrorCode::None;
     }
-
-    if (funcName == "Clear")
+    case VirtualMethod::Clear:
     {
         Clear();
         return InstructionErrorCode::None;
     }
-
-    if (funcName == "Count")
+    case VirtualMethod::Count:
     {
         context->Stack().Push({ (TInt32)Size() });
         return InstructionErrorCode::None;
     }
-
-    return InstructionErrorCode::NativeFunctionNotFound;
+    default:
+        return InstructionErrorCode::NativeFunctionNotFound;
+    }
 }
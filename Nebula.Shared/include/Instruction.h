@@ -2,13 +2,15 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <format>
 
 #include "LanguageTypes.h"
 
 namespace nebula
 {
-	using RawArguments = std::vector<std::string>;
+	// Arguments as written in the script text, views of the text being parsed
+	using RawArguments = std::vector<std::string_view>;
 	using InstructionArguments = std::vector<DataStackVariant>;
 
 	enum class InstructionErrorCode
@@ -5,6 +5,7 @@
 
 #include <map>
 #include <string>
+#include <string_view>
 
 #include "Utility.h"
 
@@ -87,6 +88,39 @@ namespace nebula {
 		StFld,
 		StsFld,
 
+		// Type specialized variants, never parsed from scripts.
+		// Produced when linking once the type of both operands is known (see ScriptVerifier)
+		Add_i4,
+		Add_r4,
+		Sub_i4,
+		Sub_r4,
+		Mul_i4,
+		Mul_r4,
+		Div_i4,
+		Div_r4,
+		Ceq_i4,
+		Clt_i4,
+		Cgt_i4,
+
+		// Superinstructions, never parsed from scripts.
+		// Replace the first instruction of a frequent sequence once linked (see LinkedCode::FuseSuperinstructions)
+		Ldloc2,			// ldloc a; ldloc b
+		LdlocAddC_i4,	// ldloc a; ldc k; add|sub
+		LdargAddC_i4,	// ldarg a; ldc k; add|sub
+		IncLoc_i4,		// ldloc a; ldc k; add|sub; stloc b
+		BrLocLt_i4,		// ldloc a; ldloc b; compare; brtrue|brfalse
+		BrLocGe_i4,
+		BrLocGt_i4,
+		BrLocLe_i4,
+		BrLocEq_i4,
+		BrLocNe_i4,
+		BrLocLtC_i4,	// ldloc a; ldc k; compare; brtrue|brfalse
+		BrLocGeC_i4,
+		BrLocGtC_i4,
+		BrLocLeC_i4,
+		BrLocEqC_i4,
+		BrLocNeC_i4,
+
 		LastInstruction
 	};
 
@@ -192,6 +226,8 @@ namespace nebula {
 			return "mul";
 		case VMInstruction::Div:
 			return "div";
+		case VMInstruction::Rem:
+			return "rem";
 		case VMInstruction::AddStr:
 			return "addstr";
 		case VMInstruction::Ldc_i4_0:
@@ -216,6 +252,8 @@ namespace nebula {
 			return "ldc_i4_9";
 		case VMInstruction::Ldc_i4:
 			return "ldc_i4";
+		case VMInstruction::Ldc_r4:
+			return "ldc_r4";
 		case VMInstruction::Ldc_s:
 			return "ldc_s";
 		case VMInstruction::Ldarg:
@@ -224,6 +262,10 @@ namespace nebula {
 			return "ldloc";
 		case VMInstruction::Stloc:
 			return "stloc";
+		case VMInstruction::StArg:
+			return "starg";
+		case VMInstruction::StElem:
+			return "stelem";
 		case VMInstruction::Newobj:
 			return "newobj";
 		case VMInstruction::NewArr:
@@ -242,12 +284,66 @@ namespace nebula {
 			return "chkdef";
 		case VMInstruction::LdNull:
 			return "ldnull";
+		case VMInstruction::Add_i4:
+			return "add_i4";
+		case VMInstruction::Add_r4:
+			return "add_r4";
+		case VMInstruction::Sub_i4:
+			return "sub_i4";
+		case VMInstruction::Sub_r4:
+			return "sub_r4";
+		case VMInstruction::Mul_i4:
+			return "mul_i4";
+		case VMInstruction::Mul_r4:
+			return "mul_r4";
+		case VMInstruction::Div_i4:
+			return "div_i4";
+		case VMInstruction::Div_r4:
+			return "div_r4";
+		case VMInstruction::Ceq_i4:
+			return "ceq_i4";
+		case VMInstruction::Clt_i4:
+			return "clt_i4";
+		case VMInstruction::Cgt_i4:
+			return "cgt_i4";
+		case VMInstruction::Ldloc2:
+			return "ldloc2";
+		case VMInstruction::LdlocAddC_i4:
+			return "ldlocaddc_i4";
+		case VMInstruction::LdargAddC_i4:
+			return "ldargaddc_i4";
+		case VMInstruction::IncLoc_i4:
+			return "incloc_i4";
+		case VMInstruction::BrLocLt_i4:
+			return "brloclt_i4";
+		case VMInstruction::BrLocGe_i4:
+			return "brlocge_i4";
+		case VMInstruction::BrLocGt_i4:
+			return "brlocgt_i4";
+		case VMInstruction::BrLocLe_i4:
+			return "brlocle_i4";
+		case VMInstruction::BrLocEq_i4:
+			return "brloceq_i4";
+		case VMInstruction::BrLocNe_i4:
+			return "brlocne_i4";
+		case VMInstruction::BrLocLtC_i4:
+			return "brlocltc_i4";
+		case VMInstruction::BrLocGeC_i4:
+			return "brlocgec_i4";
+		case VMInstruction::BrLocGtC_i4:
+			return "brlocgtc_i4";
+		case VMInstruction::BrLocLeC_i4:
+			return "brloclec_i4";
+		case VMInstruction::BrLocEqC_i4:
+			return "brloceqc_i4";
+		case VMInstruction::BrLocNeC_i4:
+			return "brlocnec_i4";
 		}
 
 		return nullptr;
 	}
-	static inline bool stoi(const char* s, VMInstruction& val) {
-		static std::map<std::string, VMInstruction> instructionMap = {
+	static inline bool stoi(std::string_view s, VMInstruction& val) {
+		static std::map<std::string, VMInstruction, std::less<>> instructionMap = {
 			{"nop",			VMInstruction::Nop			},
 			{"pop",			VMInstruction::Pop			},
 			{"dup",			VMInstruction::Dup			},
@@ -319,7 +415,8 @@ namespace nebula {
 		val = instPair->second;
 		return true;
 	}
-	static inline bool stoi(const std::string& s, VMInstruction& val) { return stoi((const char*)s.data(), val); }
+	static inline bool stoi(const char* s, VMInstruction& val) { return stoi(std::string_view{ s }, val); }
+	static inline bool stoi(const std::string& s, VMInstruction& val) { return stoi(std::string_view{ s }, val); }
 	static inline constexpr const char* atos(const VMAttribute attr) {
 		switch (attr)
 		{
@@ -331,20 +428,20 @@ namespace nebula {
 
 		return nullptr;
 	}
-	static inline bool stoattr(const char* s, VMAttribute& val) {
-		if (strncmp("autoexec", s, cstrlen("autoexec") + 1) == 0)
+	static inline bool stoattr(std::string_view s, VMAttribute& val) {
+		if (s == "autoexec")
 		{
 			val = VMAttribute::AutoExec;
 			return true;
 		}
 
-		if (strncmp("autogenerated", s, cstrlen("autogenerated") + 1) == 0)
+		if (s == "autogenerated")
 		{
 			val = VMAttribute::Autogenerated;
 			return true;
 		}
 
-		if (strncmp("initializer", s, cstrlen("initializer") + 1) == 0)
+		if (s == "initializer")
 		{
 			val = VMAttribute::Initializer;
 			return true;
@@ -360,9 +457,9 @@ namespace nebula {
 		Locals,
 	};
 
-	inline SpecialDataType StringToSpecialDataType(const std::string& str)
+	inline SpecialDataType StringToSpecialDataType(std::string_view str)
 	{
-		static std::map<std::string, SpecialDataType> valMap = {
+		static std::map<std::string, SpecialDataType, std::less<>> valMap = {
 			{ "unknown",	SpecialDataType::Unknown },
 			{ "locals",	    SpecialDataType::Locals },
 		};
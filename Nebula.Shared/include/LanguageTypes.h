@@ -1,30 +1,31 @@
 #pragma once
 
 #include <memory>
-#include <variant>
 #include <string>
+#include <string_view>
 #include <cmath>
+#include <type_traits>
 #include <intrin.h>
 
+#include "RefCounted.h"
+#include "SharedString.h"
+#include "interfaces/IGCObject.h"
+
 namespace nebula
 {
-    template<typename TType>
-    using RefCounted = std::shared_ptr<TType>;
-
     class Bundle;
     class VariantArray;
-    class IGCObject;
 
-    // Utility types
-    using TBundle = RefCounted<Bundle>;
-    using TArray = RefCounted<VariantArray>;
+    // Utility types, objects are owned by the GC heap and referenced by raw pointer
+    using TBundle = Bundle*;
+    using TArray = VariantArray*;
 
     // Datastack types
     //using TByte = uint8_t;
     using TInt32 = int32_t;
     using TFloat = float_t;
     using TString = std::string;
-    using TGCObject = RefCounted<IGCObject>;
+    using TGCObject = IGCObject*;
 
     /// <summary> Enum for variant lookup and emit </summary>
     enum DataStackVariantIndex
@@ -38,44 +39,131 @@ namespace nebula
         _TypeLast,
     };
 
-    //using DataStackVariant = std::variant<TByte, TInt32, TFloat, TString, TBundle>;
-    using DataStackVariant = std::variant<TInt32, TFloat, TString, TGCObject>;
+    template<typename TType> constexpr DataStackVariantIndex VariantIndexOf = _UnknownType;
+    template<> constexpr DataStackVariantIndex VariantIndexOf<TInt32> = _TypeInt32;
+    template<> constexpr DataStackVariantIndex VariantIndexOf<TFloat> = _TypeFloat;
+    template<> constexpr DataStackVariantIndex VariantIndexOf<TString> = _TypeString;
+    template<> constexpr DataStackVariantIndex VariantIndexOf<TGCObject> = _TypeObject;
 
-    DataStackVariantIndex StringToStackValue(const std::string& str);
-
-    inline bool IsDefined(const DataStackVariant& v)
+    // Tagged value of the data stack, variables and bundle fields.
+    // Numbers are stored inline, strings by handle and objects by pointer so that copying a value never allocates
+    // and only touches a reference count when it holds a string. Objects are only reclaimed by the collector.
+    class DataStackVariant
     {
-        const TGCObject* obj = std::get_if<TGCObject>(&v);
-        if (obj != nullptr)
+    public:
+        DataStackVariant() { m_Data.Int = 0; }
+        DataStackVariant(TInt32 value) : m_Type{ _TypeInt32 } { m_Data.Int = value; }
+        DataStackVariant(TFloat value) : m_Type{ _TypeFloat } { m_Data.Float = value; }
+        DataStackVariant(SharedString* value) : m_Type{ _TypeString } { m_Data.String = value; Acquire(); }
+        DataStackVariant(const TString& value) : DataStackVariant(new SharedString(value)) {}
+        DataStackVariant(TString&& value) : DataStackVariant(new SharedString(std::move(value))) {}
+        DataStackVariant(const char* value) : DataStackVariant(new SharedString(value)) {}
+
+        DataStackVariant(IGCObject* value) : m_Type{ _TypeObject } { m_Data.Object = value; }
+
+        DataStackVariant(const DataStackVariant& other)
+            : m_Data{ other.m_Data }, m_Type{ other.m_Type }
         {
-            return obj->get() != nullptr;
+            Acquire();
         }
 
-        return true;
-    }
+        DataStackVariant(DataStackVariant&& other) noexcept
+            : m_Data{ other.m_Data }, m_Type{ other.m_Type }
+        {
+            other.m_Type = _TypeInt32;
+            other.m_Data.Int = 0;
+        }
 
-    TBundle* GetBundle(const DataStackVariant& v);
+        ~DataStackVariant() { Drop(); }
 
-    inline std::string ToString(const DataStackVariant& var)
-    {
-        //if (std::holds_alternative<TByte>(var))
-        //{
-        //	return std::to_string(std::get<_TypeByte>(var));
-        //}
+        DataStackVariant& operator=(const DataStackVariant& other)
+        {
+            other.Acquire();
+            Drop();
+            m_Data = other.m_Data;
+            m_Type = other.m_Type;
+            return *this;
+        }
+
+        DataStackVariant& operator=(DataStackVariant&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Drop();
+                m_Data = other.m_Data;
+                m_Type = other.m_Type;
+                other.m_Type = _TypeInt32;
+                other.m_Data.Int = 0;
+            }
+            return *this;
+        }
+
+        inline DataStackVariantIndex Type() const { return m_Type; }
 
-        if (std::holds_alternative<TInt32>(var))
+        template<typename TType>
+        inline bool Is() const { return m_Type == VariantIndexOf<TType>; }
+
+        // Same contract as std::get_if, strings are immutable and can only be read
+        template<typename TType>
+        inline const TType* GetIf() const
         {
-            return std::to_string(std::get<_TypeInt32>(var));
+            static_assert(!std::is_same_v<TType, TGCObject>, "Objects are held by handle, use AsObject()");
+            if (m_Type != VariantIndexOf<TType>)
+                return nullptr;
+
+            if constexpr (std::is_same_v<TType, TInt32>) return &m_Data.Int;
+            else if constexpr (std::is_same_v<TType, TFloat>) return &m_Data.Float;
+            else return &m_Data.String->Str();
         }
 
-        if (std::holds_alternative<TFloat>(var))
+        // Unchecked accessors, the caller must know the type
+        inline TInt32 AsInt32() const { return m_Data.Int; }
+        inline TFloat AsFloat() const { return m_Data.Float; }
+        inline const TString& AsString() const { return m_Data.String->Str(); }
+        inline SharedString* AsSharedString() const { return m_Data.String; }
+        inline IGCObject* AsObject() const { return m_Type == _TypeObject ? m_Data.Object : nullptr; }
+
+    private:
+        inline bool HoldsHandle() const { return m_Type == _TypeString && m_Data.String != nullptr; }
+        inline void Acquire() const { if (HoldsHandle()) m_Data.String->AddRef(); }
+        inline void Drop() const { if (HoldsHandle()) m_Data.String->Release(); }
+
+        union Payload
+        {
+            TInt32          Int;
+            TFloat          Float;
+            SharedString*   String;
+            IGCObject*      Object;
+        };
+
+        Payload m_Data;
+        DataStackVariantIndex m_Type{ _TypeInt32 };
+    };
+
+    static_assert(sizeof(DataStackVariant) == 16, "Stack values must stay compact");
+
+    DataStackVariantIndex StringToStackValue(std::string_view str);
+
+    inline bool IsDefined(const DataStackVariant& v)
+    {
+        if (v.Is<TGCObject>())
         {
-            return std::to_string(std::get<_TypeFloat>(var));
+            return v.AsObject() != nullptr;
         }
 
-        if (std::holds_alternative<TString>(var))
+        return true;
+    }
+
+    inline std::string ToString(const DataStackVariant& var)
+    {
+        switch (var.Type())
         {
-            return std::get<_TypeString>(var);
+        case _TypeInt32:
+            return std::to_string(var.AsInt32());
+        case _TypeFloat:
+            return std::to_string(var.AsFloat());
+        case _TypeString:
+            return var.AsString();
         }
 
         __debugbreak();
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <utility>
+#include <type_traits>
+
+namespace nebula
+{
+    // Base of everything a value can hold by handle (strings, GC objects are owned by the GC heap instead).
+    // The count is intrusive so that a handle is a single pointer, and not atomic as the VM runs on one thread.
+    // Immortal objects are shared between threads and interpreters, their count is never touched.
+    class RefCountedObject
+    {
+    public:
+        static constexpr uint32_t ImmortalRefCount = UINT32_MAX;
+
+        RefCountedObject() = default;
+        RefCountedObject(const RefCountedObject&) = delete;
+        RefCountedObject& operator=(const RefCountedObject&) = delete;
+
+        inline void AddRef()
+        {
+            if (m_RefCount != ImmortalRefCount)
+                m_RefCount++;
+        }
+
+        inline void Release()
+        {
+            if (m_RefCount == ImmortalRefCount)
+                return;
+
+            assert(m_RefCount > 0 && "Releasing a dead object!");
+            if (--m_RefCount == 0)
+            {
+                delete this;
+            }
+        }
+
+        inline uint32_t RefCount() const { return m_RefCount; }
+        inline bool IsImmortal() const { return m_RefCount == ImmortalRefCount; }
+
+    protected:
+        virtual ~RefCountedObject() = default;
+
+        // Must be called before the object is published to other threads
+        inline void MakeImmortal() { m_RefCount = ImmortalRefCount; }
+
+    private:
+        uint32_t m_RefCount{ 0 };
+    };
+
+    // Owning handle to a RefCountedObject, mirrors the subset of std::shared_ptr the VM uses
+    template<typename TType>
+    class RefCounted
+    {
+        template<typename> friend class RefCounted;
+
+    public:
+        RefCounted() = default;
+        RefCounted(std::nullptr_t) {}
+        RefCounted(TType* ptr) : m_Ptr{ ptr } { Acquire(); }
+        RefCounted(const RefCounted& other) : m_Ptr{ other.m_Ptr } { Acquire(); }
+        RefCounted(RefCounted&& other) noexcept : m_Ptr{ std::exchange(other.m_Ptr, nullptr) } {}
+
+        template<typename TOther, typename = std::enable_if_t<std::is_convertible_v<TOther*, TType*>>>
+        RefCounted(const RefCounted<TOther>& other) : m_Ptr{ other.m_Ptr } { Acquire(); }
+
+        ~RefCounted() { Drop(); }
+
+        RefCounted& operator=(const RefCounted& other)
+        {
+            RefCounted copy{ other };
+            std::swap(m_Ptr, copy.m_Ptr);
+            return *this;
+        }
+
+        RefCounted& operator=(RefCounted&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Drop();
+                m_Ptr = std::exchange(other.m_Ptr, nullptr);
+            }
+            return *this;
+        }
+
+        inline TType* get() const { return m_Ptr; }
+        inline TType* operator->() const { return m_Ptr; }
+        inline TType& operator*() const { return *m_Ptr; }
+        inline explicit operator bool() const { return m_Ptr != nullptr; }
+        inline void reset() { Drop(); m_Ptr = nullptr; }
+
+        inline bool operator==(const RefCounted& other) const { return m_Ptr == other.m_Ptr; }
+        inline bool operator==(std::nullptr_t) const { return m_Ptr == nullptr; }
+
+    private:
+        inline void Acquire() { if (m_Ptr) m_Ptr->AddRef(); }
+        inline void Drop() { if (m_Ptr) m_Ptr->Release(); }
+
+        TType* m_Ptr{ nullptr };
+    };
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <string_view>
+
+#include "RefCounted.h"
+
+namespace nebula
+{
+    // Immutable string held by handle, copying a string value only bumps the reference count.
+    // Script constants are interned: there is a single immortal instance per distinct text,
+    // shared by every script and interpreter, with its hash computed once when interned.
+    // Long concatenations are deferred: the string keeps its parts and is only flattened when its text is
+    // first read, so that loops appending to the same string don't copy it over and over.
+    class SharedString
+        : public RefCountedObject
+    {
+    public:
+        // Results shorter than this are concatenated right away, deferring them costs more than copying
+        static constexpr size_t MinDeferredConcatLength = 256;
+
+        explicit SharedString(std::string value) : m_Value{ std::move(value) }, m_Length{ m_Value.size() } {}
+        virtual ~SharedString() override;
+
+        // Thread safe, the returned string lives until the process exits
+        static SharedString* Intern(std::string_view value);
+
+        // Concatenates count strings in order, the text is copied exactly once
+        static SharedString* Concatenate(SharedString* const* parts, size_t count);
+
+        inline const std::string& Str() const
+        {
+            if (!m_Parts.empty())
+                Flatten();
+
+            return m_Value;
+        }
+
+        inline size_t Length() const { return m_Length; }
+        inline bool IsInterned() const { return IsImmortal(); }
+
+        // Same value as std::hash<std::string> of the text, computed on first use
+        inline size_t Hash() const
+        {
+            if (!m_HasHash)
+            {
+                m_Hash = std::hash<std::string>{}(Str());
+                m_HasHash = true;
+            }
+
+            return m_Hash;
+        }
+
+    private:
+        SharedString(std::vector<RefCounted<SharedString>>&& parts, size_t length);
+
+        void Flatten() const;
+
+        // Text is only mutated when a deferred concatenation gets flattened
+        mutable std::string m_Value;
+        mutable std::vector<RefCounted<SharedString>> m_Parts;
+        size_t m_Length;
+        mutable size_t m_Hash{ 0 };
+        mutable bool m_HasHash{ false };
+    };
+}
@@ -1,16 +1,18 @@
 #pragma once
 
 #include "INotificationListener.h"
-#include "Instruction.h"
 
+#include <cstdint>
 #include <string>
 #include <string_view>
 #include <unordered_set>
+#include <vector>
 
 namespace nebula
 {
     class Interpreter;
     class Frame;
+    enum class InstructionErrorCode;
 
     enum class ObjectType
     {
@@ -19,10 +21,26 @@ namespace nebula
         Array,
     };
 
+    // Methods objects expose to CallVirt, the name in the bytecode is resolved once when the code is linked
+    enum class VirtualMethod : uint8_t
+    {
+        Unknown,
+        Append,
+        Clear,
+        Count,
+    };
+
+    VirtualMethod VirtualMethodOf(const std::string_view& name);
+
+    // Objects live in the GC heap of an interpreter and are referenced by raw pointer,
+    // they are only destroyed by the collector once unreachable (see GCHeap)
     class __declspec(novtable) IGCObject {
         friend class InterpreterMemory;
+        friend class GCHeap;
     public:
         IGCObject(ObjectType type);
+        IGCObject(const IGCObject&) = delete;
+        IGCObject& operator=(const IGCObject&) = delete;
 
         inline ObjectType GetType() { return m_ContainedType; }
 
@@ -30,14 +48,24 @@ namespace nebula
         void Unsubscribe(INotificationListener*);
 
         void Notify(const std::string& notification);
+        // Same as above with the precomputed std::hash of the notification name
+        void Notify(size_t notificationHash);
 
-        virtual InstructionErrorCode CallVirtual(const std::string_view& name, nebula::Interpreter* vm, Frame* context);
+        virtual InstructionErrorCode CallVirtual(VirtualMethod method, nebula::Interpreter* vm, Frame* context);
     protected:
-        void Unsubscribe(std::unordered_set<INotificationListener*>::iterator&);
-        std::unordered_set<INotificationListener*> m_Listeners;
+        void RemoveListener(size_t slot);
+        void CompactListeners();
+        // In subscription order so that a notification wakes the waiting threads in a reproducible order.
+        // Unsubscribing leaves a nullptr in the slot of the listener (see INotificationListener::ConnectedNotifier) until compacted
+        std::vector<INotificationListener*> m_Listeners;
+        size_t m_RemovedListeners{ 0 };
 
         /// <summary> Used by the GC to mark reachable objects </summary>
         bool m_bIsMarked{ false };
+        /// <summary> Survived a collection, only full collections reclaim old objects </summary>
+        bool m_bIsOld{ false };
+        /// <summary> Old object in the remembered set, it was written a reference to a young object </summary>
+        bool m_bIsRemembered{ false };
         ObjectType m_ContainedType;
     public:
         virtual ~IGCObject();
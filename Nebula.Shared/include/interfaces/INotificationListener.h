@@ -1,6 +1,6 @@
 #pragma once
 
-#include <unordered_set>
+#include <vector>
 
 namespace nebula
 {
@@ -19,6 +19,16 @@ namespace nebula
         void UnsubscribeFromAll();
 
     private:
-        std::unordered_set<IGCObject*> m_ConnectedNotifiers;
+        struct ConnectedNotifier
+        {
+            IGCObject* Notifier;
+            size_t Slot; // Of the listener in the listeners of the notifier
+        };
+
+        ConnectedNotifier* FindConnectedNotifier(IGCObject* notifier);
+        void RemoveConnectedNotifier(IGCObject* notifier);
+
+        // A listener waits on a handful of objects at most, a vector is cheaper than a set to create
+        std::vector<ConnectedNotifier> m_ConnectedNotifiers;
     };
 }
\ No newline at end of file
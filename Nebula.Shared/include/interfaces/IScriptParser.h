@@ -20,11 +20,15 @@ namespace nebula
 
 	protected:
 		bool ReadString(std::string& out, size_t maxIndex = 0);
+		// Same as above without copying, out is a view of the data being parsed
+		bool ReadString(std::string_view& out, size_t maxIndex = 0);
 
 		// Does not skip whitespace, returns next character in data
-		char Current();
+		inline char Current() const { return CharAt(m_CurrentDataIndex); }
 		// Does not skip whitespace, returns next character in data and moves iterator forward by one
-		char Next();
+		inline char Next() { char c = Current(); m_CurrentDataIndex++; return c; }
+		// Character at index, 0 past the end of data
+		inline char CharAt(size_t index) const { return index < m_CurrentData.size() ? m_CurrentData[index] : 0; }
 		void ReportErrorWhileParsingBundle(std::string_view);
 
 		void ReportExpectedNumberAt(size_t);
@@ -9,6 +9,14 @@
 
 using namespace nebula;
 
+VirtualMethod nebula::VirtualMethodOf(const std::string_view& name)
+{
+	if (name == "Append") return VirtualMethod::Append;
+	if (name == "Clear") return VirtualMethod::Clear;
+	if (name == "Count") return VirtualMethod::Count;
+	return VirtualMethod::Unknown;
+}
+
 IGCObject::IGCObject(ObjectType type)
 	: m_ContainedType{ type }
 {
@@ -16,50 +24,95 @@ IGCObject::IGCObject(ObjectType type)
 
 IGCObject::~IGCObject()
 {
-	assert(m_Listeners.empty());
+	// The heap can be torn down while frames still wait on its objects
+	for (INotificationListener* listener : m_Listeners)
+	{
+		if (listener != nullptr)
+		{
+			listener->RemoveConnectedNotifier(this);
+		}
+	}
 }
 
 void IGCObject::Subscribe(INotificationListener* listener)
 {
 	assert(listener);
-	m_Listeners.insert(listener);
-	listener->m_ConnectedNotifiers.insert(this);
+	if (listener->FindConnectedNotifier(this) != nullptr)
+		return;
+
+	// Slots of removed listeners are only reclaimed once they are the majority
+	if (m_RemovedListeners > m_Listeners.size() / 2)
+	{
+		CompactListeners();
+	}
+
+	listener->m_ConnectedNotifiers.push_back({ this, m_Listeners.size() });
+	m_Listeners.push_back(listener);
 }
 
 void IGCObject::Unsubscribe(INotificationListener* listener)
 {
 	assert(listener);
-	listener->m_ConnectedNotifiers.erase(this);
-	m_Listeners.erase(listener);
+	INotificationListener::ConnectedNotifier* connected = listener->FindConnectedNotifier(this);
+	if (connected == nullptr)
+		return;
+
+	size_t slot = connected->Slot;
+	listener->RemoveConnectedNotifier(this);
+	RemoveListener(slot);
+}
+
+void IGCObject::RemoveListener(size_t slot)
+{
+	assert(m_Listeners[slot] != nullptr);
+	m_Listeners[slot] = nullptr;
+	m_RemovedListeners++;
 }
 
-void IGCObject::Unsubscribe(std::unordered_set<INotificationListener*>::iterator& it)
+void IGCObject::CompactListeners()
 {
-	INotificationListener* listener = *it;
-	listener->m_ConnectedNotifiers.erase(this);
-	it = m_Listeners.erase(it);
+	size_t count{ 0 };
+	for (INotificationListener* listener : m_Listeners)
+	{
+		if (listener == nullptr)
+			continue;
+
+		listener->FindConnectedNotifier(this)->Slot = count;
+		m_Listeners[count++] = listener;
+	}
+
+	m_Listeners.resize(count);
+	m_RemovedListeners = 0;
 }
 
 void IGCObject::Notify(const std::string& notification)
 {
 	std::hash<std::string> hasher;
-	size_t notifHash = hasher(notification);
-	for (auto it = m_Listeners.begin(); it != m_Listeners.end(); it++)
+	Notify(hasher(notification));
+}
+
+void IGCObject::Notify(size_t notifHash)
+{
+	// Listeners subscribing while notified only get the next notifications
+	size_t count = m_Listeners.size();
+	for (size_t slot{ 0 }; slot < count; slot++)
 	{
-		bool removeListener = (*it)->OnNotification(this, notifHash);
-		if (removeListener)
+		INotificationListener* listener = m_Listeners[slot];
+		if (listener != nullptr && listener->OnNotification(this, notifHash))
 		{
-			Unsubscribe(it);
+			listener->RemoveConnectedNotifier(this);
+			RemoveListener(slot);
 		}
+	}
 
-		if (it == m_Listeners.end())
-		{
-			break;
-		}
+	// Woken up waiters are usually done with the object
+	if (m_RemovedListeners > 0)
+	{
+		CompactListeners();
 	}
 }
 
-InstructionErrorCode nebula::IGCObject::CallVirtual(const std::string_view&, nebula::Interpreter*, Frame*)
+InstructionErrorCode nebula::IGCObject::CallVirtual(VirtualMethod, nebula::Interpreter*, Frame*)
 {
 	return InstructionErrorCode::Fatal;
 }
\ No newline at end of file
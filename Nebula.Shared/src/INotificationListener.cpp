@@ -1,6 +1,8 @@
 #include "interfaces/INotificationListener.h"
 #include "interfaces/IGCObject.h"
 
+#include <algorithm>
+
 using namespace nebula;
 
 INotificationListener::~INotificationListener()
@@ -10,11 +12,27 @@ INotificationListener::~INotificationListener()
 
 void INotificationListener::UnsubscribeFromAll()
 {
-    std::unordered_set<IGCObject*> notifiers = { m_ConnectedNotifiers };
-    for (IGCObject* obj : notifiers)
+    // Unsubscribe removes the notifier from the list
+    while (!m_ConnectedNotifiers.empty())
     {
-        obj->Unsubscribe(this);
+        m_ConnectedNotifiers.back().Notifier->Unsubscribe(this);
     }
+}
+
+INotificationListener::ConnectedNotifier* INotificationListener::FindConnectedNotifier(IGCObject* notifier)
+{
+    auto it = std::find_if(m_ConnectedNotifiers.begin(), m_ConnectedNotifiers.end(),
+        [notifier](const ConnectedNotifier& connected) { return connected.Notifier == notifier; });
+    return it != m_ConnectedNotifiers.end() ? &*it : nullptr;
+}
 
-    m_ConnectedNotifiers.clear();
+void INotificationListener::RemoveConnectedNotifier(IGCObject* notifier)
+{
+    auto it = std::find_if(m_ConnectedNotifiers.begin(), m_ConnectedNotifiers.end(),
+        [notifier](const ConnectedNotifier& connected) { return connected.Notifier == notifier; });
+    if (it != m_ConnectedNotifiers.end())
+    {
+        *it = m_ConnectedNotifiers.back();
+        m_ConnectedNotifiers.pop_back();
+    }
 }
@@ -6,9 +6,9 @@
 
 using namespace nebula;
 
-DataStackVariantIndex nebula::StringToStackValue(const std::string& str)
+DataStackVariantIndex nebula::StringToStackValue(std::string_view str)
 {
-    static std::map<std::string, DataStackVariantIndex> valMap = {
+    static std::map<std::string, DataStackVariantIndex, std::less<>> valMap = {
         //{ "char",	DataStackVariantIndex::_TypeByte },
         { "bool",	DataStackVariantIndex::_TypeInt32   },
         { "int32",	DataStackVariantIndex::_TypeInt32   },
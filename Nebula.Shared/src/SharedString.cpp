@@ -0,0 +1,120 @@
+#include <mutex>
+#include <unordered_map>
+
+#include "SharedString.h"
+
+using namespace nebula;
+
+SharedString* SharedString::Intern(std::string_view value)
+{
+    // Keys view the text owned by the interned strings, which are never released.
+    // The table itself is never destroyed either so that strings stay reachable until exit.
+    static auto* s_Table = new std::unordered_map<std::string_view, SharedString*>();
+    static std::mutex s_TableMutex;
+
+    std::lock_guard<std::mutex> lock{ s_TableMutex };
+
+    auto it = s_Table->find(value);
+    if (it != s_Table->end())
+        return it->second;
+
+    SharedString* interned = new SharedString(std::string{ value });
+    interned->Hash();
+    interned->MakeImmortal();
+    s_Table->insert(std::make_pair(std::string_view{ interned->Str() }, interned));
+    return interned;
+}
+
+SharedString* SharedString::Concatenate(SharedString* const* parts, size_t count)
+{
+    size_t length{ 0 };
+    for (size_t i{ 0 }; i < count; i++)
+    {
+        length += parts[i]->Length();
+    }
+
+    if (length >= MinDeferredConcatLength)
+    {
+        std::vector<RefCounted<SharedString>> deferred(parts, parts + count);
+        return new SharedString(std::move(deferred), length);
+    }
+
+    std::string result;
+    result.reserve(length);
+    for (size_t i{ 0 }; i < count; i++)
+    {
+        result += parts[i]->Str();
+    }
+
+    return new SharedString(std::move(result));
+}
+
+SharedString::SharedString(std::vector<RefCounted<SharedString>>&& parts, size_t length)
+    : m_Parts{ std::move(parts) }, m_Length{ length }
+{
+}
+
+SharedString::~SharedString()
+{
+    if (m_Parts.empty())
+        return;
+
+    // A string built by appending in a loop is a long chain of deferred concatenations,
+    // release it iteratively instead of recursing once per link
+    static thread_local std::vector<RefCounted<SharedString>> s_PendingRelease;
+    static thread_local bool s_IsReleasing{ false };
+
+    for (auto& part : m_Parts)
+    {
+        s_PendingRelease.push_back(std::move(part));
+    }
+    m_Parts.clear();
+
+    if (s_IsReleasing)
+        return;
+
+    s_IsReleasing = true;
+    while (!s_PendingRelease.empty())
+    {
+        // Moving out first, the release can push more parts in the vector
+        RefCounted<SharedString> part = std::move(s_PendingRelease.back());
+        s_PendingRelease.pop_back();
+    }
+    s_IsReleasing = false;
+}
+
+void SharedString::Flatten() const
+{
+    std::string result;
+    result.reserve(m_Length);
+
+    // Depth first, left to right, without recursion
+    std::vector<const SharedString*> toVisit;
+    for (auto it = m_Parts.rbegin(); it != m_Parts.rend(); it++)
+    {
+        toVisit.push_back(it->get());
+    }
+
+    while (!toVisit.empty())
+    {
+        const SharedString* current = toVisit.back();
+        toVisit.pop_back();
+
+        if (current->m_Parts.empty())
+        {
+            result += current->m_Value;
+            continue;
+        }
+
+        for (auto it = current->m_Parts.rbegin(); it != current->m_Parts.rend(); it++)
+        {
+            toVisit.push_back(it->get());
+        }
+    }
+
+    m_Value = std::move(result);
+
+    // Parts may be shared with other strings, only our references go away
+    std::vector<RefCounted<SharedString>> parts = std::move(m_Parts);
+    m_Parts.clear();
+}